@@ -0,0 +1,115 @@
+#include "BallCountEstimator.h"
+#include "Constants.h"
+#include "ConveyorModel.h"
+#include "Logger.h"
+#include "Singleton.h"
+
+// Nothing is known about the conveyor at startup.
+static const double INITIAL_CONFIDENCE = 0.5;
+// How far each confirmation moves the confidence towards 1.
+static const double CONFIRM_WEIGHT = 0.25;
+static const double CORRECTION_FACTOR = 0.5;
+static const double DOUBT_FACTOR = 0.8;
+
+BallCountEstimator::BallCountEstimator(ConveyorModel& conveyor) :
+		conveyor(conveyor),
+		confidence(INITIAL_CONFIDENCE),
+		corrections(0)
+{
+}
+
+unsigned BallCountEstimator::GetCount() const
+{
+	return conveyor.GetCount();
+}
+
+void BallCountEstimator::Update(bool frontSeen, bool middleSeen, bool topSeen, double grabber, double lifter)
+{
+	unsigned before = conveyor.GetCount();
+	if (conveyor.Update(frontSeen, middleSeen, topSeen, grabber, lifter) > 0)
+		Correct("found an untracked ball at a sensor", before);
+}
+
+void BallCountEstimator::Staged()
+{
+	Confirm();
+}
+
+void BallCountEstimator::ShotSeen()
+{
+	if (conveyor.GetCount() == 0)
+	{
+		// There was one after all, which the shot then took.
+		conveyor.SetCount(1);
+		Correct("shot a ball with none counted", 0);
+	}
+	else
+		Confirm();
+	conveyor.RemoveShot();
+}
+
+void BallCountEstimator::ShotMissed()
+{
+	unsigned before = conveyor.GetCount();
+	if (conveyor.RemoveLifted() > 0)
+		Correct("no ball left the shooter, so the lifter is empty", before);
+	else
+		Confirm();
+}
+
+void BallCountEstimator::IncomingLost()
+{
+	conveyor.RemoveIncoming();
+	Doubt("a ball was lost before the middle sensor");
+}
+
+void BallCountEstimator::PrepareMissed()
+{
+	if (conveyor.GetCount() > 0)
+		Doubt("no ball came down to the middle sensor");
+}
+
+void BallCountEstimator::Emptied()
+{
+	conveyor.Clear();
+	confidence = 1.0;
+}
+
+void BallCountEstimator::Set(unsigned balls)
+{
+	conveyor.SetCount(balls);
+	confidence = 1.0;
+}
+
+void BallCountEstimator::Change(int change)
+{
+	unsigned before = conveyor.GetCount();
+	int balls = (int)before + change;
+	if (balls < 0)
+		balls = 0;
+	if (balls > (int)MAX_BALLS)
+		balls = MAX_BALLS;
+	conveyor.SetCount(balls);
+	LOGGER.Logf("BallCountEstimator: driver changed the count from %u to %d at %.0f%% confidence", before, balls,
+			100.0 * confidence);
+	confidence = 1.0;
+}
+
+void BallCountEstimator::Confirm()
+{
+	confidence += (1.0 - confidence) * CONFIRM_WEIGHT;
+}
+
+void BallCountEstimator::Doubt(const char* reason)
+{
+	confidence *= DOUBT_FACTOR;
+	LOGGER.Logf("BallCountEstimator: %s, confidence %.0f%%", reason, 100.0 * confidence);
+}
+
+void BallCountEstimator::Correct(const char* reason, unsigned before)
+{
+	corrections++;
+	confidence *= CORRECTION_FACTOR;
+	LOGGER.Logf("BallCountEstimator: %s, count %u to %u (correction %u), confidence %.0f%%", reason, before,
+			conveyor.GetCount(), corrections, 100.0 * confidence);
+}
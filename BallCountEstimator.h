@@ -0,0 +1,77 @@
+#ifndef BALLCOUNTESTIMATOR_H
+#define BALLCOUNTESTIMATOR_H
+
+#include <WPILib.h>
+
+class ConveyorModel;
+
+/**
+ * Keeps the conveyor's ball count honest, and says how far to trust it.
+ *
+ * The count drifts when balls get past the sensors unseen. What happens
+ * later gives it away: a ball turning up at the middle or top sensor that
+ * was not being tracked, a shot leaving the wheels with nothing counted, or
+ * the lifter running a whole shot timeout without anything coming out,
+ * which means there is nothing left above the middle sensor. Each of these
+ * corrects the count and is logged.
+ *
+ * The confidence, from 0 to 1, halves with every correction, drops a
+ * little on events that only hint at a problem, and climbs back a quarter
+ * of the way to 1 each time a ball is staged or shot as counted. Setting
+ * the count outright or emptying the conveyor makes it 1.
+ *
+ * Only the collector task should use it.
+ */
+class BallCountEstimator
+{
+public:
+	/**
+	 * \param conveyor the balls to keep count of; the caller keeps it.
+	 */
+	explicit BallCountEstimator(ConveyorModel& conveyor);
+
+	/**
+	 * Move the balls along, noting any found on the way.
+	 *
+	 * \see ConveyorModel::Update
+	 */
+	void Update(bool frontSeen, bool middleSeen, bool topSeen, double grabber, double lifter);
+
+	/// A ball was lifted clear of the middle sensor.
+	void Staged();
+	/// The wheels or the top sensor saw a fired ball leave.
+	void ShotSeen();
+	/// A fired ball never left, so the lifter is empty.
+	void ShotMissed();
+	/// The ball being pulled in never reached the middle sensor.
+	void IncomingLost();
+	/// Backing the lifter up found no ball within the prepare time.
+	void PrepareMissed();
+	/// Everything has been ejected.
+	void Emptied();
+
+	/**
+	 * \param balls the true count, such as the balls preloaded before a
+	 * match.
+	 */
+	void Set(unsigned balls);
+
+	/**
+	 * The driver has corrected the count by hand.
+	 */
+	void Change(int change);
+
+	unsigned GetCount() const;
+	double GetConfidence() const { return confidence; }
+
+private:
+	void Confirm();
+	void Doubt(const char* reason);
+	void Correct(const char* reason, unsigned before);
+
+	ConveyorModel& conveyor;
+	double volatile confidence;
+	unsigned corrections;
+};
+
+#endif // BALLCOUNTESTIMATOR_H
@@ -1,18 +1,115 @@
 #include <WPILib.h>
 #include "Collector.h"
 #include "DisplayWriter.h"
+#include "Logger.h"
+#include "Shooter.h"
 #include "Singleton.h"
+#include "TimerWheel.h"
+#include "BallCountEstimator.h"
+#include "ConveyorModel.h"
+#include "IRCalibration.h"
+#include "StateMachine.h"
 #include <cstdio>
 
-unsigned Collector::balls = 0;
+// Commands other tasks send the collector task.
+enum CollectorCommand
+{
+	FIRE_COMMAND,
+	PREPARE_COMMAND,
+	EJECT_COMMAND,
+	STOP_COMMAND,
+	START_COMMAND,
+	RAMP_COMMAND,
+	SET_BALLS_COMMAND,
+	CHANGE_BALLS_COMMAND
+};
+
+// Timers the collector task keeps on its wheel.
+enum CollectorTimer
+{
+	STAGE2_SETTLE,
+	SHOT_CLEAR,
+	SENSOR_RECHECK,
+	// The rest outlive state changes.
+	DISPLAY_REFRESH,
+	REJECT_DONE
+};
+
+static const double TIMER_TICK = 0.005;
+static const double STAGE1_TIME = 4.0;
+// Keep the lifter running a little after the ball clears the middle sensor.
+static const double STAGE2_SETTLE_TIME = 0.1;
+static const double PREPARE_TIME = 0.2;
+// Give the ball time to clear the wheels.
+static const double SHOT_CLEAR_TIME = 0.25;
+static const double EJECT_TIME = 3.5;
+// Balls leaving a sensor do not interrupt, so look again this often while
+// waiting for one to go.
+static const double SENSOR_RECHECK_TIME = 0.01;
+static const double DISPLAY_PERIOD = 0.25;
+// How long the grabber runs backwards to push a ball off the ramp.
+static const double REJECT_TIME = 0.5;
+static const char* const IR_CALIBRATION_FILE = "/ni-rt/system/ircalibration.txt";
+// How long Shoot() waits for the collector to be free, then for the ball.
+static const double READY_WAIT = 1.0;
+static const double SHOT_WAIT = 5.0;
+
 Victor *Collector::grabber = NULL;
 Victor *Collector::lifter = NULL;
 SharpIR *Collector::frontIR = NULL;
 SharpIR *Collector::frontMiddleIR = NULL;
 SharpIR *Collector::middleIR = NULL;
 SharpIR *Collector::topIR = NULL;
-CollectorState Collector::collectorState = OFF;
-Timer*	Collector::prepTimer = NULL;
+unsigned Collector::balls = 0;
+unsigned Collector::shotsAtFire = 0;
+bool Collector::watchingWheels = false;
+bool Collector::topSeen = false;
+SEM_ID Collector::events = NULL;
+SEM_ID Collector::stateChanged = NULL;
+TimerWheel* Collector::timers = NULL;
+Victor* Collector::rampVictor = NULL;
+Relay* Collector::rampStrike = NULL;
+CommandQueue* Collector::commands = NULL;
+ConveyorModel* Collector::conveyor = NULL;
+BallCountEstimator* Collector::ballCount = NULL;
+IRCalibration* Collector::calibration = NULL;
+double Collector::grabberSpeed = 0.0;
+bool Collector::rejecting = false;
+unsigned Collector::activeCommand = 0;
+CollectorState Collector::activeState = OFF;
+
+// In the order of CollectorState.
+const CollectorMachine::StateSpec Collector::STATE_TABLE[COLLECTOR_STATE_COUNT] =
+{
+	// name			enter			update			exit			timeout					on timeout
+	{ "off",		NULL,			NULL,			NULL,			0.0,					OFF,				NULL },
+	{ "looking",	EnterLooking,	NULL,			NULL,			0.0,					LOOKING_FOR_BALLS,	NULL },
+	{ "stage1",		EnterStage1,	NULL,			NULL,			STAGE1_TIME,			LOOKING_FOR_BALLS,	LoseIncomingBall },
+	{ "stage2",		EnterStage2,	UpdateStage2,	NULL,			0.0,					STAGE2,				NULL },
+	{ "prepare",	EnterPrepare,	UpdatePrepare,	NULL,			PREPARE_TIME,			LOOKING_FOR_BALLS,	MissPrepare },
+	{ "shooting",	EnterShooting,	UpdateShooting,	ExitShooting,	COLLECTOR_SHOT_TIMEOUT,	LOOKING_FOR_BALLS,	MissShot },
+	{ "ejecting",	EnterEjecting,	NULL,			NULL,			EJECT_TIME,				LOOKING_FOR_BALLS,	ClearConveyor }
+};
+
+// Checked in order; the first that passes for the current state is taken.
+const CollectorMachine::Transition Collector::TRANSITION_TABLE[] =
+{
+	// Reject any balls that show up.
+	{ OFF,					SeesFrontBall,	OFF,				RejectBall },
+	{ LOOKING_FOR_BALLS,	HasStagedBall,	STAGE2,				NULL },
+	{ LOOKING_FOR_BALLS,	HasUnliftedBall,	STAGE1,			NULL },
+	{ LOOKING_FOR_BALLS,	HasRoomForBall,	STAGE1,				ShowFrontVoltage },
+	// already enough balls, kick it out of our way
+	{ LOOKING_FOR_BALLS,	SeesFrontBall,	LOOKING_FOR_BALLS,	RejectBall },
+	// Already have enough balls, kick out any balls in the way and go back to looking which will eject any new balls that appear
+	{ STAGE1,				IsFull,			LOOKING_FOR_BALLS,	RejectBall },
+	{ STAGE1,				SeesMiddleBall,	STAGE2,				NULL },
+	{ STAGE2,				IsOverFull,		LOOKING_FOR_BALLS,	RejectBall },
+	{ PREPARE_TO_SHOOT,		SeesMiddleBall,	LOOKING_FOR_BALLS,	NULL },
+	{ SHOOTING,				ShotDetected,	LOOKING_FOR_BALLS,	CountShot }
+};
+
+CollectorMachine Collector::machine(STATE_TABLE, TRANSITION_TABLE, sizeof(TRANSITION_TABLE) / sizeof(TRANSITION_TABLE[0]), OFF, OnTransition);
 
 void Collector::reservePrimaryLines() { primaryDisplay.Reserve(1); }
 void Collector::reserveSecondaryLines() { secondaryDisplay.Reserve(7); }
@@ -22,12 +119,28 @@ Collector::Collector()
 {
 	grabber = new Victor(COLLECTOR_GRABBER_CHANNEL);
 	lifter = new Victor(COLLECTOR_LIFTER_CHANNEL);
-	frontIR = new SharpIR(1, IR_FRONT_CHANNEL , COLLECTOR_FRONT_SIGNAL_VOLTAGE, COLLECTOR_FRONT_SIGNAL_TOGGLE_COUNT );
-	frontMiddleIR = new SharpIR(1, IR_FRONT_MIDDLE_CHANNEL , COLLECTOR_FRONT_MIDDLE_SIGNAL_VOLTAGE, COLLECTOR_FRONT_MIDDLE_SIGNAL_TOGGLE_COUNT );
-	middleIR = new SharpIR(1, IR_MIDDLE_CHANNEL, COLLECTOR_MIDDLE_SIGNAL_VOLTAGE, COLLECTOR_MIDDLE_SIGNAL_TOGGLE_COUNT );
-	topIR = new SharpIR(1, IR_TOP_CHANNEL , COLLECTOR_TOP_SIGNAL_VOLTAGE, COLLECTOR_TOP_SIGNAL_TOGGLE_COUNT );
-	collectorState = OFF;
-	prepTimer = new Timer();
+	frontIR = new SharpIR(1, IR_FRONT_CHANNEL , COLLECTOR_FRONT_SIGNAL_VOLTAGE, COLLECTOR_FRONT_DEBOUNCE_MS );
+	frontMiddleIR = new SharpIR(1, IR_FRONT_MIDDLE_CHANNEL , COLLECTOR_FRONT_MIDDLE_SIGNAL_VOLTAGE, COLLECTOR_FRONT_MIDDLE_DEBOUNCE_MS );
+	middleIR = new SharpIR(1, IR_MIDDLE_CHANNEL, COLLECTOR_MIDDLE_SIGNAL_VOLTAGE, COLLECTOR_MIDDLE_DEBOUNCE_MS );
+	topIR = new SharpIR(1, IR_TOP_CHANNEL , COLLECTOR_TOP_SIGNAL_VOLTAGE, COLLECTOR_TOP_DEBOUNCE_MS );
+	events = semBCreate(SEM_Q_PRIORITY, SEM_EMPTY);
+	stateChanged = semBCreate(SEM_Q_PRIORITY, SEM_EMPTY);
+	timers = new TimerWheel(TIMER_TICK);
+	commands = new CommandQueue();
+	conveyor = new ConveyorModel();
+	ballCount = new BallCountEstimator(*conveyor);
+	activeCommand = 0;
+	frontIR->RequestInterrupts(SensorInterrupt, NULL);
+	frontMiddleIR->RequestInterrupts(SensorInterrupt, NULL);
+	middleIR->RequestInterrupts(SensorInterrupt, NULL);
+	topIR->RequestInterrupts(SensorInterrupt, NULL);
+	calibration = new IRCalibration(IR_CALIBRATION_FILE);
+	calibration->SetSensor(IR_FRONT, frontIR);
+	calibration->SetSensor(IR_FRONT_MIDDLE, frontMiddleIR);
+	calibration->SetSensor(IR_MIDDLE, middleIR);
+	calibration->SetSensor(IR_TOP, topIR);
+	calibration->Load();
+	ApplyIRCalibration();
 	
 	//strike1 = new Relay(RAMP_LEFT_SPIKE_RELAY);
 	rampVictor = new Victor(RAMP_VICTOR_CHANNEL);
@@ -40,7 +153,10 @@ Collector::~Collector()
 {
 	collectorTask->Stop();
 	delete collectorTask;
+	if (machine.GetState() == SHOOTING && watchingWheels)
+		SHOOTER.GetShotDetector().NotifyOnShot(NULL);
 
+	delete calibration;
 	delete grabber;
 	delete lifter;
 	delete frontIR;
@@ -50,49 +166,156 @@ Collector::~Collector()
 	//delete strike1;
 	delete rampStrike;
 	delete rampVictor;
-	delete prepTimer;
+	delete timers;
+	delete commands;
+	delete ballCount;
+	delete conveyor;
+	semDelete(events);
+	semDelete(stateChanged);
 }
 
 bool Collector::Shoot()
 {
 	// First wait until we're ready to shoot.
-	for( int count = 0; count < 100 ; count ++ )
+	WhenReadyToShoot().Wait(READY_WAIT);
+	CommandFuture shot = Fire();
+	// Now wait until we've taken the shot
+	shot.Wait(SHOT_WAIT);
+	return shot.GetStatus() == COMMAND_DONE;
+}
+
+CommandFuture Collector::Fire()
+{
+	return Post(FIRE_COMMAND);
+}
+
+bool Collector::IsReadyToShoot()
+{
+	CollectorState state = machine.GetTarget();
+	return state == LOOKING_FOR_BALLS || state == OFF;
+}
+
+bool Collector::CallIsReadyToShoot(void* param)
+{
+	return IsReadyToShoot();
+}
+
+ConditionFuture Collector::WhenReadyToShoot()
+{
+	return ConditionFuture(stateChanged, CallIsReadyToShoot, NULL);
+}
+
+CommandFuture Collector::PrepareToShoot()
+{
+	return Post(PREPARE_COMMAND);
+}
+
+CommandFuture Collector::ManipulateRamp(RampState state)
+{
+	return Post(RAMP_COMMAND, state);
+}
+
+CommandFuture Collector::SetBallCount( int ballCount )
+{
+	return Post(SET_BALLS_COMMAND, ballCount);
+}
+
+// Turn off everything
+CommandFuture Collector::Stop()
+{
+	return Post(STOP_COMMAND);
+}
+
+// Ejects ALL Balls - as long as it is running
+CommandFuture Collector::Eject()
+{
+	return Post(EJECT_COMMAND);
+}
+
+// If collector is not doing something else, turn it on.
+CommandFuture Collector::Start()
+{
+	if( !collectorTask->Verify() )
 	{
-		if( collectorState == OFF )
-			break;
-		Wait( .01 );
+		collectorTask->Start();
+		Wait(1);
 	}
-	if( collectorState == LOOKING_FOR_BALLS || collectorState == OFF )
+	return Post(START_COMMAND);
+}
+
+CommandFuture Collector::Post(int type, int argument)
+{
+	unsigned sequence = commands->Post(type, argument);
+	if( sequence == 0 )
+		LOGGER.Logf("Collector: command queue full, dropped command %d", type);
+	Wake();
+	return CommandFuture(commands, sequence);
+}
+
+// Carry out a command on the collector task.
+void Collector::Execute(const Command& command)
+{
+	CommandStatus status = COMMAND_DONE;
+	switch( command.type )
 	{
-		collectorState = SHOOTING;
-		// Now wait until we've taken the shot
-		for( int count = 0; count < 500 ; count ++ )
+	case FIRE_COMMAND:
+		if( !IsReadyToShoot() || !HasBallToShoot() )
 		{
-			if( collectorState == LOOKING_FOR_BALLS )
-				break;
-			Wait( .01 );
+			status = COMMAND_REJECTED;
+			break;
 		}
+		shotsAtFire = SHOOTER.GetShotDetector().GetShotCount();
+		Begin(SHOOTING, command.sequence);
+		return;
+	case PREPARE_COMMAND:
+		Begin(PREPARE_TO_SHOOT, command.sequence);
+		return;
+	case EJECT_COMMAND:
+		// Held down, the button sends one a loop; the eject under way
+		// covers them.
+		if( machine.GetTarget() == EJECTING )
+			break;
+		Begin(EJECTING, command.sequence);
+		return;
+	case STOP_COMMAND:
+		Begin(OFF, 0);
+		SetGrabber(COLLECTOR_STOP);
+		lifter->Set(COLLECTOR_STOP);
+		break;
+	case START_COMMAND:
+		if( machine.GetTarget() == OFF )
+			machine.Request(LOOKING_FOR_BALLS);
+		break;
+	case RAMP_COMMAND:
+		MoveRamp((RampState)command.argument);
+		break;
+	case SET_BALLS_COMMAND:
+		ballCount->Set(command.argument);
+		break;
+	case CHANGE_BALLS_COMMAND:
+		ballCount->Change(command.argument);
+		break;
 	}
-	else
-	{
-		return false;
-	}
-	return true;
+	commands->SetStatus(command.sequence, status);
 }
 
-void Collector::PrepareToShoot()
+// Move to a state on behalf of a command, which finishes when the state
+// does. Whatever command was under way is cut short.
+void Collector::Begin(CollectorState state, unsigned command)
 {
-	collectorState = PREPARE_TO_SHOOT;
-	prepTimer->Start();
+	if( activeCommand != 0 )
+		commands->SetStatus(activeCommand, COMMAND_CANCELLED);
+	activeCommand = command;
+	activeState = state;
+	machine.Request(state);
 }
 
-void Collector::ManipulateRamp(RampState state)
+void Collector::MoveRamp(RampState state)
 {
-	static int counter = 0;
-	counter++;
-	if (collectorState == OFF || collectorState == LOOKING_FOR_BALLS)
+	CollectorState current = machine.GetTarget();
+	if (current == OFF || current == LOOKING_FOR_BALLS)
 	{
-		grabber->Set(COLLECTOR_STOP);
+		SetGrabber(COLLECTOR_STOP);
 		lifter->Set(COLLECTOR_STOP);
 		if (state == UP)
 		{
@@ -111,221 +334,384 @@ void Collector::ManipulateRamp(RampState state)
 			//strike1->Set(Relay::kOff);
 			rampStrike->Set(Relay::kOff);
 			rampVictor->Set(0.0f);
-			collectorState = LOOKING_FOR_BALLS;
+			machine.Request(LOOKING_FOR_BALLS);
 		}
 	}
 	else
 		rampStrike->Set(Relay::kOff);
 }
 
+// Tell the collector task something has changed.
+void Collector::Wake()
+{
+	semGive(events);
+}
 
-void Collector::SetBallCount( int ballCount )
+// Runs on the interrupt task when a sensor first sees a ball.
+void Collector::SensorInterrupt(UINT32 mask, void* param)
 {
-	balls = ballCount;
+	Wake();
 }
 
-// Turn off everything
-void Collector::Stop()
+// Push a ball back off the ramp. The grabber goes back to what it was doing
+// afterwards.
+void Collector::RejectBall()
 {
-	grabber->Set(COLLECTOR_STOP);
-	lifter->Set(COLLECTOR_STOP);
-	collectorState = OFF;
+	if( rejecting )
+		return;
+	rejecting = true;
+	grabber->Set( COLLECTOR_RUNFAST_REVERSE );
+	timers->Schedule(REJECT_DONE, REJECT_TIME);
 }
 
-// Ejects ALL Balls - as long as it is running
-void Collector::Eject()
+void Collector::SetGrabber(double speed)
 {
-	collectorState = EJECTING;
+	grabberSpeed = speed;
+	if( !rejecting )
+		grabber->Set(speed);
 }
 
-// If collector is not doing something else, turn it on.
-void Collector::Start()
+// Follow the balls from what the sensors see, before the motors change.
+void Collector::UpdateConveyor()
 {
-	if( collectorState == OFF )
-	{
-		collectorTask->Start();
-		Wait(1);
-		collectorState = LOOKING_FOR_BALLS;
-	}
+	ballCount->Update(Sees(frontIR) || Sees(frontMiddleIR), Sees(middleIR), Sees(topIR),
+			grabber->Get(), lifter->Get());
+	// Balls leaving a sensor do not interrupt.
+	if( conveyor->HasBallAtSensor() && (grabber->Get() != 0.0 || lifter->Get() != 0.0) )
+		Recheck(SENSOR_RECHECK_TIME);
 }
 
-void Collector::RejectBall()
+// While the lifter is busy, pull the next ball in off the ramp. Shooting,
+// the lifter takes it on from the middle sensor; staging runs the lifter
+// backwards, so stop once the ball is off the ramp and finish afterwards.
+void Collector::UpdateIntake(bool toLifter)
 {
-	grabber->Set( COLLECTOR_RUNFAST_REVERSE );
-	Wait( .5 );
-	grabber->Set( COLLECTOR_STOP );
+	unsigned incoming = conveyor->GetIncoming();
+	bool room = conveyor->GetCount() + incoming < MAX_BALLS;
+	if( conveyor->HasBallAt(BALL_AT_FRONT) && !room )
+		RejectBall();
+	else if( room && (Sees(frontIR) || Sees(frontMiddleIR)) )
+		SetGrabber(COLLECTOR_RUNFAST);
+	else if( incoming > 0 && toLifter )
+		SetGrabber(COLLECTOR_RUNFAST);
+	else
+		SetGrabber(COLLECTOR_STOP);
 }
 
-// Thread that runs continuously
+// Thread that runs continuously, sleeping until a sensor sees a ball, a
+// command comes in or a timer runs out.
 void Collector::ThreadLoop()
 {
-	Timer stage1Timer;
-	int lastStage = 0;
+	timers->Schedule(DISPLAY_REFRESH, DISPLAY_PERIOD);
 	while( true )
 	{
-		COLLECTOR.primaryDisplay.PrintfLine(0, "Balls:%d", balls);
-
-		COLLECTOR.secondaryDisplay.PrintfLine(0, "TopIR:%f", topIR->GetVoltage());
-		COLLECTOR.secondaryDisplay.PrintfLine(1, "Stage:%d", (int)collectorState);
-		COLLECTOR.secondaryDisplay.PrintfLine(2, "FrontIR:%f", frontIR->GetVoltage());
-		COLLECTOR.secondaryDisplay.PrintfLine(3, "FrMiddleIR:%f", frontMiddleIR->GetVoltage());
-		COLLECTOR.secondaryDisplay.PrintfLine(4, "MiddleIR:%f", middleIR->GetVoltage());
-		
-		switch( collectorState )
-		{
-		case OFF:
-			// Reject any balls that show up.
-			if( frontIR->Get() == BALL_VISIBLE || frontMiddleIR->Get() == BALL_VISIBLE)
-				RejectBall();
-			Wait( .01 );
-			break;
-		case LOOKING_FOR_BALLS:
-			grabber->Set(COLLECTOR_STOP);
-			lifter->Set(COLLECTOR_STOP);
-			// if we mount a sensor up front, we could turn on when we sense a ball if we have less than 2 balls
-			if( frontIR->Get() == BALL_VISIBLE || frontMiddleIR->Get() == BALL_VISIBLE)
-			{
-				if( balls < MAX_BALLS )
-				{
-					COLLECTOR.secondaryDisplay.PrintfLine(5, "SWITCH:%f", frontIR->GetVoltage());
-					stage1Timer.Reset();
-					stage1Timer.Start();
-					collectorState = STAGE1;
-				}
-				else
-				{
-					// already enough balls, kick it out of our way
-					RejectBall();
-				}
-			}
-			Wait( .01 );
-			break;
-		case STAGE1:
-			if( balls < MAX_BALLS )
-			{
-				if( stage1Timer.HasPeriodPassed(4.0) )
-				{
-					collectorState = LOOKING_FOR_BALLS;
-					stage1Timer.Stop();
-					stage1Timer.Reset();
-					break;
-				}
-				grabber->Set(COLLECTOR_RUNFAST);
-				if( middleIR->Get() == BALL_VISIBLE ) // Does bottom IR sense Ball?
-				{
-					// probably want to run this one slowly because we want to stop as soon as the IR sensor no longer senses the ball
-					grabber->Set(COLLECTOR_RUNSLOW);
-					lifter->Set(COLLECTOR_RUNSLOW);
-					collectorState = STAGE2;
-				}
-			}
-			else
-			{
-				// Already have enough balls, kick out any balls in the way and go back to looking which will eject any new balls that appear
-				collectorState = LOOKING_FOR_BALLS;
-				RejectBall();
-				stage1Timer.Stop();
-				stage1Timer.Reset();
-			}
-			break;
-		case STAGE2:
-			// middle is moving now 
-			if( balls < MAX_BALLS )//&& topIR->Get() == BALL_NOT_VISIBLE )
-			{
-				// the middle sensor no longer senses a ball? time to stop and wait for another ball to show up
-				if( middleIR->Get() == BALL_NOT_VISIBLE )
-				{
-					Wait(.1);
-					grabber->Set(COLLECTOR_STOP);
-					lifter->Set(COLLECTOR_STOP);
-					collectorState = LOOKING_FOR_BALLS;
-					balls++;
-				}
-			}
-			else
-			{
-				// Already have enough balls, kick out any balls in the way and go back to looking which will eject any new balls that appear
-				collectorState = LOOKING_FOR_BALLS;
-				RejectBall();
-			}
+		double timeToNext = timers->GetTimeToNext();
+		double timeout = machine.GetTimeToTimeout();
+		if( timeout >= 0.0 && (timeToNext < 0.0 || timeout < timeToNext) )
+			timeToNext = timeout;
+		semTake(events, timeToNext < 0.0 ? WAIT_FOREVER : (int)(timeToNext * sysClkRateGet()) + 1);
+		// Take the expired timers first, so a sensor recheck falling due
+		// now is not mistaken for one still to come.
+		unsigned expired[TimerWheel::MAX_TIMERS];
+		unsigned count = timers->Expire(expired, TimerWheel::MAX_TIMERS);
+		UpdateConveyor();
 
-			break;
-		case PREPARE_TO_SHOOT:
-			// move backwards until top sensor does not sense a ball
-			if( middleIR->Get() == BALL_VISIBLE || prepTimer->HasPeriodPassed(0.2) )
-			{
-				collectorState = LOOKING_FOR_BALLS;
-				lifter->Set( COLLECTOR_STOP );
-				prepTimer->Stop();
-				prepTimer->Reset();
-				break;
-			}
-			lifter->Set( COLLECTOR_RUNSLOW_REVERSE );
-			break;
+		Command command;
+		while( commands->Take(command) )
+			Execute(command);
 
-		case SHOOTING:
-			lifter->Set( COLLECTOR_RUNFAST );
-			
-			//This ensures that only one ball can be shot at once
-			for( unsigned i = 0; i < 3000; ++i )
-			{
-				Wait(0.001);
-				if( topIR->Get() == BALL_VISIBLE )
-					break;
-			}
-			for( unsigned i = 0; i < 3000; ++i )
-			{
-				Wait(0.001);
-				if( topIR->Get() == BALL_NOT_VISIBLE )
-				{
-					break;
-				}
-			}
-			
-			Wait(0.250);
-			
-			grabber->Set(COLLECTOR_STOP);
-			lifter->Set(COLLECTOR_STOP);
-			if (balls >= 1) 
-			{
-				balls--;
-			}
-			collectorState = LOOKING_FOR_BALLS;
-			break;
-			
-		case EJECTING:
-			grabber->Set(COLLECTOR_RUNFAST_REVERSE);
-			lifter->Set(COLLECTOR_RUNFAST_REVERSE);
-			Wait( 3.5 );
-			grabber->Set(COLLECTOR_STOP);
-			lifter->Set(COLLECTOR_STOP);
-			balls = 0;
-			collectorState = LOOKING_FOR_BALLS;
-			break;
-		}
+		for( unsigned i = 0; i < count; i++ )
+			HandleTimeout(expired[i]);
 
-		if (lastStage != collectorState) 
-		{
-			COLLECTOR.secondaryDisplay.PrintfLine(6, "Collector: %d to %d\n", lastStage, collectorState);
-			lastStage = collectorState;
-		}
-	}	
+		machine.Run();
+		balls = conveyor->GetCount();
+		semFlush(stateChanged);
+	}
 }
 
-void Collector::ChangeBallCountBy(int c)
+// Called on every change of state, before the new state is entered. A
+// command still active here saw its state through.
+void Collector::OnTransition(CollectorState from, CollectorState to)
 {
-	int tmpBalls = balls + c;
-	if (tmpBalls < 0) 
+	COLLECTOR.secondaryDisplay.PrintfLine(6, "Collector: %s to %s", machine.GetName(from), machine.GetName(to));
+	if( activeCommand != 0 && to != activeState )
 	{
-		tmpBalls = 0;
+		commands->SetStatus(activeCommand, COMMAND_DONE);
+		activeCommand = 0;
 	}
-	if (tmpBalls > (int)MAX_BALLS) {
-		tmpBalls = MAX_BALLS;
+
+	// Timers belong to the state that set them.
+	for( unsigned timer = 0; timer < DISPLAY_REFRESH; timer++ )
+		timers->Cancel(timer);
+}
+
+// The command's state gave up before it finished, so it did not succeed.
+void Collector::TimeOutCommand()
+{
+	if( activeCommand != 0 && machine.GetState() == activeState )
+	{
+		commands->SetStatus(activeCommand, COMMAND_TIMED_OUT);
+		activeCommand = 0;
 	}
-	balls = tmpBalls;
+}
+
+void Collector::EnterLooking()
+{
+	SetGrabber(COLLECTOR_STOP);
+	lifter->Set(COLLECTOR_STOP);
+}
+
+void Collector::EnterStage1()
+{
+	SetGrabber(COLLECTOR_RUNFAST);
+}
+
+void Collector::EnterStage2()
+{
+	// probably want to run this one slowly because we want to stop as soon as the IR sensor no longer senses the ball
+	SetGrabber(COLLECTOR_RUNSLOW);
+	lifter->Set(COLLECTOR_RUNSLOW);
+}
+
+void Collector::EnterPrepare()
+{
+	// move backwards until the middle sensor senses the ball
+	lifter->Set( COLLECTOR_RUNSLOW_REVERSE );
+}
+
+void Collector::EnterShooting()
+{
+	lifter->Set( COLLECTOR_RUNFAST );
+	// The wheels slow down as the ball goes through them, which says
+	// exactly when it has left. If they are not spinning, watch the top
+	// sensor instead.
+	watchingWheels = SHOOTER.GetShotDetector().IsWatching();
+	topSeen = false;
+	if( watchingWheels )
+		SHOOTER.GetShotDetector().NotifyOnShot(events);
+}
+
+void Collector::ExitShooting()
+{
+	if( watchingWheels )
+		SHOOTER.GetShotDetector().NotifyOnShot(NULL);
+}
+
+void Collector::EnterEjecting()
+{
+	SetGrabber(COLLECTOR_RUNFAST_REVERSE);
+	lifter->Set(COLLECTOR_RUNFAST_REVERSE);
+}
+
+void Collector::UpdateStage2()
+{
+	// middle is moving now
+	if( middleIR->Get() == BALL_VISIBLE )
+		Recheck(SENSOR_RECHECK_TIME);
+	else if( !timers->IsScheduled(STAGE2_SETTLE) )
+	{
+		// the middle sensor no longer senses a ball? time to stop and wait for another ball to show up
+		timers->Schedule(STAGE2_SETTLE, STAGE2_SETTLE_TIME);
+	}
+}
+
+void Collector::UpdatePrepare()
+{
+	UpdateIntake(false);
+}
+
+void Collector::UpdateShooting()
+{
+	UpdateIntake(true);
+	if( watchingWheels )
+		return;
+	if( Sees(topIR) )
+	{
+		//This ensures that only one ball can be shot at once
+		topSeen = true;
+		Recheck(SENSOR_RECHECK_TIME);
+	}
+	else if( topSeen && !timers->IsScheduled(SHOT_CLEAR) )
+		timers->Schedule(SHOT_CLEAR, SHOT_CLEAR_TIME);
+}
+
+bool Collector::SeesFrontBall()
+{
+	return Sees(frontIR) || Sees(frontMiddleIR);
+}
+
+bool Collector::HasRoomForBall()
+{
+	return SeesFrontBall() && conveyor->GetCount() + conveyor->GetIncoming() < MAX_BALLS;
+}
+
+// A ball pulled in while the lifter was busy goes the rest of the way, if
+// there is room for it; STAGE1 and STAGE2 would only turn it back. The
+// staged ball already counts.
+bool Collector::HasStagedBall()
+{
+	return conveyor->HasBallAt(BALL_AT_MIDDLE) && conveyor->HasUnliftedBall() && !IsOverFull();
+}
+
+// A ball counted at or above the middle sensor, or one the sensors see
+// there that the count has lost.
+bool Collector::HasBallToShoot()
+{
+	return conveyor->GetCount() > 0 || Sees(middleIR) || Sees(topIR);
+}
+
+bool Collector::HasUnliftedBall()
+{
+	return conveyor->HasUnliftedBall() && !IsFull();
+}
+
+bool Collector::IsFull()
+{
+	return conveyor->GetCount() >= MAX_BALLS;
+}
+
+// The ball being lifted already counts, from when the middle sensor saw it.
+bool Collector::IsOverFull()
+{
+	return conveyor->GetCount() > MAX_BALLS;
+}
+
+bool Collector::SeesMiddleBall()
+{
+	return Sees(middleIR);
+}
+
+bool Collector::ShotDetected()
+{
+	return watchingWheels && SHOOTER.GetShotDetector().GetShotCount() != shotsAtFire;
+}
+
+void Collector::ShowFrontVoltage()
+{
+	COLLECTOR.secondaryDisplay.PrintfLine(5, "SWITCH:%f", frontIR->GetVoltage());
+}
+
+void Collector::LoseIncomingBall()
+{
+	ballCount->IncomingLost();
+}
+
+void Collector::MissPrepare()
+{
+	TimeOutCommand();
+	ballCount->PrepareMissed();
+}
+
+void Collector::MissShot()
+{
+	LOGGER.Logf("Collector: no ball seen leaving the shooter");
+	TimeOutCommand();
+	ballCount->ShotMissed();
+}
+
+void Collector::CountShot()
+{
+	ballCount->ShotSeen();
+}
+
+void Collector::ClearConveyor()
+{
+	ballCount->Emptied();
+}
+
+void Collector::HandleTimeout(unsigned timer)
+{
+	// A command has moved the state on; its timers are about to go.
+	if( timer < DISPLAY_REFRESH && machine.IsChanging() )
+		return;
+
+	switch( timer )
+	{
+	case STAGE2_SETTLE:
+		ballCount->Staged();
+		machine.Request(LOOKING_FOR_BALLS);
+		break;
+	case SHOT_CLEAR:
+		CountShot();
+		machine.Request(LOOKING_FOR_BALLS);
+		break;
+	case DISPLAY_REFRESH:
+		UpdateDisplay();
+		timers->Schedule(DISPLAY_REFRESH, DISPLAY_PERIOD);
+		break;
+	case REJECT_DONE:
+		rejecting = false;
+		grabber->Set(grabberSpeed);
+		break;
+	}
+}
+
+// Whether a sensor sees a ball. One that has only just seen it wakes the
+// task again when its debounce time is up.
+bool Collector::Sees(SharpIR* sensor)
+{
+	double wait = sensor->GetTimeUntilVisible();
+	if( wait > 0.0 )
+		Recheck(wait);
+	return wait == 0.0;
+}
+
+// Look at the sensors again after a delay, unless already due sooner.
+void Collector::Recheck(double delay)
+{
+	double left = timers->GetTimeLeft(SENSOR_RECHECK);
+	if( left < 0.0 || left > delay )
+		timers->Schedule(SENSOR_RECHECK, delay);
+}
+
+void Collector::UpdateDisplay()
+{
+	COLLECTOR.primaryDisplay.PrintfLine(0, "Balls:%d (%.0f%%)", balls, 100.0 * ballCount->GetConfidence());
+
+	COLLECTOR.secondaryDisplay.PrintfLine(0, "TopIR:%f", topIR->GetVoltage());
+	COLLECTOR.secondaryDisplay.PrintfLine(1, "Stage:%s", machine.GetName(machine.GetState()));
+	COLLECTOR.secondaryDisplay.PrintfLine(2, "FrontIR:%f", frontIR->GetVoltage());
+	COLLECTOR.secondaryDisplay.PrintfLine(3, "FrMiddleIR:%f", frontMiddleIR->GetVoltage());
+	COLLECTOR.secondaryDisplay.PrintfLine(4, "MiddleIR:%f", middleIR->GetVoltage());
+}
+
+CommandFuture Collector::ChangeBallCountBy(int c)
+{
+	return Post(CHANGE_BALLS_COMMAND, c);
 }
 
 int Collector::GetBalls()
 {
 	return balls;
 }
+
+double Collector::GetBallConfidence()
+{
+	return ballCount->GetConfidence();
+}
+
+void Collector::LogStateTrace()
+{
+	for( unsigned state = 0; state < COLLECTOR_STATE_COUNT; state++ )
+		LOGGER.Logf("Collector: %.3f s in %s", machine.GetTimeIn((CollectorState)state), machine.GetName((CollectorState)state));
+
+	CollectorMachine::TraceEntry trace[CollectorMachine::TRACE_SIZE];
+	unsigned count = machine.GetTrace(trace, CollectorMachine::TRACE_SIZE);
+	for( unsigned i = 0; i < count; i++ )
+	{
+		LOGGER.Logf("Collector: %.3f %s to %s%s", trace[i].time, machine.GetName(trace[i].from),
+				machine.GetName(trace[i].to), trace[i].timedOut ? " (timed out)" : "");
+	}
+}
+
+// Sensors without calibrated limits keep the ones from Constants.h.
+void Collector::ApplyIRCalibration()
+{
+	SharpIR* sensors[IR_SENSORS] = { frontIR, frontMiddleIR, middleIR, topIR };
+	for( unsigned i = 0; i < IR_SENSORS; i++ )
+	{
+		double low, high;
+		if( calibration->GetLimits((IRSensor)i, low, high) )
+			sensors[i]->SetLimits(low, high);
+	}
+}
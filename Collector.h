@@ -5,6 +5,13 @@
 #include "Constants.h"
 #include "SharpIR.h"
 #include "DisplayWriter.h"
+#include "CommandQueue.h"
+#include "StateMachine.h"
+
+class TimerWheel;
+class ConveyorModel;
+class BallCountEstimator;
+class IRCalibration;
 
 enum CollectorState 
 {
@@ -14,9 +21,12 @@ enum CollectorState
 	STAGE2,
 	PREPARE_TO_SHOOT,
 	SHOOTING,
-	EJECTING
+	EJECTING,
+	COLLECTOR_STATE_COUNT
 };
 
+typedef StateMachine<CollectorState, COLLECTOR_STATE_COUNT> CollectorMachine;
+
 enum RampState 
 {
 	RAMP_OFF,
@@ -31,15 +41,52 @@ public:
 	~Collector();
 	
 	bool Shoot();
-	void ManipulateRamp(RampState state);
-	void Stop();
-	void Eject();
-	void Start();
-	static void SetBallCount( int balls );
-	void PrepareToShoot();
-	void ChangeBallCountBy(int c);
+
+	/*
+	 * The commands below are queued for the collector task and return at
+	 * once with a future for the command, to wait on or check later.
+	 */
+
+	/**
+	 * Start shooting one ball without waiting for it to leave. The command
+	 * is done when the ball has gone, timed out if it is never seen leaving,
+	 * or rejected if the collector is busy or has no ball to shoot.
+	 */
+	CommandFuture Fire();
+	static bool IsReadyToShoot();
+	bool IsShooting() const { return machine.GetState() == SHOOTING; }
+	CommandFuture ManipulateRamp(RampState state);
+	CommandFuture Stop();
+	CommandFuture Eject();
+	CommandFuture Start();
+	static CommandFuture SetBallCount( int balls );
+	CommandFuture PrepareToShoot();
+	CommandFuture ChangeBallCountBy(int c);
+
+	/**
+	 * \return a future done when the collector is idle and can shoot.
+	 */
+	ConditionFuture WhenReadyToShoot();
 	int GetBalls();
 
+	/**
+	 * \return how far to trust GetBalls(), from 0 to 1.
+	 */
+	double GetBallConfidence();
+	static CollectorState GetState() { return machine.GetState(); }
+
+	/**
+	 * Log the time spent in each state and the latest changes of state.
+	 */
+	void LogStateTrace();
+
+	/**
+	 * The sensor calibration, for sampling the sensors while disabled.
+	 * Call ApplyIRCalibration() once it has new limits.
+	 */
+	IRCalibration& GetIRCalibration() { return *calibration; }
+	void ApplyIRCalibration();
+
 	void reservePrimaryLines();
 	void reserveSecondaryLines();
 	
@@ -56,12 +103,72 @@ private:
 	static SharpIR *topIR;
 	Task *collectorTask;
 	//Relay *strike1;
-	Victor* rampVictor;
-	Relay *rampStrike;
-	static CollectorState collectorState;
-	static Timer* prepTimer;
+	static Victor* rampVictor;
+	static Relay *rampStrike;
+	static CollectorMachine machine;
+	static const CollectorMachine::StateSpec STATE_TABLE[COLLECTOR_STATE_COUNT];
+	static const CollectorMachine::Transition TRANSITION_TABLE[];
+	static unsigned shotsAtFire;
+	static bool watchingWheels;
+	static bool topSeen;
+	static SEM_ID events;
+	static SEM_ID stateChanged;
+	static TimerWheel* timers;
+	static CommandQueue* commands;
+	static unsigned activeCommand;
+	static CollectorState activeState;
+	static ConveyorModel* conveyor;
+	static BallCountEstimator* ballCount;
+	static IRCalibration* calibration;
+	static double grabberSpeed;
+	static bool rejecting;
 	static void ThreadLoop();
+	static CommandFuture Post(int type, int argument = 0);
+	static bool CallIsReadyToShoot(void* param);
+	static void Execute(const Command& command);
+	static void Begin(CollectorState state, unsigned command);
+	static void MoveRamp(RampState state);
+	static void Wake();
+	static void SensorInterrupt(UINT32 mask, void* param);
+	static void HandleTimeout(unsigned timer);
+	static void OnTransition(CollectorState from, CollectorState to);
+	static void TimeOutCommand();
+
+	// Entry, update and exit actions for the state table.
+	static void EnterLooking();
+	static void EnterStage1();
+	static void EnterStage2();
+	static void EnterPrepare();
+	static void EnterShooting();
+	static void ExitShooting();
+	static void EnterEjecting();
+	static void UpdateStage2();
+	static void UpdatePrepare();
+	static void UpdateShooting();
+
+	// Guards and actions for the transition table.
+	static bool SeesFrontBall();
+	static bool HasRoomForBall();
+	static bool HasStagedBall();
+	static bool HasUnliftedBall();
+	static bool HasBallToShoot();
+	static bool IsFull();
+	static bool IsOverFull();
+	static bool SeesMiddleBall();
+	static bool ShotDetected();
+	static void ShowFrontVoltage();
+	static void LoseIncomingBall();
+	static void MissPrepare();
+	static void MissShot();
+	static void CountShot();
+	static void ClearConveyor();
+	static bool Sees(SharpIR* sensor);
+	static void Recheck(double delay);
+	static void UpdateDisplay();
 	static void RejectBall();
+	static void SetGrabber(double speed);
+	static void UpdateConveyor();
+	static void UpdateIntake(bool toLifter);
 
 };
 
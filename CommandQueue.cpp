@@ -0,0 +1,68 @@
+#include "CommandQueue.h"
+
+static const UINT32 STATUS_MASK = 0xF;
+
+CommandQueue::CommandQueue() :
+		head(0),
+		tail(0)
+{
+	for (unsigned i = 0; i < HISTORY; i++)
+		statuses[i] = COMMAND_UNKNOWN;
+	finished = semBCreate(SEM_Q_PRIORITY, SEM_EMPTY);
+}
+
+CommandQueue::~CommandQueue()
+{
+	semDelete(finished);
+}
+
+unsigned CommandQueue::Post(int type, int argument)
+{
+	// VxWorks 6.3 and GCC 3.4 give us no compare-and-swap to claim a slot
+	// with, so keep other tasks off the CPU while we do. Nothing here can
+	// block.
+	taskLock();
+	if (tail - head == SIZE)
+	{
+		taskUnlock();
+		return 0;
+	}
+	unsigned sequence = tail + 1;
+	Command& command = commands[tail % SIZE];
+	command.sequence = sequence;
+	command.type = type;
+	command.argument = argument;
+	// Publish only once the command is filled in.
+	tail = sequence;
+	taskUnlock();
+	return sequence;
+}
+
+bool CommandQueue::Take(Command& command)
+{
+	if (head == tail)
+		return false;
+	command = commands[head % SIZE];
+	// Mark it running before it stops counting as queued.
+	SetStatus(command.sequence, COMMAND_RUNNING);
+	head = head + 1;
+	return true;
+}
+
+void CommandQueue::SetStatus(unsigned sequence, CommandStatus status)
+{
+	statuses[sequence % HISTORY] = (sequence << STATUS_BITS) | status;
+	if (status != COMMAND_QUEUED && status != COMMAND_RUNNING)
+		semFlush(finished);
+}
+
+CommandStatus CommandQueue::GetStatus(unsigned sequence) const
+{
+	unsigned taken = head;
+	if ((INT32)(sequence - taken) > 0)
+		return (INT32)(sequence - tail) <= 0 ? COMMAND_QUEUED : COMMAND_UNKNOWN;
+	UINT32 word = statuses[sequence % HISTORY];
+	if ((word >> STATUS_BITS) != (sequence & (0xFFFFFFFF >> STATUS_BITS)))
+		return COMMAND_UNKNOWN;
+	return (CommandStatus)(word & STATUS_MASK);
+}
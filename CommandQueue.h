@@ -0,0 +1,118 @@
+#ifndef COMMANDQUEUE_H
+#define COMMANDQUEUE_H
+
+#include <WPILib.h>
+#include "Future.h"
+
+enum CommandStatus
+{
+	COMMAND_UNKNOWN,	// too old to remember, or never posted
+	COMMAND_QUEUED,
+	COMMAND_RUNNING,
+	COMMAND_DONE,
+	COMMAND_REJECTED,	// the consumer could not carry it out
+	COMMAND_CANCELLED,	// a later command took over before it finished
+	COMMAND_TIMED_OUT	// the consumer gave up waiting for it to finish
+};
+
+class CommandQueue;
+
+struct Command
+{
+	unsigned sequence;
+	int type;
+	int argument;
+};
+
+/**
+ * Commands from any task to one consumer task, with a status for each.
+ *
+ * Posting takes the task lock for the few instructions it needs to claim a
+ * slot, so it never blocks on a semaphore. The consumer takes commands and
+ * updates their statuses without any lock, and anyone may read a status
+ * at any time: each slot has a single writer, and the status is stored in
+ * the same word as its sequence number.
+ *
+ * Sequence numbers count up from 1, so 0 never names a command.
+ */
+class CommandQueue
+{
+public:
+	CommandQueue();
+	~CommandQueue();
+
+	/**
+	 * \return the command's sequence number, or 0 if the queue is full.
+	 */
+	unsigned Post(int type, int argument = 0);
+
+	/**
+	 * Take the oldest command and mark it running. Consumer only.
+	 *
+	 * \return false if there is none.
+	 */
+	bool Take(Command& command);
+
+	/**
+	 * Consumer only.
+	 */
+	void SetStatus(unsigned sequence, CommandStatus status);
+
+	CommandStatus GetStatus(unsigned sequence) const;
+
+	/**
+	 * \return flushed each time a command finishes.
+	 */
+	SEM_ID GetFinishedSignal() const { return finished; }
+
+private:
+	static const unsigned SIZE = 16;
+	// How many statuses are remembered.
+	static const unsigned HISTORY = 256;
+	static const unsigned STATUS_BITS = 4;
+
+	Command commands[SIZE];
+	volatile unsigned head;		// commands taken, written by the consumer
+	volatile unsigned tail;		// commands posted, written under the task lock
+	volatile UINT32 statuses[HISTORY];
+	SEM_ID finished;
+};
+
+/**
+ * A handle on a posted command, done once it has finished one way or
+ * another.
+ */
+class CommandFuture : public Future
+{
+public:
+	CommandFuture() : Future(NULL), queue(NULL), sequence(0) {}
+	CommandFuture(CommandQueue* queue, unsigned sequence) :
+			Future(queue->GetFinishedSignal()),
+			queue(queue),
+			sequence(sequence)
+	{
+	}
+
+	/**
+	 * \return false if the queue was full and the command never posted.
+	 */
+	bool IsPosted() const { return sequence != 0; }
+	unsigned GetSequence() const { return sequence; }
+
+	CommandStatus GetStatus() const
+	{
+		return sequence != 0 ? queue->GetStatus(sequence) : COMMAND_UNKNOWN;
+	}
+
+	virtual bool IsDone() const
+	{
+		CommandStatus status = GetStatus();
+		return status != COMMAND_QUEUED && status != COMMAND_RUNNING;
+	}
+
+private:
+	CommandQueue* queue;
+	unsigned sequence;
+};
+
+#endif // COMMANDQUEUE_H
@@ -59,16 +59,48 @@ const unsigned TURRET_ENCODER_A         = 9;
 const unsigned TURRET_ENCODER_B     	= 10;
 
 
+// Camera constants (point CAMERA_ADDRESS at a host running
+// tools/MjpegReplayServer to replay recorded frames)
+const char* const CAMERA_ADDRESS		= "10.25.2.11";
+const unsigned CAMERA_PORT				= 80;
+const unsigned CAMERA_FPS				= 30;
+const double CAMERA_HALF_FOV			= 23.5;	// degrees, Axis M1011
+
 // Analog constants
 const unsigned IR_FRONT_CHANNEL         = 1;
 const unsigned IR_FRONT_MIDDLE_CHANNEL	= 2;
 const unsigned IR_MIDDLE_CHANNEL        = 3;
 const unsigned IR_TOP_CHANNEL           = 4;
+// The gyro needs one of the two accumulator channels, 1 and 2, and the
+// front IR sensors have both. 0 leaves it out.
+const unsigned GYRO_CHANNEL				= 0;
+
+// Drive constants
+const double DRIVE_WHEEL_DIAMETER		= 6.0 / 12.0;	///\todo measure
+const unsigned DRIVE_ENCODER_PULSES		= 250;	///\todo check the encoder and gearing
+const double DRIVE_MAX_SPEED			= 12.0;	// feet per second at full stick ///\todo measure
+const double DRIVE_TRACK_WIDTH			= 22.0 / 12.0;	// between the wheel centers ///\todo measure
+// Set so a positive Jaguar command counts up.
+const bool DRIVE_LEFT_ENCODER_REVERSED	= false;	///\todo check
+const bool DRIVE_RIGHT_ENCODER_REVERSED	= false;	///\todo check
+// Run the wheel-speed loops. Until the constants above are measured the
+// loops would fight the driver, so the sticks go straight to the Jaguars.
+const bool DRIVE_CLOSED_LOOP			= false;	///\todo turn on once measured
 
 // Shooter constants
 const double TURRET_SIGNAL_VOLTAGE		= 3.0;
 const double TURRET_SPEED				= 0.25;
 const unsigned TURRET_ENCODER_PULSES	= 100; // Found this
+// The encoder counts both edges of both channels, four counts a pulse.
+const double TURRET_DEGREES_PER_COUNT	= (TURRET_WHEEL_DIAMETER / TURRET_LAZY_SUSAN_DIAMETER) * 360.0 / (4 * TURRET_ENCODER_PULSES);
+// The turret is settled this close to its setpoint, and vision calls it
+// aligned this close to the target. Aligned has to take in settled and a
+// few pixels of noise, or the turret keeps re-aiming at what it cannot reach.
+const double TURRET_SETTLED_ERROR		= 2 * TURRET_DEGREES_PER_COUNT;	// about 0.4 degrees
+const double TURRET_ALIGN_TOLERANCE		= TURRET_SETTLED_ERROR + 0.5;	// degrees
+// Feed balls as soon as the wheels recover. Off until it has been shown to
+// score as well as waiting for the wheels to settle.
+const bool RAPID_FIRE					= false;
 
 // Collector Constants
 const unsigned BALL_VISIBLE									= 1;
@@ -83,11 +115,13 @@ const double   COLLECTOR_FRONT_SIGNAL_VOLTAGE 				= 0.5;
 const double   COLLECTOR_FRONT_MIDDLE_SIGNAL_VOLTAGE 		= 0.8;
 const double   COLLECTOR_MIDDLE_SIGNAL_VOLTAGE 				= 1.5;
 const double   COLLECTOR_TOP_SIGNAL_VOLTAGE 				= 0.85;
-const unsigned COLLECTOR_FRONT_SIGNAL_TOGGLE_COUNT			= 20; 
-const unsigned COLLECTOR_FRONT_MIDDLE_SIGNAL_TOGGLE_COUNT	= 40; 
-const unsigned COLLECTOR_MIDDLE_SIGNAL_TOGGLE_COUNT			= 10; 
-const unsigned COLLECTOR_TOP_SIGNAL_TOGGLE_COUNT			= 20;
+// How long each sensor must see a ball before it counts, in milliseconds.
+const unsigned COLLECTOR_FRONT_DEBOUNCE_MS					= 200;
+const unsigned COLLECTOR_FRONT_MIDDLE_DEBOUNCE_MS			= 400;
+const unsigned COLLECTOR_MIDDLE_DEBOUNCE_MS					= 10;
+const unsigned COLLECTOR_TOP_DEBOUNCE_MS					= 20;
 const unsigned COLLECTOR_WAIT_TIME							= 3000;
+const double   COLLECTOR_SHOT_TIMEOUT						= 3.0;	// seconds for a fired ball to reach the wheels
 
 // Button Mappings
 const unsigned TURRET_BUTTON					= 2;
@@ -97,6 +131,13 @@ const unsigned RAMP_UP_BUTTON					= 3;
 const unsigned EJECT_BALLS_BUTTON				= 6;
 const unsigned COLLECTOR_ADD_BALL_BUTTON		= 8;
 const unsigned COLLECTOR_SUB_BALL_BUTTON		= 7;
+const unsigned SHOT_SHORT_BUTTON				= 10;
+const unsigned SHOT_LONG_BUTTON					= 12;
+// IR sensor calibration, only while disabled
+const unsigned IR_SAMPLE_EMPTY_BUTTON			= 7;	// hold with the conveyor empty
+const unsigned IR_SAMPLE_BALL_BUTTON			= 8;	// hold with a ball at the selected sensor
+const unsigned IR_NEXT_SENSOR_BUTTON			= 10;
+const unsigned IR_SAVE_CALIBRATION_BUTTON		= 12;
 
 // Vision Target Indexers
 const unsigned TOP_TARGET						= 0;
@@ -108,7 +149,9 @@ const unsigned BOTTOM_TARGET					= 3;
 #define ROBOT (Singleton<Robot>::GetInstance())
 #define COLLECTOR (Singleton<Collector>::GetInstance())
 #define SHOOTER (Singleton<Shooter>::GetInstance())
+#define SEQUENCER (Singleton<ShotSequencer>::GetInstance())
 #define DRIVETRAIN (Singleton<DriveTrain>::GetInstance())
+#define POSE (Singleton<PoseEstimator>::GetInstance())
 #define VISION (Singleton<Vision>::GetInstance())
 #define SQUAREFINDER (Singleton<SquareFinder>::GetInstance())
 #define LOGGER (Singleton<Logger>::GetInstance())
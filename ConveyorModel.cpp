@@ -0,0 +1,212 @@
+#include "ConveyorModel.h"
+
+ConveyorModel::ConveyorModel() :
+		count(0)
+{
+}
+
+unsigned ConveyorModel::Update(bool frontSeen, bool middleSeen, bool topSeen, double grabber, double lifter)
+{
+	unsigned found = 0;
+	// Work down from the shooter so each ball moves into a place the one
+	// above it has just left.
+	int top = FindHighest(BALL_AT_TOP);
+	if (topSeen && top < 0)
+	{
+		int above = FindLowest(BALL_IN_SHOOTER);
+		int below = FindHighest(BALL_IN_LIFTER);
+		if (lifter < 0.0 && above >= 0)
+			balls[above].position = BALL_AT_TOP;
+		else if (below >= 0)
+			balls[below].position = BALL_AT_TOP;
+		else
+		{
+			Insert(BALL_AT_TOP, true);
+			found++;
+		}
+	}
+	else if (!topSeen && top >= 0)
+	{
+		if (lifter > 0.0)
+			balls[top].position = BALL_IN_SHOOTER;
+		else if (lifter < 0.0)
+			balls[top].position = BALL_IN_LIFTER;
+	}
+
+	int middle = FindHighest(BALL_AT_MIDDLE);
+	if (middleSeen && middle < 0)
+	{
+		int above = FindLowest(BALL_IN_LIFTER);
+		int below = FindHighest(BALL_IN_GRABBER);
+		if (lifter < 0.0 && above >= 0)
+			balls[above].position = BALL_AT_MIDDLE;
+		else if (below >= 0)
+			balls[below].position = BALL_AT_MIDDLE;
+		else if (above >= 0)
+			balls[above].position = BALL_AT_MIDDLE;
+		else
+		{
+			Insert(BALL_AT_MIDDLE, false);
+			found++;
+		}
+	}
+	else if (!middleSeen && middle >= 0)
+	{
+		if (lifter > 0.0)
+		{
+			balls[middle].position = BALL_IN_LIFTER;
+			balls[middle].lifted = true;
+		}
+		else if (lifter < 0.0 || grabber < 0.0)
+			balls[middle].position = BALL_IN_GRABBER;
+	}
+
+	int front = FindHighest(BALL_AT_FRONT);
+	if (frontSeen && front < 0)
+	{
+		int grabbed = FindLowest(BALL_IN_GRABBER);
+		if (grabber < 0.0 && grabbed >= 0)
+			balls[grabbed].position = BALL_AT_FRONT;
+		else
+			Insert(BALL_AT_FRONT, false);
+	}
+	else if (!frontSeen && front >= 0)
+	{
+		// Pulled in, or pushed or rolled back off the ramp.
+		if (grabber > 0.0)
+			balls[front].position = BALL_IN_GRABBER;
+		else
+			Remove(front);
+	}
+	return found;
+}
+
+bool ConveyorModel::IsCollected(const Ball& ball)
+{
+	return ball.position >= BALL_AT_MIDDLE || ball.lifted;
+}
+
+unsigned ConveyorModel::GetCount() const
+{
+	unsigned collected = 0;
+	for (unsigned i = 0; i < count; i++)
+	{
+		if (IsCollected(balls[i]))
+			collected++;
+	}
+	return collected;
+}
+
+unsigned ConveyorModel::GetIncoming() const
+{
+	unsigned incoming = 0;
+	for (unsigned i = 0; i < count; i++)
+	{
+		if (balls[i].position == BALL_IN_GRABBER && !balls[i].lifted)
+			incoming++;
+	}
+	return incoming;
+}
+
+bool ConveyorModel::HasBallAt(BallPosition position) const
+{
+	return FindHighest(position) >= 0;
+}
+
+bool ConveyorModel::HasUnliftedBall() const
+{
+	for (unsigned i = 0; i < count; i++)
+	{
+		if (!balls[i].lifted && (balls[i].position == BALL_AT_MIDDLE || balls[i].position == BALL_IN_GRABBER))
+			return true;
+	}
+	return false;
+}
+
+bool ConveyorModel::HasBallAtSensor() const
+{
+	return HasBallAt(BALL_AT_FRONT) || HasBallAt(BALL_AT_MIDDLE) || HasBallAt(BALL_AT_TOP);
+}
+
+void ConveyorModel::RemoveShot()
+{
+	if (count > 0 && IsCollected(balls[0]))
+		Remove(0);
+}
+
+void ConveyorModel::RemoveIncoming()
+{
+	for (int i = count - 1; i >= 0; i--)
+	{
+		if (balls[i].position == BALL_IN_GRABBER && !balls[i].lifted)
+		{
+			Remove(i);
+			return;
+		}
+	}
+}
+
+unsigned ConveyorModel::RemoveLifted()
+{
+	unsigned removed = 0;
+	while (count > 0 && balls[0].position > BALL_AT_MIDDLE)
+	{
+		Remove(0);
+		removed++;
+	}
+	return removed;
+}
+
+void ConveyorModel::SetCount(unsigned collected)
+{
+	while (GetCount() < collected && count < MAX_TRACKED)
+		Insert(BALL_IN_LIFTER, true);
+	for (int i = count - 1; i >= 0 && GetCount() > collected; i--)
+	{
+		if (IsCollected(balls[i]))
+			Remove(i);
+	}
+}
+
+int ConveyorModel::FindHighest(BallPosition position) const
+{
+	for (unsigned i = 0; i < count; i++)
+	{
+		if (balls[i].position == position)
+			return i;
+	}
+	return -1;
+}
+
+int ConveyorModel::FindLowest(BallPosition position) const
+{
+	for (int i = count - 1; i >= 0; i--)
+	{
+		if (balls[i].position == position)
+			return i;
+	}
+	return -1;
+}
+
+// Below any balls already there.
+void ConveyorModel::Insert(BallPosition position, bool lifted)
+{
+	if (count == MAX_TRACKED)
+		return;
+	unsigned index = count;
+	while (index > 0 && balls[index - 1].position < position)
+	{
+		balls[index] = balls[index - 1];
+		index--;
+	}
+	balls[index].position = position;
+	balls[index].lifted = lifted;
+	count++;
+}
+
+void ConveyorModel::Remove(unsigned index)
+{
+	for (unsigned i = index; i + 1 < count; i++)
+		balls[i] = balls[i + 1];
+	count--;
+}
@@ -0,0 +1,114 @@
+#ifndef CONVEYORMODEL_H
+#define CONVEYORMODEL_H
+
+#include <WPILib.h>
+
+/**
+ * Where a ball is along the conveyor, from the ramp to the shooter.
+ */
+enum BallPosition
+{
+	BALL_AT_FRONT,		// seen by the front or front-middle sensor
+	BALL_IN_GRABBER,	// between the front and middle sensors
+	BALL_AT_MIDDLE,
+	BALL_IN_LIFTER,		// between the middle and top sensors
+	BALL_AT_TOP,
+	BALL_IN_SHOOTER		// past the top sensor, not yet seen leaving
+};
+
+/**
+ * Keeps track of each ball on the conveyor.
+ *
+ * Balls are followed from sensor to sensor: when a sensor starts or stops
+ * seeing a ball, the ball next to it moves in or out of view, in whichever
+ * direction the motors have been running. A ball showing up where none
+ * was expected is added there. Only the collector task should use it.
+ */
+class ConveyorModel
+{
+public:
+	static const unsigned MAX_TRACKED = 6;
+
+	ConveyorModel();
+
+	/**
+	 * Move the balls along. Call this whenever the sensors may have
+	 * changed, before changing the motors.
+	 *
+	 * \param frontSeen true if either front sensor sees a ball.
+	 * \param grabber the grabber output since the last update.
+	 * \param lifter the lifter output since the last update.
+	 * \return the number of balls found at the middle or top sensor that
+	 * were not being tracked.
+	 */
+	unsigned Update(bool frontSeen, bool middleSeen, bool topSeen, double grabber, double lifter);
+
+	/**
+	 * \return the number of balls collected: those that have reached the
+	 * middle sensor and not been shot.
+	 */
+	unsigned GetCount() const;
+
+	/**
+	 * \return the number of balls pulled in off the ramp that have not yet
+	 * reached the middle sensor.
+	 */
+	unsigned GetIncoming() const;
+
+	bool HasBallAt(BallPosition position) const;
+
+	/**
+	 * \return true if a ball at or below the middle sensor has yet to be
+	 * lifted past it.
+	 */
+	bool HasUnliftedBall() const;
+
+	/**
+	 * \return true if a sensor is seeing one of the balls, so it will stop
+	 * seeing it when the conveyor moves.
+	 */
+	bool HasBallAtSensor() const;
+
+	/**
+	 * The highest ball has gone into the shooter.
+	 */
+	void RemoveShot();
+
+	/**
+	 * The ball being pulled in never reached the middle sensor.
+	 */
+	void RemoveIncoming();
+
+	/**
+	 * Nothing is left above the middle sensor.
+	 *
+	 * \return the number of balls taken away.
+	 */
+	unsigned RemoveLifted();
+
+	/**
+	 * Correct the number of balls collected, adding balls to the lifter or
+	 * taking the lowest away.
+	 */
+	void SetCount(unsigned balls);
+	void Clear() { count = 0; }
+
+private:
+	struct Ball
+	{
+		BallPosition position;
+		bool lifted;		// has been above the middle sensor
+	};
+
+	int FindHighest(BallPosition position) const;
+	int FindLowest(BallPosition position) const;
+	void Insert(BallPosition position, bool lifted);
+	void Remove(unsigned index);
+	static bool IsCollected(const Ball& ball);
+
+	// Highest, nearest the shooter, first.
+	Ball balls[MAX_TRACKED];
+	unsigned count;
+};
+
+#endif // CONVEYORMODEL_H
@@ -1,3 +1,4 @@
+#include <cstdio>
 
 #include "Singleton.h"
 #include "DisplayWriter.h"
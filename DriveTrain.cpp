@@ -1,4 +1,5 @@
 #include <cmath>
+#include <cstring>
 
 #include <WPILib.h>
 
@@ -9,25 +10,81 @@
 #include "Logger.h"
 #include "Singleton.h"
 
+static const double LOOP_PERIOD = 0.01;
+// The feedforward was measured at this voltage and is scaled up as the
+// battery sags.
+static const double NOMINAL_VOLTAGE = 12.0;
+// Below this the driver station reading is taken to be missing.
+static const double MIN_BATTERY_VOLTAGE = 6.0;
+// Most the integral term may add or take away from the feedforward, enough
+// to push through carpet and a worn gearbox.
+static const double MAX_TRIM = 0.3;
+// Pushing at least this hard for ENCODER_FAULT_TIME with the side going
+// slower than MIN_ENCODER_SPEED (or backwards) means the encoder has failed.
+static const double STALL_OUTPUT = 0.9;
+static const double MIN_ENCODER_SPEED = 0.5;	// feet per second
+static const double ENCODER_FAULT_TIME = 0.5;
+
+// Feedforward, from the output needed to hold speed with the wheels off
+// the ground.
+static const double DEFAULT_KS = 0.05; ///\todo characterize on carpet
+static const double DEFAULT_KV = 1.0 / DRIVE_MAX_SPEED;
+static const double DEFAULT_P = 0.1;
+static const double DEFAULT_I = 0.5;
+
 DriveTrain::DriveTrain()
 {
 	enabled = true;
+	closedLoop = DRIVE_CLOSED_LOOP;
+	p = DEFAULT_P;
+	i = DEFAULT_I;
+	kS = DEFAULT_KS;
+	kV = DEFAULT_KV;
 	
 	Singleton<Logger>::GetInstance().Logf("DriveTrain() initializing.");
 
-	this->left = new Jaguar(1, 1);
-	this->right = new Jaguar(1, 2);
+	memset(&left, 0, sizeof(left));
+	memset(&right, 0, sizeof(right));
+	left.motor = new Jaguar(1, 1);
+	right.motor = new Jaguar(1, 2);
+	left.forward = 1.0;
+	right.forward = -1.0;
+
+	left.motor->SetSafetyEnabled(false);
+	right.motor->SetSafetyEnabled(false);
 
-	this->left->SetSafetyEnabled(false);
-	this->right->SetSafetyEnabled(false);
+	left.encoder = new Encoder(DRIVE_LEFT_ENCODER_A, DRIVE_LEFT_ENCODER_B, DRIVE_LEFT_ENCODER_REVERSED);
+	right.encoder = new Encoder(DRIVE_RIGHT_ENCODER_A, DRIVE_RIGHT_ENCODER_B, DRIVE_RIGHT_ENCODER_REVERSED);
+	left.encoder->SetDistancePerPulse(PI * DRIVE_WHEEL_DIAMETER / DRIVE_ENCODER_PULSES);
+	right.encoder->SetDistancePerPulse(PI * DRIVE_WHEEL_DIAMETER / DRIVE_ENCODER_PULSES);
+	left.encoder->Start();
+	right.encoder->Start();
+	// So the first speeds are not averaged back to the start of time.
+	double now = Timer::GetFPGATimestamp();
+	for (unsigned n = 0; n < RATE_SAMPLES; n++)
+	{
+		left.times[n] = now;
+		right.times[n] = now;
+	}
+
+	lock = semMCreate(SEM_Q_PRIORITY | SEM_DELETE_SAFE | SEM_INVERSION_SAFE);
+	loop = new Notifier(CallUpdate, this);
+	loop->StartPeriodic(LOOP_PERIOD);
 }
 
 DriveTrain::~DriveTrain()
 {
 	LOGGER.Logf("~DriveTrain() stopping.");
 
-	delete this->left;
-	delete this->right;
+	loop->Stop();
+	delete loop;
+	left.motor->Set(0.0);
+	right.motor->Set(0.0);
+	delete left.encoder;
+	delete right.encoder;
+	delete left.motor;
+	delete right.motor;
+	semDelete(lock);
 }
 
 void DriveTrain::DriveArcade(double twist, double speed)
@@ -38,8 +95,9 @@ void DriveTrain::DriveArcade(double twist, double speed)
 	}
 	twist *= -1.0;
 	speed *= -1.0;
-	left->Set(-1.0 * speed + twist);
-	right->Set(speed + twist);
+	Synchronized sync(lock);
+	Command(left, -1.0 * speed + twist);
+	Command(right, speed + twist);
 }
 
 void DriveTrain::DriveTank(double leftChannel, double rightChannel)
@@ -48,8 +106,9 @@ void DriveTrain::DriveTank(double leftChannel, double rightChannel)
 		leftChannel = 0.0;
 		rightChannel = 0.0;
 	}
-	left->Set(-1.0 * leftChannel);
-	right->Set(-1.0 * rightChannel);
+	Synchronized sync(lock);
+	Command(left, -1.0 * leftChannel);
+	Command(right, -1.0 * rightChannel);
 }
 
 void DriveTrain::ReservePrimaryLines()
@@ -67,7 +126,8 @@ void DriveTrain::SetLeft(double value)
 	if(!enabled) {
 		value = 0.0;
 	}
-	left->Set(value);
+	Synchronized sync(lock);
+	Command(left, value);
 }
 
 void DriveTrain::SetRight(double value) 
@@ -75,5 +135,153 @@ void DriveTrain::SetRight(double value)
 	if(!enabled) {
 		value = 0.0;
 	}
-	right->Set(value);
+	Synchronized sync(lock);
+	Command(right, value);
+}
+
+void DriveTrain::SetClosedLoop(bool closedLoop)
+{
+	Synchronized sync(lock);
+	if (closedLoop == this->closedLoop)
+		return;
+	LOGGER.Logf("DriveTrain: %s loop", closedLoop ? "closed" : "open");
+	this->closedLoop = closedLoop;
+	Command(left, 0.0);
+	Command(right, 0.0);
+}
+
+void DriveTrain::SetPI(double p, double i)
+{
+	Synchronized sync(lock);
+	this->p = p;
+	this->i = i;
+	left.integral = 0.0;
+	right.integral = 0.0;
+}
+
+void DriveTrain::SetFeedforward(double kS, double kV)
+{
+	Synchronized sync(lock);
+	this->kS = kS;
+	this->kV = kV;
+}
+
+double DriveTrain::GetLeftDistance() const
+{
+	return left.forward * left.encoder->GetDistance();
+}
+
+double DriveTrain::GetRightDistance() const
+{
+	return right.forward * right.encoder->GetDistance();
+}
+
+double DriveTrain::GetLeftSpeed() const
+{
+	Synchronized sync(lock);
+	return left.forward * left.speed;
+}
+
+double DriveTrain::GetRightSpeed() const
+{
+	Synchronized sync(lock);
+	return right.forward * right.speed;
+}
+
+// Open loop the value goes straight to the Jaguar; closed loop it becomes
+// the side's speed setpoint.
+void DriveTrain::Command(Side& side, double value)
+{
+	if (value > 1.0)
+		value = 1.0;
+	else if (value < -1.0)
+		value = -1.0;
+	if (!closedLoop)
+	{
+		side.setpoint = 0.0;
+		side.integral = 0.0;
+		side.output = value;
+		side.motor->Set(value);
+		return;
+	}
+	double setpoint = value * DRIVE_MAX_SPEED;
+	// Trim learned one way is no help the other.
+	if (setpoint * side.setpoint <= 0.0)
+		side.integral = 0.0;
+	side.setpoint = setpoint;
+}
+
+void DriveTrain::CallUpdate(void* drive)
+{
+	((DriveTrain*)drive)->Update();
+}
+
+void DriveTrain::Update()
+{
+	double voltage = DriverStation::GetInstance()->GetBatteryVoltage();
+	if (voltage < MIN_BATTERY_VOLTAGE)
+		voltage = NOMINAL_VOLTAGE;
+	double now = Timer::GetFPGATimestamp();
+
+	Synchronized sync(lock);
+	bool leftFollowing = UpdateSide(left, now, NOMINAL_VOLTAGE / voltage);
+	bool rightFollowing = UpdateSide(right, now, NOMINAL_VOLTAGE / voltage);
+	if (!leftFollowing || !rightFollowing)
+	{
+		// Otherwise the loop keeps the motors at full output.
+		LOGGER.LogfLater("DriveTrain: %s encoder not following its motor, open loop", leftFollowing ? "right" : "left");
+		closedLoop = false;
+		Command(left, 0.0);
+		Command(right, 0.0);
+	}
+}
+
+// \return false if the encoder has stopped following the motor.
+bool DriveTrain::UpdateSide(Side& side, double now, double voltageScale)
+{
+	// Difference the distance over a few loops; a single loop is only a
+	// pulse or two at low speed.
+	double distance = side.encoder->GetDistance();
+	double elapsed = now - side.times[side.next];
+	if (elapsed > 0.0)
+		side.speed = (distance - side.distances[side.next]) / elapsed;
+	side.distances[side.next] = distance;
+	side.times[side.next] = now;
+	side.next = (side.next + 1) % RATE_SAMPLES;
+
+	if (!closedLoop)
+	{
+		side.stalledFor = 0.0;
+		return true;
+	}
+	if (side.setpoint == 0.0)
+	{
+		side.output = 0.0;
+		side.integral = 0.0;
+		side.stalledFor = 0.0;
+		side.motor->Set(0.0);
+		return true;
+	}
+
+	double error = side.setpoint - side.speed;
+	if (i != 0.0)
+	{
+		side.integral += error * LOOP_PERIOD;
+		if (fabs(i * side.integral) > MAX_TRIM)
+			side.integral = (side.integral > 0 ? MAX_TRIM : -MAX_TRIM) / i;
+	}
+	double feedforward = (side.setpoint > 0.0 ? kS : -kS) + kV * side.setpoint;
+	side.output = feedforward * voltageScale + p * error + i * side.integral;
+	if (side.output > 1.0)
+		side.output = 1.0;
+	else if (side.output < -1.0)
+		side.output = -1.0;
+	side.motor->Set(side.output);
+
+	double following = side.output > 0.0 ? side.speed : -side.speed;
+	if (fabs(side.output) >= STALL_OUTPUT && following < MIN_ENCODER_SPEED)
+		side.stalledFor += LOOP_PERIOD;
+	else
+		side.stalledFor = 0.0;
+	return side.stalledFor < ENCODER_FAULT_TIME;
 }
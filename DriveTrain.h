@@ -2,11 +2,22 @@
 #define DRIVETRAIN_H
 
 #include <WPILib.h>
+#include "DisplayWriter.h"
 
+class Encoder;
 class Jaguar;
 
 /**
  * The drivetrain of our Robot.
+ *
+ * Each side runs its own wheel-speed loop on a notifier, so a given stick
+ * position asks for the same speed whatever the battery charge or the
+ * carpet. A feedforward scaled by the battery voltage supplies most of the
+ * output, and a PI loop on the encoder rate trims out the rest. Driving
+ * inputs from -1 to 1 are fractions of DRIVE_MAX_SPEED.
+ *
+ * The loops are only on when DRIVE_CLOSED_LOOP says so. A side whose
+ * encoder stops following its motor drops the drivetrain back to open loop.
  */
 class DriveTrain
 {
@@ -33,20 +44,82 @@ public:
 	void PIDWrite(float output);
 	void ReservePrimaryLines();
 	void ReserveSecondaryLines();
+
+	/**
+	 * \param value the left side's Jaguar command, from -1 to 1.
+	 */
 	void SetLeft(double value);
+
+	/**
+	 * \param value the right side's Jaguar command, from -1 to 1.
+	 */
 	void SetRight(double value);
 	
 	void setEnabled(bool enabled) { this->enabled = enabled; }
+
+	/**
+	 * \param closedLoop false to send commands straight to the Jaguars, as
+	 * when an encoder has failed.
+	 */
+	void SetClosedLoop(bool closedLoop);
+	bool IsClosedLoop() const { return closedLoop; }
+	void SetPI(double p, double i);
+	void SetFeedforward(double kS, double kV);
+
+	/**
+	 * \return the distance each side has travelled (in feet), positive
+	 * driving forward.
+	 */
+	double GetLeftDistance() const;
+	double GetRightDistance() const;
+
+	/**
+	 * \return each side's measured speed (in feet per second), positive
+	 * driving forward.
+	 */
+	double GetLeftSpeed() const;
+	double GetRightSpeed() const;
 	
 private:
+	static const unsigned RATE_SAMPLES = 5;
+
+	/**
+	 * One side's motor, encoder and loop state. Speeds are signed like the
+	 * Jaguar command, so a positive command gives a positive rate.
+	 */
+	struct Side
+	{
+		Jaguar* motor;
+		Encoder* encoder;
+		double forward;			// the command sign that drives forward
+		double setpoint;		// feet per second
+		double integral;
+		double output;
+		double speed;
+		double stalledFor;		// seconds pushing hard without the encoder following
+		double distances[RATE_SAMPLES];
+		double times[RATE_SAMPLES];
+		unsigned next;
+	};
+
+	static void CallUpdate(void* drive);
+	void Update();
+	bool UpdateSide(Side& side, double now, double voltageScale);
+	void Command(Side& side, double value);
+
 	DisplayWriter primaryDisplay;
 	DisplayWriter secondaryDisplay;
 
-	Jaguar* left;
-	Jaguar* right;
+	Side left;
+	Side right;
 	RobotDrive* roboDrive;
+	Notifier* loop;
+	SEM_ID lock;
 	
 	bool enabled;
+	bool closedLoop;
+	double p, i;
+	double kS, kV;
 };
 
 #endif // DRIVETRAIN_H
@@ -0,0 +1,252 @@
+#include <WPILib.h>
+#include "nivision.h"
+#include <cstdio>
+#include <cstring>
+
+#include "Constants.h"
+#include "ExposureControl.h"
+#include "Logger.h"
+#include "MjpegClient.h"
+#include "Singleton.h"
+
+// Luminance the tape pixels inside a target's bounding box should reach.
+static const int TARGET_SATURATION = 230;
+// Luminance 95% of the frame (mostly background) should stay below.
+static const int BACKGROUND_CEILING = 90;
+// With no targets in view, keep the brightest 0.5% of the frame here.
+static const int SEARCH_HIGHLIGHT = 245;
+// Consecutive good or bad frames before locking or unlocking the threshold.
+static const int SETTLE_FRAMES = 15;
+// Axis param.cgi writes are slow; don't issue them more often than this.
+static const double WRITE_PERIOD = 0.25;
+// Below the vision task, so a slow camera only delays the settings.
+static const INT32 WRITER_PRIORITY = 150;
+static const int EXPOSURE_MIN = 0;
+static const int EXPOSURE_MAX = 100;
+static const int BRIGHTNESS_MIN = 0;
+static const int BRIGHTNESS_MAX = 100;
+
+void ExposureControl::Histogram::Clear()
+{
+	memset(bins, 0, sizeof(bins));
+	total = 0;
+}
+
+int ExposureControl::Histogram::Percentile(double fraction) const
+{
+	unsigned wanted = (unsigned)(fraction * total);
+	unsigned seen = 0;
+	for (int i = 0; i < 256; i++)
+	{
+		seen += bins[i];
+		if (seen > wanted)
+			return i;
+	}
+	return 255;
+}
+
+ExposureControl::ExposureControl(MjpegClient* camera) :
+		camera(camera),
+		queuedExposure(-1),
+		queuedBrightness(-1),
+		holdQueued(false),
+		exposure(50),
+		brightness(30),
+		threshold(-1),
+		settledFrames(0),
+		unsettledFrames(0),
+		locked(false),
+		configured(false)
+{
+	lock = semMCreate(SEM_Q_PRIORITY | SEM_DELETE_SAFE | SEM_INVERSION_SAFE);
+	queued = semBCreate(SEM_Q_PRIORITY, SEM_EMPTY);
+	writerTask = new Task("2502Ex", (FUNCPTR)WriterLoop, WRITER_PRIORITY);
+	writerTask->Start((UINT32)this);
+	writeTimer.Start();
+}
+
+ExposureControl::~ExposureControl()
+{
+	writerTask->Stop();
+	delete writerTask;
+	semDelete(queued);
+	semDelete(lock);
+}
+
+void ExposureControl::Accumulate(const ImageInfo& info, int left, int top, int width, int height, int step, Histogram& histogram)
+{
+	if (left < 0)
+		left = 0;
+	if (top < 0)
+		top = 0;
+	if (left + width > info.xRes)
+		width = info.xRes - left;
+	if (top + height > info.yRes)
+		height = info.yRes - top;
+
+	const unsigned char* pixels = (const unsigned char*)info.imageStart;
+	for (int y = top; y < top + height; y += step)
+	{
+		const unsigned char* row = pixels + y * info.pixelsPerLine;
+		for (int x = left; x < left + width; x += step)
+			histogram.bins[row[x]]++;
+	}
+	histogram.total = 0;
+	for (int i = 0; i < 256; i++)
+		histogram.total += histogram.bins[i];
+}
+
+void ExposureControl::Update(Image* luminance, const vector<TargetReport>& targets, int count)
+{
+	ImageInfo info;
+	if (!luminance || !imaqGetImageInfo(luminance, &info))
+		return;
+
+	if (!configured)
+	{
+		// Take the sensor out of auto exposure so our settings stick.
+		{
+			Synchronized sync(lock);
+			holdQueued = true;
+		}
+		QueueSettings();
+		configured = true;
+	}
+
+	// The whole frame is dominated by background; sample it sparsely.
+	frameHistogram.Clear();
+	Accumulate(info, 0, 0, info.xRes, info.yRes, 4, frameHistogram);
+	int background = frameHistogram.Percentile(0.95);
+
+	int exposureStep = 0;
+	bool settled = false;
+	if (count > 0)
+	{
+		// Only the tape itself matters: sample the bounding boxes of the targets.
+		targetHistogram.Clear();
+		for (int i = 0; i < count; i++)
+			Accumulate(info, (int)targets[i].x, (int)targets[i].y, (int)targets[i].width, (int)targets[i].height, 1, targetHistogram);
+
+		// The boxes include the dark inside of each rectangle, so look at the upper part of the distribution.
+		int targetLevel = targetHistogram.Percentile(0.70);
+		if (targetLevel < TARGET_SATURATION && background < BACKGROUND_CEILING)
+			exposureStep = 1 + (TARGET_SATURATION - targetLevel) / 20;
+		else if (background >= BACKGROUND_CEILING)
+			exposureStep = -(1 + (background - BACKGROUND_CEILING) / 20);
+
+		settled = (exposureStep == 0);
+		if (settled)
+			threshold = (background + targetLevel) / 2;
+	}
+	else
+	{
+		int highlight = frameHistogram.Percentile(0.995);
+		if (highlight < SEARCH_HIGHLIGHT - 20)
+			exposureStep = 1 + (SEARCH_HIGHLIGHT - highlight) / 20;
+		else if (background >= BACKGROUND_CEILING)
+			exposureStep = -(1 + (background - BACKGROUND_CEILING) / 20);
+	}
+
+	if (settled)
+	{
+		unsettledFrames = 0;
+		if (!locked && ++settledFrames >= SETTLE_FRAMES)
+		{
+			locked = true;
+			LOGGER.Logf("ExposureControl: locked at exposure %d brightness %d threshold %d", exposure, brightness, threshold);
+		}
+	}
+	else
+	{
+		settledFrames = 0;
+		if (locked && ++unsettledFrames >= SETTLE_FRAMES)
+		{
+			locked = false;
+			LOGGER.Logf("ExposureControl: unlocked, background %d", background);
+		}
+	}
+
+	if (exposureStep != 0 && writeTimer.HasPeriodPassed(WRITE_PERIOD))
+	{
+		Adjust(exposureStep);
+		writeTimer.Reset();
+	}
+}
+
+// Move exposure first; once it is pinned at a limit, move brightness.
+void ExposureControl::Adjust(int exposureStep)
+{
+	int newExposure = exposure + exposureStep;
+	int newBrightness = brightness;
+	if (newExposure > EXPOSURE_MAX)
+	{
+		newBrightness += newExposure - EXPOSURE_MAX;
+		newExposure = EXPOSURE_MAX;
+	}
+	else if (newExposure < EXPOSURE_MIN)
+	{
+		newBrightness += newExposure - EXPOSURE_MIN;
+		newExposure = EXPOSURE_MIN;
+	}
+	if (newBrightness > BRIGHTNESS_MAX)
+		newBrightness = BRIGHTNESS_MAX;
+	if (newBrightness < BRIGHTNESS_MIN)
+		newBrightness = BRIGHTNESS_MIN;
+
+	if (newExposure == exposure && newBrightness == brightness)
+		return;
+	exposure = newExposure;
+	brightness = newBrightness;
+	QueueSettings();
+}
+
+// Replaces whatever the writer has not picked up yet.
+void ExposureControl::QueueSettings()
+{
+	{
+		Synchronized sync(lock);
+		queuedExposure = exposure;
+		queuedBrightness = brightness;
+	}
+	semGive(queued);
+}
+
+int ExposureControl::WriterLoop(ExposureControl* control)
+{
+	while (true)
+	{
+		semTake(control->queued, WAIT_FOREVER);
+		control->WriteQueued();
+	}
+	return 0;
+}
+
+void ExposureControl::WriteQueued()
+{
+	bool hold;
+	int newExposure;
+	int newBrightness;
+	{
+		Synchronized sync(lock);
+		hold = holdQueued;
+		newExposure = queuedExposure;
+		newBrightness = queuedBrightness;
+		holdQueued = false;
+		queuedExposure = -1;
+		queuedBrightness = -1;
+	}
+
+	if (hold)
+		camera->WriteParameter("ImageSource.I0.Sensor.Exposure", "hold");
+	char value[8];
+	if (newExposure >= 0)
+	{
+		snprintf(value, sizeof(value), "%d", newExposure);
+		camera->WriteParameter("ImageSource.I0.Sensor.ExposureValue", value);
+	}
+	if (newBrightness >= 0)
+	{
+		snprintf(value, sizeof(value), "%d", newBrightness);
+		camera->WriteParameter("ImageSource.I0.Sensor.Brightness", value);
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef EXPOSURECONTROL_H
+#define EXPOSURECONTROL_H
+
+#include "WPILib.h"
+#include "nivision.h"
+#include "Vision.h"
+#include <vector>
+
+class MjpegClient;
+
+/**
+ * Drives the camera's exposure and brightness from the luminance histogram
+ * so the retro-reflective targets stay saturated and the background stays
+ * dark. Once both hold steadily the image can be binarized with a single
+ * fixed threshold instead of an adaptive one.
+ *
+ * The camera takes a while to answer a param.cgi write, so the settings are
+ * written by a low-priority task of its own. The vision task only leaves the
+ * latest values for it, and any it had not got round to are skipped.
+ */
+class ExposureControl
+{
+public:
+	ExposureControl(MjpegClient* camera);
+	~ExposureControl();
+
+	/**
+	 * Feed one frame's luminance plane and the targets found in it.
+	 */
+	void Update(Image* luminance, const vector<TargetReport>& targets, int count);
+
+	/**
+	 * \return the fixed binarization threshold, or -1 while the exposure
+	 * has not settled and adaptive thresholding should be used.
+	 */
+	int GetThreshold() const { return locked ? threshold : -1; }
+
+	bool IsLocked() const { return locked; }
+	int GetExposure() const { return exposure; }
+	int GetBrightness() const { return brightness; }
+
+private:
+	struct Histogram
+	{
+		unsigned bins[256];
+		unsigned total;
+
+		void Clear();
+		int Percentile(double fraction) const;
+	};
+
+	void Accumulate(const ImageInfo& info, int left, int top, int width, int height, int step, Histogram& histogram);
+	void Adjust(int exposureStep);
+	void QueueSettings();
+	static int WriterLoop(ExposureControl* control);
+	void WriteQueued();
+
+	MjpegClient* camera;
+	Task* writerTask;
+	SEM_ID lock;
+	SEM_ID queued;
+	int queuedExposure;
+	int queuedBrightness;
+	bool holdQueued;
+	Histogram targetHistogram;
+	Histogram frameHistogram;
+	Timer writeTimer;
+	int exposure;
+	int brightness;
+	int threshold;
+	int settledFrames;
+	int unsettledFrames;
+	bool locked;
+	bool configured;
+};
+
+#endif // EXPOSURECONTROL_H
@@ -0,0 +1,197 @@
+#include <cmath>
+#include "Constants.h"
+#include "FlywheelController.h"
+#include "Logger.h"
+#include "SingleChannelEncoder.h"
+#include "Singleton.h"
+
+static const double LOOP_PERIOD = 0.01;
+static const double RATE_WINDOW = 0.02;
+// Run flat out until the wheel is this close to its setpoint (rps).
+static const double BANG_BANG_BAND = 2.0;
+// Close enough to shoot (rps).
+static const double READY_TOLERANCE = 0.25;
+// Most the integral term may add or take away from the feedforward.
+static const double MAX_TRIM = 0.15;
+// A drop this far below the setpoint after reaching it means a ball (rps).
+static const double DIP_THRESHOLD = 1.0;
+
+// Feedforward, from the output needed to hold speed on blocks.
+static const double DEFAULT_KS = 0.04; ///\todo recharacterize after the wheel swap
+static const double DEFAULT_KV = 0.024;
+// The PID only trims the feedforward, so it is much softer than the old
+// PIDController's 0.12 and 0.013 (per 50 ms), which had to carry the wheel.
+static const double DEFAULT_P = 0.02;
+static const double DEFAULT_I = 0.02;
+static const double DEFAULT_D = 0.0;
+
+FlywheelController::FlywheelController(const char* name, SpeedController& motor, SingleChannelEncoder& encoder, bool reversed) :
+		name(name),
+		motor(motor),
+		encoder(encoder),
+		direction(reversed ? -1.0 : 1.0),
+		readySignal(NULL),
+		p(DEFAULT_P), i(DEFAULT_I), d(DEFAULT_D),
+		kS(DEFAULT_KS), kV(DEFAULT_KV),
+		setpoint(0.0),
+		integral(0.0),
+		lastError(0.0),
+		output(0.0),
+		readiness(encoder, READY_TOLERANCE),
+		lastFlatOut(0.0),
+		spinUpStart(0.0),
+		timeToReady(-1.0),
+		armed(false),
+		dipping(false),
+		dipStart(0.0),
+		dipLowest(0.0),
+		dipCount(0),
+		lastDipDepth(0.0),
+		lastRecoveryTime(0.0)
+{
+	lock = semMCreate(SEM_Q_PRIORITY | SEM_DELETE_SAFE | SEM_INVERSION_SAFE);
+	loop = new Notifier(CallUpdate, this);
+	loop->StartPeriodic(LOOP_PERIOD);
+}
+
+FlywheelController::~FlywheelController()
+{
+	loop->Stop();
+	delete loop;
+	motor.Set(0.0);
+	semDelete(lock);
+}
+
+void FlywheelController::SetSpeed(double speed)
+{
+	Synchronized sync(lock);
+	if (speed < 0.0)
+		speed = 0.0;
+	if (fabs(speed - setpoint) <= READY_TOLERANCE)
+	{
+		setpoint = speed;
+		return;
+	}
+
+	// A new target: start timing the spin-up.
+	if (speed > setpoint || timeToReady >= 0.0)
+	{
+		spinUpStart = Timer::GetFPGATimestamp();
+		timeToReady = -1.0;
+	}
+	setpoint = speed;
+	armed = false;
+	dipping = false;
+}
+
+// Flat out, the wheel heads for its free speed, not the setpoint, so its
+// trend only says when it will settle once the fit has seen nothing else.
+double FlywheelController::GetSettleTime() const
+{
+	if (setpoint <= 0.0 || Timer::GetFPGATimestamp() - lastFlatOut < ReadinessEstimator::FIT_WINDOW)
+		return -1.0;
+	return readiness.GetSettleTime();
+}
+
+void FlywheelController::SetPID(double p, double i, double d)
+{
+	Synchronized sync(lock);
+	this->p = p;
+	this->i = i;
+	this->d = d;
+	integral = 0.0;
+}
+
+void FlywheelController::SetFeedforward(double kS, double kV)
+{
+	Synchronized sync(lock);
+	this->kS = kS;
+	this->kV = kV;
+}
+
+void FlywheelController::CallUpdate(void* controller)
+{
+	((FlywheelController*)controller)->Update();
+}
+
+void FlywheelController::Update()
+{
+	Synchronized sync(lock);
+	if (setpoint <= 0.0)
+	{
+		output = 0.0;
+		motor.Set(0.0);
+		integral = 0.0;
+		lastError = 0.0;
+		readiness.Update(0.0);
+		armed = false;
+		dipping = false;
+		return;
+	}
+
+	double speed = encoder.GetRate(RATE_WINDOW);
+	double error = setpoint - speed;
+	if (error > BANG_BANG_BAND)
+	{
+		output = 1.0;
+		integral = 0.0;
+		lastFlatOut = Timer::GetFPGATimestamp();
+	}
+	else
+	{
+		if (i != 0.0)
+		{
+			integral += error * LOOP_PERIOD;
+			if (fabs(i * integral) > MAX_TRIM)
+				integral = (integral > 0 ? MAX_TRIM : -MAX_TRIM) / i;
+		}
+		output = kS + kV * setpoint + p * error + i * integral + d * (error - lastError) / LOOP_PERIOD;
+	}
+	lastError = error;
+
+	// Never brake the wheel; let it coast down.
+	if (output > 1.0)
+		output = 1.0;
+	else if (output < 0.0)
+		output = 0.0;
+	motor.Set(direction * output);
+
+	readiness.Update(setpoint);
+	if (readiness.IsReady() && timeToReady < 0.0)
+	{
+		timeToReady = Timer::GetFPGATimestamp() - spinUpStart;
+		LOGGER.LogfLater("Flywheel %s: ready at %.1f rps in %.3f s", name, setpoint, timeToReady);
+	}
+	if (readiness.IsReady())
+		armed = true;
+	if (readiness.IsInTolerance() && readySignal != NULL)
+		semFlush(readySignal);
+	if (armed)
+		TrackDip(speed, error);
+}
+
+void FlywheelController::TrackDip(double speed, double error)
+{
+	double now = Timer::GetFPGATimestamp();
+	if (!dipping)
+	{
+		if (error > DIP_THRESHOLD)
+		{
+			dipping = true;
+			dipStart = now;
+			dipLowest = speed;
+		}
+		return;
+	}
+
+	if (speed < dipLowest)
+		dipLowest = speed;
+	if (readiness.IsInTolerance())
+	{
+		dipping = false;
+		dipCount++;
+		lastDipDepth = setpoint - dipLowest;
+		lastRecoveryTime = now - dipStart;
+		LOGGER.LogfLater("Flywheel %s: dipped %.2f rps, back in %.3f s", name, lastDipDepth, lastRecoveryTime);
+	}
+}
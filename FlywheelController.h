@@ -0,0 +1,125 @@
+#ifndef FLYWHEELCONTROLLER_H
+#define FLYWHEELCONTROLLER_H
+
+#include <WPILib.h>
+#include "ReadinessEstimator.h"
+
+class SingleChannelEncoder;
+
+/**
+ * Speed control for one shooter wheel.
+ *
+ * Far below the setpoint the motor runs flat out. Near it, a characterized
+ * feedforward (kS + kV * speed) supplies almost all of the output and a
+ * small PID trims the rest. Runs on its own notifier.
+ */
+class FlywheelController
+{
+public:
+	/**
+	 * \param name used in log messages.
+	 * \param motor the wheel's motor controller.
+	 * \param encoder the wheel's speed sensor.
+	 * \param reversed true if a negative motor output spins the wheel forward.
+	 */
+	FlywheelController(const char* name, SpeedController& motor, SingleChannelEncoder& encoder, bool reversed);
+	~FlywheelController();
+
+	/**
+	 * \param speed the wheel speed (in revolutions per second), 0 to coast.
+	 */
+	void SetSpeed(double speed);
+	double GetSpeed() const { return setpoint; }
+
+	/**
+	 * \return the last output sent to the motor, before any reversal.
+	 */
+	double GetOutput() const { return output; }
+
+	/**
+	 * \return true once the wheel is surely at its setpoint and staying there.
+	 */
+	bool IsAtSpeed() const { return setpoint > 0.0 && readiness.IsReady(); }
+
+	/**
+	 * \return true if the estimated speed is within tolerance.
+	 */
+	bool IsInTolerance() const { return setpoint > 0.0 && readiness.IsInTolerance(); }
+
+	/**
+	 * \return the predicted time until the wheel is at speed (in seconds), 0
+	 * if it is, or a negative number if it cannot tell.
+	 */
+	double GetSettleTime() const;
+
+	void Stop() { SetSpeed(0.0); }
+
+	/**
+	 * \param signal flushed each loop the wheel is within tolerance, for
+	 * tasks waiting for it to get there.
+	 */
+	void SetReadySignal(SEM_ID signal) { readySignal = signal; }
+	void SetPID(double p, double i, double d);
+	void SetFeedforward(double kS, double kV);
+
+	/**
+	 * \return how long the last spin-up took to reach speed (in seconds),
+	 * or a negative number if it has not got there yet.
+	 */
+	double GetTimeToReady() const { return timeToReady; }
+
+	/**
+	 * A ball passing through the wheel pulls its speed down. Once the wheel
+	 * has been at speed, each drop of more than a set amount counts as a dip,
+	 * and the dip ends when the wheel is back within tolerance.
+	 *
+	 * \return the number of dips since the controller was created.
+	 */
+	unsigned GetDipCount() const { return dipCount; }
+	bool IsDipping() const { return dipping; }
+
+	/**
+	 * \return how far the speed fell in the last finished dip (in rps).
+	 */
+	double GetLastDipDepth() const { return lastDipDepth; }
+
+	/**
+	 * \return how long the wheel took to recover from the last finished dip
+	 * (in seconds).
+	 */
+	double GetLastRecoveryTime() const { return lastRecoveryTime; }
+
+private:
+	static void CallUpdate(void* controller);
+	void Update();
+	void TrackDip(double speed, double error);
+
+	const char* name;
+	SpeedController& motor;
+	SingleChannelEncoder& encoder;
+	double direction;
+	Notifier* loop;
+	SEM_ID lock;
+	SEM_ID readySignal;
+
+	double p, i, d;
+	double kS, kV;
+	double setpoint;
+	double integral;
+	double lastError;
+	double output;
+	ReadinessEstimator readiness;
+	double lastFlatOut;
+	double spinUpStart;
+	double timeToReady;
+
+	bool armed;
+	bool dipping;
+	double dipStart;
+	double dipLowest;
+	unsigned dipCount;
+	double lastDipDepth;
+	double lastRecoveryTime;
+};
+
+#endif // FLYWHEELCONTROLLER_H
@@ -0,0 +1,32 @@
+#include "Future.h"
+
+bool Future::Wait(double timeout) const
+{
+	double end = Timer::GetFPGATimestamp() + timeout;
+	// With preemption locked, the working task cannot finish between the
+	// check and the semTake, so its flush cannot be missed. VxWorks lets
+	// other tasks run again while this one is blocked.
+	taskLock();
+	bool done;
+	while (!(done = IsDone()))
+	{
+		double remaining = end - Timer::GetFPGATimestamp();
+		if (remaining <= 0.0)
+			break;
+		semTake(signal, (int)(remaining * sysClkRateGet()) + 1);
+	}
+	taskUnlock();
+	return done;
+}
+
+bool Future::WaitAll(const Future* const* futures, unsigned count, double timeout)
+{
+	double end = Timer::GetFPGATimestamp() + timeout;
+	for (unsigned i = 0; i < count; i++)
+	{
+		double remaining = end - Timer::GetFPGATimestamp();
+		if (!futures[i]->Wait(remaining > 0.0 ? remaining : 0.0))
+			return false;
+	}
+	return true;
+}
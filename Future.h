@@ -0,0 +1,70 @@
+#ifndef FUTURE_H
+#define FUTURE_H
+
+#include <WPILib.h>
+
+/**
+ * Something another task will finish, to wait for without polling.
+ *
+ * The task doing the work flushes a semaphore whenever what it owns may
+ * have finished, and waiters sleep on it, checking again each time they
+ * wake. Futures are small values; copy them freely.
+ */
+class Future
+{
+public:
+	virtual ~Future() {}
+
+	virtual bool IsDone() const = 0;
+
+	/**
+	 * \param timeout how long to wait (in seconds).
+	 * \return true if it is done.
+	 */
+	bool Wait(double timeout) const;
+
+	/**
+	 * Wait for several futures, which may come from different tasks.
+	 *
+	 * \param timeout how long to wait for all of them (in seconds).
+	 * \return true if they are all done.
+	 */
+	static bool WaitAll(const Future* const* futures, unsigned count, double timeout);
+
+protected:
+	/**
+	 * \param signal flushed by the task doing the work.
+	 */
+	explicit Future(SEM_ID signal) : signal(signal) {}
+
+private:
+	SEM_ID signal;
+};
+
+/**
+ * A future done when a condition holds.
+ */
+class ConditionFuture : public Future
+{
+public:
+	typedef bool (*Condition)(void* param);
+
+	/**
+	 * \param signal flushed whenever the condition may have come true.
+	 * \param condition checks the condition; must not block.
+	 */
+	ConditionFuture(SEM_ID signal, Condition condition, void* param) :
+			Future(signal),
+			condition(condition),
+			param(param)
+	{
+	}
+
+	virtual bool IsDone() const { return condition(param); }
+
+private:
+	Condition condition;
+	void* param;
+};
+
+#endif // FUTURE_H
@@ -0,0 +1,272 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include "Constants.h"
+#include "IRCalibration.h"
+#include "Logger.h"
+#include "Singleton.h"
+
+using std::string;
+
+static const double SAMPLE_PERIOD = 0.005;
+static const double BIN_WIDTH = 0.02;		// volts
+// Samples of each kind needed before a sensor is calibrated, a second's
+// worth.
+static const unsigned MIN_SAMPLES = 200;
+// Readings this rare at either end are taken to be glitches.
+static const double TRIM_FRACTION = 0.005;
+// The least hysteresis to use when the two histograms overlap (volts).
+static const double MIN_HYSTERESIS = 0.05;
+
+static const char* const SENSOR_NAMES[IR_SENSORS] = { "front", "frontMiddle", "middle", "top" };
+
+IRCalibration::IRCalibration(const string& fileName) :
+		fileName(fileName),
+		sampling(false),
+		sampledSensor(IR_SENSORS)
+{
+	lock = semMCreate(SEM_Q_PRIORITY | SEM_DELETE_SAFE | SEM_INVERSION_SAFE);
+	for (unsigned i = 0; i < IR_SENSORS; i++)
+	{
+		channels[i] = NULL;
+		haveLimits[i] = false;
+		low[i] = 0.0;
+		high[i] = 0.0;
+	}
+	Clear();
+	sampler = new Notifier(CallSample, this);
+}
+
+IRCalibration::~IRCalibration()
+{
+	sampler->Stop();
+	delete sampler;
+	semDelete(lock);
+}
+
+void IRCalibration::SetSensor(IRSensor sensor, AnalogChannel* channel)
+{
+	Synchronized sync(lock);
+	channels[sensor] = channel;
+}
+
+const char* IRCalibration::GetName(IRSensor sensor)
+{
+	return sensor < IR_SENSORS ? SENSOR_NAMES[sensor] : "all";
+}
+
+bool IRCalibration::Load()
+{
+	Synchronized sync(lock);
+	std::ifstream file(fileName.c_str());
+	unsigned loaded = 0;
+	string line;
+	while (file && std::getline(file, line))
+	{
+		string::size_type comment = line.find('#');
+		if (comment != string::npos)
+			line.erase(comment);
+		char name[32];
+		double lowLimit, highLimit;
+		if (sscanf(line.c_str(), "%31s %lf %lf", name, &lowLimit, &highLimit) != 3 || lowLimit >= highLimit)
+			continue;
+		for (unsigned i = 0; i < IR_SENSORS; i++)
+		{
+			if (strcmp(name, SENSOR_NAMES[i]) == 0)
+			{
+				haveLimits[i] = true;
+				low[i] = lowLimit;
+				high[i] = highLimit;
+				loaded++;
+			}
+		}
+	}
+	if (loaded == 0)
+	{
+		LOGGER.Logf("IRCalibration: no limits in %s, using the defaults", fileName.c_str());
+		return false;
+	}
+	LOGGER.Logf("IRCalibration: loaded limits for %u sensors from %s", loaded, fileName.c_str());
+	return true;
+}
+
+bool IRCalibration::Save() const
+{
+	Synchronized sync(lock);
+	std::ofstream file(fileName.c_str(), std::ios::trunc);
+	if (!file)
+	{
+		LOGGER.Logf("IRCalibration: could not write %s", fileName.c_str());
+		return false;
+	}
+	file << "# sensor low(V) high(V)" << std::endl;
+	for (unsigned i = 0; i < IR_SENSORS; i++)
+	{
+		if (!haveLimits[i])
+			continue;
+		char line[80];
+		sprintf(line, "%s %.3f %.3f", SENSOR_NAMES[i], low[i], high[i]);
+		file << line << std::endl;
+	}
+	return true;
+}
+
+bool IRCalibration::GetLimits(IRSensor sensor, double& lowLimit, double& highLimit) const
+{
+	Synchronized sync(lock);
+	if (!haveLimits[sensor])
+		return false;
+	lowLimit = low[sensor];
+	highLimit = high[sensor];
+	return true;
+}
+
+void IRCalibration::StartSampling(IRSensor sensor)
+{
+	Synchronized sync(lock);
+	sampledSensor = sensor;
+	if (!sampling)
+	{
+		sampling = true;
+		sampler->StartPeriodic(SAMPLE_PERIOD);
+	}
+}
+
+void IRCalibration::StopSampling()
+{
+	{
+		Synchronized sync(lock);
+		if (!sampling)
+			return;
+		sampling = false;
+	}
+	sampler->Stop();
+}
+
+unsigned IRCalibration::GetSampleCount(IRSensor sensor, bool withBall) const
+{
+	Synchronized sync(lock);
+	return withBall ? ball[sensor].total : empty[sensor].total;
+}
+
+void IRCalibration::Clear()
+{
+	Synchronized sync(lock);
+	memset(empty, 0, sizeof(empty));
+	memset(ball, 0, sizeof(ball));
+}
+
+void IRCalibration::CallSample(void* calibration)
+{
+	((IRCalibration*)calibration)->Sample();
+}
+
+void IRCalibration::Sample()
+{
+	Synchronized sync(lock);
+	if (!sampling)
+		return;
+	for (unsigned i = 0; i < IR_SENSORS; i++)
+	{
+		if (channels[i] == NULL)
+			continue;
+		Histogram* histogram;
+		if (sampledSensor == IR_SENSORS)
+			histogram = &empty[i];
+		else if (sampledSensor == (IRSensor)i)
+			histogram = &ball[i];
+		else
+			continue;
+		histogram->counts[GetBin(channels[i]->GetAverageVoltage())]++;
+		histogram->total++;
+	}
+}
+
+unsigned IRCalibration::GetBin(double voltage)
+{
+	if (voltage <= 0.0)
+		return 0;
+	unsigned bin = (unsigned)(voltage / BIN_WIDTH);
+	return bin < BINS ? bin : BINS - 1;
+}
+
+// The bottom of a bin.
+double IRCalibration::GetVoltage(unsigned bin)
+{
+	return bin * BIN_WIDTH;
+}
+
+// The bottom of the bin holding the sample a fraction of the way up.
+double IRCalibration::Percentile(const Histogram& histogram, double fraction)
+{
+	UINT32 wanted = (UINT32)(fraction * histogram.total);
+	UINT32 below = 0;
+	for (unsigned bin = 0; bin < BINS; bin++)
+	{
+		below += histogram.counts[bin];
+		if (below > wanted)
+			return GetVoltage(bin);
+	}
+	return GetVoltage(BINS - 1);
+}
+
+// The bin edge that misclassifies the smallest fraction of the samples of
+// each kind, added together.
+double IRCalibration::BestThreshold(const Histogram& emptyReadings, const Histogram& ballReadings, double& error)
+{
+	UINT32 emptyAbove = emptyReadings.total;
+	UINT32 ballBelow = 0;
+	double best = 0.0;
+	error = 2.0;
+	for (unsigned bin = 0; bin < BINS; bin++)
+	{
+		double misses = (double)emptyAbove / emptyReadings.total + (double)ballBelow / ballReadings.total;
+		if (misses < error)
+		{
+			error = misses;
+			best = GetVoltage(bin);
+		}
+		emptyAbove -= emptyReadings.counts[bin];
+		ballBelow += ballReadings.counts[bin];
+	}
+	return best;
+}
+
+unsigned IRCalibration::Compute()
+{
+	Synchronized sync(lock);
+	unsigned calibrated = 0;
+	for (unsigned i = 0; i < IR_SENSORS; i++)
+		if (Compute((IRSensor)i))
+			calibrated++;
+	return calibrated;
+}
+
+bool IRCalibration::Compute(IRSensor sensor)
+{
+	const Histogram& emptyReadings = empty[sensor];
+	const Histogram& ballReadings = ball[sensor];
+	if (emptyReadings.total < MIN_SAMPLES || ballReadings.total < MIN_SAMPLES)
+		return false;
+
+	double emptyHighest = Percentile(emptyReadings, 1.0 - TRIM_FRACTION) + BIN_WIDTH;
+	double ballLowest = Percentile(ballReadings, TRIM_FRACTION);
+	double gap = ballLowest - emptyHighest;
+	if (gap > 0.0)
+	{
+		low[sensor] = emptyHighest + gap / 4;
+		high[sensor] = ballLowest - gap / 4;
+	}
+	else
+	{
+		double error;
+		high[sensor] = BestThreshold(emptyReadings, ballReadings, error);
+		low[sensor] = high[sensor] > MIN_HYSTERESIS ? high[sensor] - MIN_HYSTERESIS : 0.0;
+		LOGGER.Logf("IRCalibration: %s readings overlap by %.2f V, %.1f%% misread", SENSOR_NAMES[sensor], -gap,
+				100.0 * error);
+	}
+	haveLimits[sensor] = true;
+	LOGGER.Logf("IRCalibration: %s empty up to %.2f V, ball from %.2f V, limits %.2f-%.2f V", SENSOR_NAMES[sensor],
+			emptyHighest, ballLowest, low[sensor], high[sensor]);
+	return true;
+}
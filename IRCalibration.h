@@ -0,0 +1,116 @@
+#ifndef IRCALIBRATION_H
+#define IRCALIBRATION_H
+
+#include <WPILib.h>
+#include <string>
+
+/**
+ * The collector's ball sensors, in calibration order.
+ */
+enum IRSensor
+{
+	IR_FRONT,
+	IR_FRONT_MIDDLE,
+	IR_MIDDLE,
+	IR_TOP,
+	IR_SENSORS
+};
+
+/**
+ * Trigger limits for the IR ball sensors, measured rather than guessed.
+ *
+ * While sampling, the sensors' averaged voltages are binned into two
+ * histograms each: one taken with the conveyor empty and one with a ball
+ * held in front of the sensor. Trimming the rare outliers off each, the
+ * limits go in the gap between the highest empty reading and the lowest
+ * ball reading, a quarter of the way in from each side, so the hysteresis
+ * is half the gap. If the two overlap, the threshold that misclassifies
+ * the fewest samples is used instead, and a warning logged.
+ *
+ * The limits are saved to a text file with one "sensor low high" line per
+ * sensor (volts); '#' starts a comment.
+ */
+class IRCalibration
+{
+public:
+	/**
+	 * \param fileName where the limits are loaded from and saved to.
+	 */
+	IRCalibration(const std::string& fileName);
+	~IRCalibration();
+
+	/**
+	 * \param sensor which sensor the channel is; the caller keeps it.
+	 */
+	void SetSensor(IRSensor sensor, AnalogChannel* channel);
+
+	/**
+	 * \return true if limits for at least one sensor were read.
+	 */
+	bool Load();
+
+	/**
+	 * \return true if the limits were written.
+	 */
+	bool Save() const;
+
+	/**
+	 * \return true if there are limits for the sensor, from the file or
+	 * from calibrating.
+	 */
+	bool GetLimits(IRSensor sensor, double& low, double& high) const;
+	static const char* GetName(IRSensor sensor);
+
+	/**
+	 * Start adding samples, or switch what they are added to.
+	 *
+	 * \param sensor the sensor with a ball in front of it, or IR_SENSORS
+	 * for all of them with none.
+	 */
+	void StartSampling(IRSensor sensor);
+	void StopSampling();
+	unsigned GetSampleCount(IRSensor sensor, bool ball) const;
+
+	/**
+	 * Pick limits for every sensor with enough samples of both kinds.
+	 *
+	 * \return the number of sensors given new limits.
+	 */
+	unsigned Compute();
+
+	/**
+	 * Throw away the samples.
+	 */
+	void Clear();
+
+private:
+	static const unsigned BINS = 256;
+
+	struct Histogram
+	{
+		UINT32 counts[BINS];
+		UINT32 total;
+	};
+
+	static void CallSample(void* calibration);
+	void Sample();
+	static unsigned GetBin(double voltage);
+	static double GetVoltage(unsigned bin);
+	static double Percentile(const Histogram& histogram, double fraction);
+	static double BestThreshold(const Histogram& empty, const Histogram& ball, double& error);
+	bool Compute(IRSensor sensor);
+
+	std::string fileName;
+	AnalogChannel* channels[IR_SENSORS];
+	Histogram empty[IR_SENSORS];
+	Histogram ball[IR_SENSORS];
+	bool haveLimits[IR_SENSORS];
+	double low[IR_SENSORS];
+	double high[IR_SENSORS];
+	bool sampling;
+	IRSensor sampledSensor;
+	Notifier* sampler;
+	SEM_ID lock;
+};
+
+#endif // IRCALIBRATION_H
@@ -15,7 +15,7 @@ public:
 	JoystickCallback(JoystickWrapper* joystick, T *object) :
 		jwrapper(joystick),object(object)
 		{
-			this->buttonCount = 12;
+			this->buttonCount = 13; // buttons are numbered from 1
 			this->downCallback = new ObjectFuncPtr[buttonCount];
 			this->heldCallback = new ObjectFuncPtr[buttonCount];
 			this->upCallback = new ObjectFuncPtr[buttonCount];
@@ -1,5 +1,6 @@
 #include <cstdarg>
 #include <cstdio>
+#include <cstring>
 #include "Timer.h"
 #include "Logger.h"
 
@@ -7,14 +8,38 @@ using std::clock;
 using std::endl;
 using std::string;
 
-Logger::Logger(const string& fileName)
+// Below the default task priority, so writing never holds up the robot.
+static const INT32 WRITER_PRIORITY = 150;
+
+Logger* Logger::instance = NULL;
+
+Logger::Logger(const string& fileName) :
+		pendingFirst(0),
+		pendingCount(0),
+		dropped(0)
 {
 	timer.Start();
 	this->file.open(fileName.c_str(), std::ios::trunc);
+
+	// Only the latest logger is written for; the writer task finds it here.
+	instance = this;
+	lock = semMCreate(SEM_Q_PRIORITY | SEM_DELETE_SAFE | SEM_INVERSION_SAFE);
+	pendingLock = semMCreate(SEM_Q_PRIORITY | SEM_DELETE_SAFE | SEM_INVERSION_SAFE);
+	pendingSignal = semBCreate(SEM_Q_PRIORITY, SEM_EMPTY);
+	writerTask = new Task("2502Lg", (FUNCPTR)WriterLoop, WRITER_PRIORITY);
+	writerTask->Start();
 }
 
 Logger::~Logger()
 {
+	writerTask->Stop();
+	delete writerTask;
+	WritePending();
+	if (instance == this)
+		instance = NULL;
+	semDelete(pendingSignal);
+	semDelete(pendingLock);
+	semDelete(lock);
 	this->file.close();
 }
 
@@ -22,15 +47,78 @@ void Logger::Logf(const char* format, ...)
 {
 	va_list args;
 	va_start(args, format);
-	char buffer[256];
-	vsnprintf(buffer, 255, format, args);
+	char buffer[MESSAGE_SIZE];
+	vsnprintf(buffer, sizeof(buffer), format, args);
 	va_end(args);
 	
+	Write(timer.Get(), buffer);
+}
+
+void Logger::LogfLater(const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	char buffer[MESSAGE_SIZE];
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	double time = timer.Get();
+
+	{
+		Synchronized sync(pendingLock);
+		if (pendingCount == MAX_PENDING)
+		{
+			dropped++;
+			return;
+		}
+		Message& message = pending[(pendingFirst + pendingCount++) % MAX_PENDING];
+		message.time = time;
+		memcpy(message.text, buffer, sizeof(buffer));
+	}
+	semGive(pendingSignal);
+}
+
+void Logger::WriterLoop()
+{
+	while (true)
+	{
+		semTake(instance->pendingSignal, WAIT_FOREVER);
+		instance->WritePending();
+	}
+}
+
+void Logger::WritePending()
+{
+	while (true)
+	{
+		Message message;
+		unsigned lost;
+		{
+			Synchronized sync(pendingLock);
+			if (pendingCount == 0)
+				return;
+			message = pending[pendingFirst];
+			pendingFirst = (pendingFirst + 1) % MAX_PENDING;
+			pendingCount--;
+			lost = dropped;
+			dropped = 0;
+		}
+		if (lost > 0)
+		{
+			char text[64];
+			sprintf(text, "Logger: %u messages dropped", lost);
+			Write(message.time, text);
+		}
+		Write(message.time, message.text);
+	}
+}
+
+void Logger::Write(double time, const char* text)
+{
 	//Create a timestamp
 	char message[300];
-	double time = timer.Get();
-	sprintf(message, "[%f] %s", time, buffer);
+	snprintf(message, sizeof(message), "[%f] %s", time, text);
 	
+	Synchronized sync(lock);
 	this->file << message << endl;
 }
 
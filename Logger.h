@@ -30,11 +30,43 @@ public:
 	 * \param format the format string.
 	 */
 	void Logf(const char* format, ...);
+
+	/**
+	 * Log from a notifier, or with a lock held. The message is only
+	 * formatted here; a low-priority task writes it out. If that task falls
+	 * behind, messages are dropped and the count is logged with the next.
+	 * 
+	 * \param format the format string.
+	 */
+	void LogfLater(const char* format, ...);
 	void LogVar(const char* name, const char* format, ...);
 	
 private:
+	static const unsigned MESSAGE_SIZE = 256;
+	static const unsigned MAX_PENDING = 16;
+
+	struct Message
+	{
+		double time;
+		char text[MESSAGE_SIZE];
+	};
+
+	static void WriterLoop();
+	void WritePending();
+	void Write(double time, const char* text);
+
+	static Logger* instance;
+
 	Timer timer;
 	std::ofstream file;
+	SEM_ID lock;			// the file, which every task logs to
+	SEM_ID pendingLock;
+	SEM_ID pendingSignal;
+	Message pending[MAX_PENDING];
+	unsigned pendingFirst;
+	unsigned pendingCount;
+	unsigned dropped;
+	Task* writerTask;
 };
 
 #endif // LOGGER_H
@@ -0,0 +1,369 @@
+#include <WPILib.h>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <inetLib.h>
+#include <sockLib.h>
+#include <selectLib.h>
+#include "Constants.h"
+#include "Logger.h"
+#include "MjpegClient.h"
+#include "Singleton.h"
+
+// Username/password FRC:FRC, the default for the field cameras.
+static const char* AUTHORIZATION = "Authorization: Basic RlJDOkZSQw==\r\n";
+static const double RECONNECT_DELAY = 0.5;
+static const long SOCKET_TIMEOUT_US = 500000;
+static const long CONNECT_TIMEOUT_US = 1000000;
+
+MjpegClient* MjpegClient::instance = NULL;
+
+MjpegClient::MjpegClient(const char* address, unsigned port, unsigned fps) :
+		port(port),
+		fps(fps),
+		nextSequence(1),
+		lastAcquired(0),
+		pendingStart(0),
+		pendingEnd(0),
+		streamSocket(ERROR),
+		running(false),
+		framesReceived(0),
+		framesDropped(0),
+		reconnects(0)
+{
+	strncpy(this->address, address, sizeof(this->address) - 1);
+	this->address[sizeof(this->address) - 1] = '\0';
+
+	for (unsigned i = 0; i < kNumFrames; i++)
+	{
+		slots[i].buffer = new unsigned char[kMaxFrameSize];
+		slots[i].size = 0;
+		slots[i].sequence = 0;
+		slots[i].timestamp = 0.0;
+		slots[i].state = SLOT_FREE;
+	}
+
+	slotLock = semMCreate(SEM_Q_PRIORITY | SEM_INVERSION_SAFE | SEM_DELETE_SAFE);
+	frameReady = semBCreate(SEM_Q_PRIORITY, SEM_EMPTY);
+	// There is one camera; the reader task finds its client here.
+	instance = this;
+	readerTask = new Task("2502Cam", (FUNCPTR)ReaderTask);
+}
+
+MjpegClient::~MjpegClient()
+{
+	Stop();
+	delete readerTask;
+	if (instance == this)
+		instance = NULL;
+	semDelete(frameReady);
+	semDelete(slotLock);
+	for (unsigned i = 0; i < kNumFrames; i++)
+		delete [] slots[i].buffer;
+}
+
+void MjpegClient::Start()
+{
+	if (running)
+		return;
+	running = true;
+	readerTask->Start();
+}
+
+void MjpegClient::Stop()
+{
+	if (!running)
+		return;
+	running = false;
+	// The reader notices within one socket timeout; give it a chance to
+	// close the connection cleanly before the task is torn down.
+	Wait(2.0 * SOCKET_TIMEOUT_US / 1.0e6);
+	readerTask->Stop();
+	if (streamSocket != ERROR)
+	{
+		close(streamSocket);
+		streamSocket = ERROR;
+	}
+}
+
+bool MjpegClient::AcquireLatest(MjpegFrame& frame, double timeout)
+{
+	int ticks = (int)(timeout * sysClkRateGet());
+	while (true)
+	{
+		int newest = -1;
+		{
+			Synchronized sync(slotLock);
+			for (unsigned i = 0; i < kNumFrames; i++)
+			{
+				if (slots[i].state != SLOT_READY || slots[i].sequence <= lastAcquired)
+					continue;
+				if (newest < 0 || slots[i].sequence > slots[newest].sequence)
+					newest = i;
+			}
+			if (newest >= 0)
+			{
+				// Frames older than this one will never be asked for, so
+				// their slots can be filled again.
+				for (unsigned i = 0; i < kNumFrames; i++)
+				{
+					if (slots[i].state == SLOT_READY && slots[i].sequence < slots[newest].sequence)
+						slots[i].state = SLOT_FREE;
+				}
+				slots[newest].state = SLOT_HELD;
+				lastAcquired = slots[newest].sequence;
+				frame.data = slots[newest].buffer;
+				frame.size = slots[newest].size;
+				frame.sequence = slots[newest].sequence;
+				frame.timestamp = slots[newest].timestamp;
+				frame.slot = newest;
+				return true;
+			}
+		}
+		if (semTake(frameReady, ticks) != OK)
+			return false;
+	}
+}
+
+void MjpegClient::Release(const MjpegFrame& frame)
+{
+	Synchronized sync(slotLock);
+	if (frame.slot >= 0 && frame.slot < (int)kNumFrames && slots[frame.slot].state == SLOT_HELD)
+		slots[frame.slot].state = SLOT_FREE;
+}
+
+bool MjpegClient::WriteParameter(const char* name, const char* value)
+{
+	int sock = Connect();
+	if (sock == ERROR)
+		return false;
+
+	char path[256];
+	snprintf(path, sizeof(path), "/axis-cgi/admin/param.cgi?action=update&%s=%s", name, value);
+	bool ok = SendRequest(sock, path);
+
+	char reply[128];
+	if (ok)
+		ok = WaitReadable(sock);
+	if (ok)
+	{
+		int length = recv(sock, reply, sizeof(reply) - 1, 0);
+		ok = length > 0;
+		if (ok)
+		{
+			reply[length] = '\0';
+			ok = strstr(reply, " 200 ") != NULL;
+		}
+	}
+	close(sock);
+
+	if (!ok)
+		LOGGER.Logf("MjpegClient: failed to write %s=%s", name, value);
+	return ok;
+}
+
+int MjpegClient::ReaderTask()
+{
+	while (instance->running)
+	{
+		instance->ReadStream();
+		if (instance->running)
+		{
+			instance->reconnects++;
+			Wait(RECONNECT_DELAY);
+		}
+	}
+	return 0;
+}
+
+// One pass over a persistent connection. Returns when the stream breaks.
+void MjpegClient::ReadStream()
+{
+	streamSocket = Connect();
+	if (streamSocket == ERROR)
+		return;
+
+	char path[64];
+	snprintf(path, sizeof(path), "/mjpg/video.mjpg?resolution=320x240&fps=%u", fps);
+	pendingStart = pendingEnd = 0;
+
+	char line[128];
+	bool ok = SendRequest(streamSocket, path) && ReadLine(streamSocket, line, sizeof(line));
+	if (ok && strstr(line, " 200 ") == NULL)
+	{
+		LOGGER.Logf("MjpegClient: camera refused stream: %s", line);
+		ok = false;
+	}
+
+	while (ok && running)
+	{
+		// Each part is a boundary line and headers, then Content-Length bytes of JPEG.
+		unsigned length = 0;
+		while ((ok = ReadLine(streamSocket, line, sizeof(line))) && (line[0] != '\0' || length == 0))
+		{
+			if (strncmp(line, "Content-Length:", 15) == 0)
+				length = strtoul(line + 15, NULL, 10);
+		}
+		if (!ok)
+			break;
+
+		if (length > kMaxFrameSize)
+		{
+			LOGGER.Logf("MjpegClient: frame of %u bytes exceeds the ring slot", length);
+			break;
+		}
+
+		int slot = ClaimSlot();
+		if (!ReadBody(streamSocket, slots[slot].buffer, length))
+		{
+			AbandonSlot(slot);
+			break;
+		}
+		PublishSlot(slot, length);
+	}
+
+	close(streamSocket);
+	streamSocket = ERROR;
+}
+
+int MjpegClient::Connect()
+{
+	struct sockaddr_in server;
+	memset(&server, 0, sizeof(server));
+	server.sin_len = (u_char)sizeof(server);
+	server.sin_family = AF_INET;
+	server.sin_port = htons(port);
+	server.sin_addr.s_addr = inet_addr(address);
+
+	int sock = socket(AF_INET, SOCK_STREAM, 0);
+	if (sock == ERROR)
+		return ERROR;
+	// A plain connect waits as long as the stack likes for a camera that is
+	// not answering.
+	struct timeval timeout = { CONNECT_TIMEOUT_US / 1000000, CONNECT_TIMEOUT_US % 1000000 };
+	if (connectWithTimeout(sock, (struct sockaddr*)&server, sizeof(server), &timeout) == ERROR)
+	{
+		close(sock);
+		return ERROR;
+	}
+	return sock;
+}
+
+bool MjpegClient::SendRequest(int sock, const char* path)
+{
+	char request[512];
+	int length = snprintf(request, sizeof(request),
+			"GET %s HTTP/1.1\r\n"
+			"User-Agent: HTTPStreamClient\r\n"
+			"Connection: Keep-Alive\r\n"
+			"Cache-Control: no-cache\r\n"
+			"%s\r\n", path, AUTHORIZATION);
+	return send(sock, request, length, 0) == length;
+}
+
+// Wait up to the socket timeout for something to read.
+bool MjpegClient::WaitReadable(int sock)
+{
+	fd_set readable;
+	FD_ZERO(&readable);
+	FD_SET(sock, &readable);
+	struct timeval timeout = { 0, SOCKET_TIMEOUT_US };
+	return select(sock + 1, &readable, NULL, NULL, &timeout) > 0;
+}
+
+// Read one CRLF-terminated line, stripping the terminator.
+bool MjpegClient::ReadLine(int sock, char* line, unsigned maxLength)
+{
+	unsigned used = 0;
+	while (true)
+	{
+		while (pendingStart < pendingEnd)
+		{
+			char c = pending[pendingStart++];
+			if (c == '\n')
+			{
+				if (used > 0 && line[used - 1] == '\r')
+					used--;
+				line[used] = '\0';
+				return true;
+			}
+			if (used < maxLength - 1)
+				line[used++] = c;
+		}
+
+		if (!WaitReadable(sock))
+			return false;
+
+		int received = recv(sock, pending, sizeof(pending), 0);
+		if (received <= 0)
+			return false;
+		pendingStart = 0;
+		pendingEnd = received;
+	}
+}
+
+// Read the JPEG body straight into the ring. Only bytes that were already
+// staged while looking for the end of the headers are copied.
+bool MjpegClient::ReadBody(int sock, unsigned char* dest, unsigned length)
+{
+	unsigned got = pendingEnd - pendingStart;
+	if (got > length)
+		got = length;
+	memcpy(dest, pending + pendingStart, got);
+	pendingStart += got;
+
+	while (got < length && running)
+	{
+		if (!WaitReadable(sock))
+			return false;
+
+		int received = recv(sock, (char*)dest + got, length - got, 0);
+		if (received <= 0)
+			return false;
+		got += received;
+	}
+	return got == length;
+}
+
+// Pick a buffer to fill: a free one if possible, otherwise the oldest
+// frame nobody has picked up yet. Held frames are never touched.
+int MjpegClient::ClaimSlot()
+{
+	Synchronized sync(slotLock);
+	int oldest = -1;
+	for (unsigned i = 0; i < kNumFrames; i++)
+	{
+		if (slots[i].state == SLOT_FREE)
+		{
+			slots[i].state = SLOT_FILLING;
+			return i;
+		}
+		if (slots[i].state == SLOT_READY && (oldest < 0 || slots[i].sequence < slots[oldest].sequence))
+			oldest = i;
+	}
+	// With kNumFrames > 2 and a single consumer there is always a ready slot
+	// here. It only counts as dropped if the consumer never saw it.
+	if (slots[oldest].sequence > lastAcquired)
+		framesDropped++;
+	slots[oldest].state = SLOT_FILLING;
+	return oldest;
+}
+
+void MjpegClient::PublishSlot(int slot, unsigned size)
+{
+	{
+		Synchronized sync(slotLock);
+		slots[slot].size = size;
+		slots[slot].sequence = nextSequence++;
+		slots[slot].timestamp = Timer::GetFPGATimestamp();
+		slots[slot].state = SLOT_READY;
+	}
+	framesReceived++;
+	semGive(frameReady);
+}
+
+void MjpegClient::AbandonSlot(int slot)
+{
+	Synchronized sync(slotLock);
+	slots[slot].state = SLOT_FREE;
+}
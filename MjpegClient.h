@@ -0,0 +1,118 @@
+#ifndef MJPEGCLIENT_H
+#define MJPEGCLIENT_H
+
+#include <WPILib.h>
+
+/**
+ * A frame held by a consumer of the MjpegClient. The data pointer points
+ * straight into the client's frame ring and stays valid until Release().
+ */
+struct MjpegFrame
+{
+	const unsigned char* data;
+	unsigned size;
+	unsigned sequence;
+	double timestamp; // FPGA time (seconds) the last byte arrived
+	int slot;
+};
+
+/**
+ * Keeps one persistent MJPEG connection to the camera open and parses the
+ * multipart stream directly into a fixed ring of frame buffers.
+ *
+ * The reader task always fills a slot that nobody is holding, so the
+ * consumer can decode from the ring without copying the JPEG data.
+ */
+class MjpegClient
+{
+public:
+	static const unsigned kNumFrames = 4;
+	static const unsigned kMaxFrameSize = 64 * 1024;
+
+	/**
+	 * \param address dotted-quad address of the camera (or a stand-in server).
+	 * \param port the HTTP port.
+	 * \param fps the frame rate to request from the camera.
+	 */
+	MjpegClient(const char* address, unsigned port, unsigned fps);
+	~MjpegClient();
+
+	void Start();
+	void Stop();
+
+	/**
+	 * Hold the newest complete frame.
+	 *
+	 * \param frame filled in with a pointer into the ring.
+	 * \param timeout seconds to wait for a frame newer than the last one acquired.
+	 * \return true if a frame is held; it must be given back with Release().
+	 */
+	bool AcquireLatest(MjpegFrame& frame, double timeout);
+	void Release(const MjpegFrame& frame);
+
+	/**
+	 * Write a camera parameter through the Axis param.cgi interface on a
+	 * separate, short-lived connection. Blocks for up to a connect and a
+	 * socket timeout if the camera does not answer.
+	 */
+	bool WriteParameter(const char* name, const char* value);
+
+	unsigned GetFramesReceived() const { return framesReceived; }
+	unsigned GetFramesDropped() const { return framesDropped; }
+	unsigned GetReconnects() const { return reconnects; }
+
+private:
+	enum SlotState
+	{
+		SLOT_FREE,
+		SLOT_FILLING,
+		SLOT_READY,
+		SLOT_HELD
+	};
+
+	struct Slot
+	{
+		unsigned char* buffer;
+		unsigned size;
+		unsigned sequence;
+		double timestamp;
+		SlotState state;
+	};
+
+	static int ReaderTask();
+	void ReadStream();
+	int Connect();
+	bool SendRequest(int sock, const char* path);
+	bool WaitReadable(int sock);
+	bool ReadLine(int sock, char* line, unsigned maxLength);
+	bool ReadBody(int sock, unsigned char* dest, unsigned length);
+	int ClaimSlot();
+	void PublishSlot(int slot, unsigned size);
+	void AbandonSlot(int slot);
+
+	char address[32];
+	unsigned port;
+	unsigned fps;
+
+	Slot slots[kNumFrames];
+	SEM_ID slotLock;
+	SEM_ID frameReady;
+	unsigned nextSequence;
+	unsigned lastAcquired;
+
+	// Staging for header bytes read past the end of a line.
+	char pending[512];
+	unsigned pendingStart;
+	unsigned pendingEnd;
+
+	int streamSocket;
+	volatile bool running;
+	unsigned framesReceived;
+	unsigned framesDropped;
+	unsigned reconnects;
+	Task* readerTask;
+
+	static MjpegClient* instance;
+};
+
+#endif // MJPEGCLIENT_H
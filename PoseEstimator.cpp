@@ -0,0 +1,312 @@
+#include <cmath>
+#include <cstring>
+#include "Constants.h"
+#include "DriveTrain.h"
+#include "LSM303_I2C.h"
+#include "Logger.h"
+#include "Math.h"
+#include "PoseEstimator.h"
+#include "Singleton.h"
+
+static const double LOOP_PERIOD = 0.02;
+// Below the default task priority, so the I2C reads never hold up the robot.
+static const INT32 COMPASS_PRIORITY = 150;
+static const double GRAVITY = 32.17;	// feet per second squared
+// Smooths the two acceleration estimates before they are compared.
+static const double ACCELERATION_TIME_CONSTANT = 0.1;
+static const double TILT_TIME_CONSTANT = 0.3;
+// Harder than this, the two acceleration estimates are too far out of step
+// to tell tilt from speeding up (g).
+static const double MAX_TILT_ACCELERATION = 0.2;
+// How long the magnetometer takes to pull the heading round.
+static const double COMPASS_TIME_CONSTANT = 10.0;
+// The field strength must be this close to the one at rest to be trusted.
+static const double COMPASS_TOLERANCE = 0.15;
+static const double MAX_COMPASS_TILT = 0.15;	// radians
+// The wheels are slipping when they speed up or slow down this much faster
+// than the robot does (g).
+static const double SLIP_THRESHOLD = 0.5;
+// The accelerometer alone drifts quickly, so a slip is only followed for
+// so long.
+static const double MAX_SLIP_TIME = 0.5;
+// Readings this weak mean the LSM303 is not there.
+static const double MIN_READING = 100.0;
+
+// To (-pi, pi].
+static double Wrap(double angle)
+{
+	while (angle > PI)
+		angle -= 2 * PI;
+	while (angle <= -PI)
+		angle += 2 * PI;
+	return angle;
+}
+
+PoseEstimator* PoseEstimator::instance = NULL;
+
+static double Magnitude(const LSM303_I2C::AxesReport& axes)
+{
+	return sqrt((double)axes.XAxis * axes.XAxis + (double)axes.YAxis * axes.YAxis + (double)axes.ZAxis * axes.ZAxis);
+}
+
+PoseEstimator::PoseEstimator(DriveTrain& drive, Gyro* gyro, LSM303_I2C* compass) :
+		drive(drive),
+		gyro(gyro),
+		compass(compass),
+		compassTask(NULL),
+		gravity(0.0),
+		fieldStrength(0.0),
+		x(0.0), y(0.0), heading(0.0),
+		tilt(0.0),
+		velocity(0.0),
+		compassOffset(0.0),
+		fieldAngle(0.0),
+		lastTime(Timer::GetFPGATimestamp()),
+		lastLeft(drive.GetLeftDistance()),
+		lastRight(drive.GetRightDistance()),
+		lastSpeed(0.0),
+		lastGyroAngle(gyro != NULL ? gyro->GetAngle() : 0.0),
+		odometryAcceleration(0.0),
+		measuredAcceleration(0.0),
+		slipping(false),
+		slipExpired(false),
+		slipStart(0.0),
+		slipCount(0),
+		written(0)
+{
+	memset(&acceleration, 0, sizeof(acceleration));
+	memset(&magnetic, 0, sizeof(magnetic));
+	if (compass != NULL)
+	{
+		acceleration = compass->GetAccelerations();
+		magnetic = compass->GetMagnetic();
+		gravity = Magnitude(acceleration);
+		fieldStrength = sqrt((double)magnetic.XAxis * magnetic.XAxis + (double)magnetic.YAxis * magnetic.YAxis);
+		fieldAngle = atan2((double)magnetic.YAxis, (double)magnetic.XAxis);
+		compassOffset = fieldAngle;
+		if (gravity < MIN_READING)
+			gravity = 0.0;
+		if (fieldStrength < MIN_READING)
+			fieldStrength = 0.0;
+	}
+	LOGGER.Logf("PoseEstimator: %s for heading, %s accelerometer, %s magnetometer", gyro != NULL ? "gyro" : "wheels",
+			gravity > 0.0 ? "with" : "no", fieldStrength > 0.0 ? "with" : "no");
+
+	// There is only one estimator, so the compass task finds it here.
+	instance = this;
+	lock = semMCreate(SEM_Q_PRIORITY | SEM_DELETE_SAFE | SEM_INVERSION_SAFE);
+	Record(lastTime);
+	if (gravity > 0.0 || fieldStrength > 0.0)
+	{
+		compassTask = new Task("2502Ps", (FUNCPTR)CompassLoop, COMPASS_PRIORITY);
+		compassTask->Start();
+	}
+	loop = new Notifier(CallUpdate, this);
+	loop->StartPeriodic(LOOP_PERIOD);
+}
+
+PoseEstimator::~PoseEstimator()
+{
+	loop->Stop();
+	delete loop;
+	if (compassTask != NULL)
+	{
+		compassTask->Stop();
+		delete compassTask;
+	}
+	semDelete(lock);
+	instance = NULL;
+}
+
+PoseEstimator::Pose PoseEstimator::GetPose() const
+{
+	Synchronized sync(lock);
+	return history[(written - 1) % HISTORY_SIZE];
+}
+
+bool PoseEstimator::GetPose(double time, Pose& pose) const
+{
+	Synchronized sync(lock);
+	unsigned oldest = written > HISTORY_SIZE ? written - HISTORY_SIZE : 0;
+	const Pose* after = &history[(written - 1) % HISTORY_SIZE];
+	if (time >= after->time)
+	{
+		pose = *after;
+		return true;
+	}
+	for (unsigned index = written - 1; index-- > oldest;)
+	{
+		const Pose& before = history[index % HISTORY_SIZE];
+		if (before.time <= time)
+		{
+			double fraction = (time - before.time) / (after->time - before.time);
+			pose.time = time;
+			pose.x = before.x + fraction * (after->x - before.x);
+			pose.y = before.y + fraction * (after->y - before.y);
+			double turn = Wrap(degToRad(after->heading - before.heading));
+			pose.heading = radToDeg(Wrap(degToRad(before.heading) + fraction * turn));
+			return true;
+		}
+		after = &before;
+	}
+	return false;
+}
+
+unsigned PoseEstimator::GetHistory(double window, Pose* poses, unsigned size) const
+{
+	Synchronized sync(lock);
+	unsigned oldest = written > HISTORY_SIZE ? written - HISTORY_SIZE : 0;
+	double newest = history[(written - 1) % HISTORY_SIZE].time;
+	unsigned copied = 0;
+	for (unsigned index = written; index-- > oldest && copied < size;)
+	{
+		const Pose& pose = history[index % HISTORY_SIZE];
+		if (newest - pose.time > window)
+			break;
+		poses[copied++] = pose;
+	}
+	return copied;
+}
+
+void PoseEstimator::Reset(double x, double y, double heading)
+{
+	Synchronized sync(lock);
+	this->x = x;
+	this->y = y;
+	this->heading = Wrap(degToRad(heading));
+	compassOffset = this->heading + fieldAngle;
+	written = 0;
+	Record(lastTime);
+	LOGGER.Logf("PoseEstimator: reset to (%.1f, %.1f) ft facing %.0f degrees", x, y, heading);
+}
+
+double PoseEstimator::GetTilt() const
+{
+	return radToDeg(tilt);
+}
+
+void PoseEstimator::CallUpdate(void* estimator)
+{
+	((PoseEstimator*)estimator)->Update();
+}
+
+// Reads the LSM303 at the loop's rate and leaves the readings for Update().
+void PoseEstimator::CompassLoop()
+{
+	while (true)
+	{
+		LSM303_I2C::AxesReport acceleration = { 0, 0, 0 };
+		LSM303_I2C::AxesReport magnetic = { 0, 0, 0 };
+		if (instance->gravity > 0.0)
+			acceleration = instance->compass->GetAccelerations();
+		if (instance->fieldStrength > 0.0)
+			magnetic = instance->compass->GetMagnetic();
+		{
+			Synchronized sync(instance->lock);
+			instance->acceleration = acceleration;
+			instance->magnetic = magnetic;
+		}
+		Wait(LOOP_PERIOD);
+	}
+}
+
+void PoseEstimator::Update()
+{
+	// Read the sensors before taking the lock.
+	double now = Timer::GetFPGATimestamp();
+	double left = drive.GetLeftDistance();
+	double right = drive.GetRightDistance();
+	double speed = (drive.GetLeftSpeed() + drive.GetRightSpeed()) / 2;
+	double gyroAngle = gyro != NULL ? gyro->GetAngle() : 0.0;
+
+	Synchronized sync(lock);
+	double dt = now - lastTime;
+	if (dt <= 0.0)
+		return;
+	double distance = (left - lastLeft + right - lastRight) / 2;
+	double turn;
+	if (gyro != NULL)
+		turn = -degToRad(gyroAngle - lastGyroAngle);	// the gyro turns clockwise
+	else
+		turn = (right - lastRight - (left - lastLeft)) / DRIVE_TRACK_WIDTH;
+
+	if (gravity > 0.0)
+	{
+		double filter = dt / ACCELERATION_TIME_CONSTANT;
+		odometryAcceleration += ((speed - lastSpeed) / dt / GRAVITY - odometryAcceleration) * filter;
+		double forward = acceleration.XAxis / gravity;
+		double up = acceleration.ZAxis / gravity;
+		measuredAcceleration += (forward - sin(tilt) - measuredAcceleration) * filter;
+
+		// Only the wheels getting ahead of the robot is a slip; the other way
+		// round is the robot tipping or being pushed.
+		bool spinning = fabs(odometryAcceleration) - fabs(measuredAcceleration) > SLIP_THRESHOLD;
+		if (spinning && !slipping && !slipExpired)
+		{
+			slipping = true;
+			slipStart = now;
+			slipCount++;
+			LOGGER.LogfLater("PoseEstimator: wheels slipping, %.2f g on the wheels, %.2f g measured", odometryAcceleration,
+					measuredAcceleration);
+		}
+		else if (!spinning)
+		{
+			slipping = false;
+			slipExpired = false;
+		}
+		else if (slipping && now - slipStart > MAX_SLIP_TIME)
+		{
+			slipping = false;
+			slipExpired = true;
+		}
+
+		if (slipping)
+		{
+			velocity += measuredAcceleration * GRAVITY * dt;
+			distance = velocity * dt;
+		}
+		else
+		{
+			velocity = speed;
+			// Speeding up looks like tilting back; take out what the wheels
+			// say the robot is doing.
+			if (fabs(odometryAcceleration) < MAX_TILT_ACCELERATION)
+				tilt += (atan2(forward - odometryAcceleration, up) - tilt) * dt / TILT_TIME_CONSTANT;
+		}
+		distance *= cos(tilt);
+	}
+
+	double middle = heading + turn / 2;
+	x += distance * cos(middle);
+	y += distance * sin(middle);
+	heading = Wrap(heading + turn);
+
+	if (fieldStrength > 0.0)
+	{
+		double strength = sqrt((double)magnetic.XAxis * magnetic.XAxis + (double)magnetic.YAxis * magnetic.YAxis);
+		if (fabs(strength / fieldStrength - 1.0) < COMPASS_TOLERANCE && fabs(tilt) < MAX_COMPASS_TILT)
+		{
+			// The field turns the opposite way to the robot.
+			fieldAngle = atan2((double)magnetic.YAxis, (double)magnetic.XAxis);
+			double error = Wrap(compassOffset - fieldAngle - heading);
+			heading = Wrap(heading + error * dt / COMPASS_TIME_CONSTANT);
+		}
+	}
+
+	lastTime = now;
+	lastLeft = left;
+	lastRight = right;
+	lastSpeed = speed;
+	lastGyroAngle = gyroAngle;
+	Record(now);
+}
+
+void PoseEstimator::Record(double time)
+{
+	Pose& pose = history[written % HISTORY_SIZE];
+	pose.time = time;
+	pose.x = x;
+	pose.y = y;
+	pose.heading = radToDeg(heading);
+	written++;
+}
@@ -0,0 +1,139 @@
+#ifndef POSEESTIMATOR_H
+#define POSEESTIMATOR_H
+
+#include <WPILib.h>
+#include "LSM303_I2C.h"
+
+class DriveTrain;
+class Gyro;
+
+/**
+ * Keeps track of where the robot is on the field.
+ *
+ * A notifier dead-reckons from the drive encoders, turning by the gyro when
+ * there is one and by the difference between the sides when there is not.
+ * The LSM303 helps three ways. Its accelerometer gives the tilt, so driving
+ * over the bridge only counts the distance covered along the floor. It also
+ * catches the wheels spinning faster than the robot is accelerating, and
+ * for a moment the distance is taken from the accelerometer instead. The
+ * magnetometer slowly pulls the heading back towards the direction it gave
+ * at the last reset, taking out gyro drift, but only while the field
+ * strength looks undisturbed by the motors. The LSM303 is read over I2C,
+ * which is slow, so a low-priority task of its own reads it and the
+ * notifier takes the latest sample.
+ *
+ * Every pose is kept with its FPGA time, so vision can ask where the robot
+ * was when a frame was taken.
+ */
+class PoseEstimator
+{
+public:
+	/**
+	 * Where the robot was at a time: x forward and y to the left of where
+	 * it was last reset, facing heading degrees counterclockwise from the
+	 * direction it faced then.
+	 */
+	struct Pose
+	{
+		double time;		// FPGA time (seconds)
+		double x;			// feet
+		double y;			// feet
+		double heading;		// degrees, -180 to 180
+	};
+
+	/**
+	 * \param drive supplies the side distances and speeds.
+	 * \param gyro NULL if there is none.
+	 * \param compass NULL if there is none.
+	 * The caller keeps all three, and the sensors should be still when this
+	 * is created so the LSM303 readings can be taken as level and at rest.
+	 */
+	PoseEstimator(DriveTrain& drive, Gyro* gyro, LSM303_I2C* compass);
+	~PoseEstimator();
+
+	/**
+	 * \return the latest pose.
+	 */
+	Pose GetPose() const;
+
+	/**
+	 * \param time an FPGA time within the history.
+	 * \param pose set to where the robot was then, between samples if need
+	 * be, or the latest pose for times after it.
+	 * \return false if the time is older than the history.
+	 */
+	bool GetPose(double time, Pose& pose) const;
+
+	/**
+	 * Copy out the recent poses, newest first.
+	 *
+	 * \param window how far back to look (in seconds).
+	 * \param poses the room for them.
+	 * \param size the number of poses that fit.
+	 * \return the number of poses copied.
+	 */
+	unsigned GetHistory(double window, Pose* poses, unsigned size) const;
+
+	/**
+	 * Tell the estimator where the robot is, such as at the start of
+	 * autonomous. The history is cleared.
+	 *
+	 * \param heading degrees counterclockwise from the field's x axis.
+	 */
+	void Reset(double x, double y, double heading);
+
+	/**
+	 * \return the nose-up tilt (in degrees), 0 without an accelerometer.
+	 */
+	double GetTilt() const;
+
+	bool IsSlipping() const { return slipping; }
+	unsigned GetSlipCount() const { return slipCount; }
+
+private:
+	static const unsigned HISTORY_SIZE = 128;
+
+	static void CallUpdate(void* estimator);
+	static void CompassLoop();
+	void Update();
+	void Record(double time);
+
+	static PoseEstimator* instance;
+
+	DriveTrain& drive;
+	Gyro* gyro;
+	LSM303_I2C* compass;
+	Notifier* loop;
+	Task* compassTask;
+	SEM_ID lock;
+
+	// LSM303 readings at rest, to scale and check the others by.
+	double gravity;
+	double fieldStrength;
+	// The latest readings from the compass task.
+	LSM303_I2C::AxesReport acceleration;
+	LSM303_I2C::AxesReport magnetic;
+
+	double x, y, heading;	// feet and radians
+	double tilt;			// radians
+	double velocity;		// feet per second along the floor
+	double compassOffset;	// heading plus the field's angle to the robot
+	double fieldAngle;
+
+	double lastTime;
+	double lastLeft, lastRight;
+	double lastSpeed;
+	double lastGyroAngle;
+	double odometryAcceleration;	// both in g, filtered
+	double measuredAcceleration;
+
+	bool slipping;
+	bool slipExpired;
+	double slipStart;
+	unsigned slipCount;
+
+	Pose history[HISTORY_SIZE];
+	unsigned written;
+};
+
+#endif // POSEESTIMATOR_H
@@ -0,0 +1,100 @@
+#include <cmath>
+#include "ReadinessEstimator.h"
+#include "SingleChannelEncoder.h"
+
+const double ReadinessEstimator::FIT_WINDOW = 0.1;
+
+static const unsigned MIN_SAMPLES = 10;
+// How many standard errors of the speed must fit inside the tolerance.
+static const double CONFIDENCE = 2.0;
+// The speed must stay in tolerance for this long on its current trend.
+static const double HOLD_TIME = 0.05;
+
+ReadinessEstimator::ReadinessEstimator(SingleChannelEncoder& encoder, double tolerance) :
+		encoder(encoder),
+		tolerance(tolerance),
+		speed(0.0),
+		acceleration(0.0),
+		speedError(0.0),
+		ready(false),
+		inTolerance(false),
+		settleTime(-1.0)
+{
+}
+
+void ReadinessEstimator::Update(double setpoint)
+{
+	ready = false;
+	inTolerance = false;
+	settleTime = -1.0;
+	if (!Fit() || setpoint <= 0.0)
+		return;
+
+	double error = speed - setpoint;
+	double margin = tolerance - CONFIDENCE * speedError;
+	inTolerance = fabs(error) <= tolerance;
+	ready = fabs(error) <= margin && fabs(error + acceleration * HOLD_TIME) <= tolerance;
+	if (ready)
+	{
+		settleTime = 0.0;
+		return;
+	}
+
+	// Treat the approach as exponential: the acceleration shrinks with the
+	// error, at a time constant of error over acceleration. A wheel running
+	// flat out gets there sooner than this, which only makes the prediction
+	// late, never early.
+	if (margin > 0.0 && fabs(error) > margin && error * acceleration < 0.0)
+	{
+		double timeConstant = -error / acceleration;
+		settleTime = timeConstant * log(fabs(error) / margin);
+	}
+}
+
+// Least squares fit of revolutions = c0 + c1 t + c2 t^2, with t measured
+// back from the newest sample, so c1 is the speed now.
+bool ReadinessEstimator::Fit()
+{
+	unsigned n = encoder.GetHistory(FIT_WINDOW, times, revolutions, MAX_SAMPLES);
+	if (n < MIN_SAMPLES)
+		return false;
+
+	double s1 = 0.0, s2 = 0.0, s3 = 0.0, s4 = 0.0;
+	double y0 = 0.0, y1 = 0.0, y2 = 0.0;
+	for (unsigned k = 0; k < n; k++)
+	{
+		double t = times[k] - times[0];
+		double y = revolutions[k] - revolutions[0];
+		double t2 = t * t;
+		s1 += t;
+		s2 += t2;
+		s3 += t2 * t;
+		s4 += t2 * t2;
+		y0 += y;
+		y1 += y * t;
+		y2 += y * t2;
+	}
+	double s0 = n;
+
+	// Solve the normal equations by Cramer's rule.
+	double det = s0 * (s2 * s4 - s3 * s3) - s1 * (s1 * s4 - s2 * s3) + s2 * (s1 * s3 - s2 * s2);
+	if (fabs(det) < 1e-30)
+		return false;
+	double c0 = (y0 * (s2 * s4 - s3 * s3) - s1 * (y1 * s4 - y2 * s3) + s2 * (y1 * s3 - y2 * s2)) / det;
+	double c1 = (s0 * (y1 * s4 - y2 * s3) - y0 * (s1 * s4 - s2 * s3) + s2 * (s1 * y2 - s2 * y1)) / det;
+	double c2 = (s0 * (s2 * y2 - s3 * y1) - s1 * (s1 * y2 - s2 * y1) + y0 * (s1 * s3 - s2 * s2)) / det;
+
+	double residuals = 0.0;
+	for (unsigned k = 0; k < n; k++)
+	{
+		double t = times[k] - times[0];
+		double r = revolutions[k] - revolutions[0] - (c0 + c1 * t + c2 * t * t);
+		residuals += r * r;
+	}
+	double variance = residuals / (n - 3);
+
+	speed = c1;
+	acceleration = 2.0 * c2;
+	speedError = sqrt(variance * (s0 * s4 - s2 * s2) / det);
+	return true;
+}
@@ -0,0 +1,76 @@
+#ifndef READINESSESTIMATOR_H
+#define READINESSESTIMATOR_H
+
+#include <WPILib.h>
+
+class SingleChannelEncoder;
+
+/**
+ * Decides when a wheel is at speed from the trend of its recent speed
+ * rather than a run of good samples.
+ *
+ * Each update fits a quadratic to the encoder's count over the last 0.1 s,
+ * which gives the speed now, the acceleration and how uncertain the speed
+ * is. The wheel is ready when the speed, allowing for that uncertainty,
+ * is inside the tolerance and will still be a little while from now. When
+ * it is not, the approach to the setpoint is extrapolated to predict when
+ * it will be.
+ */
+class ReadinessEstimator
+{
+public:
+	static const double FIT_WINDOW;
+
+	/**
+	 * \param encoder the wheel's speed sensor.
+	 * \param tolerance how far from the setpoint is close enough (in rps).
+	 */
+	ReadinessEstimator(SingleChannelEncoder& encoder, double tolerance);
+
+	/**
+	 * Refit the recent speed. Call this regularly.
+	 *
+	 * \param setpoint the wheel speed wanted (in rps), 0 if stopped.
+	 */
+	void Update(double setpoint);
+
+	bool IsReady() const { return ready; }
+
+	/**
+	 * \return true if the estimated speed is inside the tolerance, however
+	 * uncertain or unsettled it is.
+	 */
+	bool IsInTolerance() const { return inTolerance; }
+
+	/**
+	 * \return the predicted time until the wheel is ready (in seconds), 0 if
+	 * it is ready, or a negative number if it is not heading there.
+	 */
+	double GetSettleTime() const { return settleTime; }
+
+	double GetSpeed() const { return speed; }
+	double GetAcceleration() const { return acceleration; }
+
+	/**
+	 * \return the standard error of the speed estimate (in rps).
+	 */
+	double GetSpeedError() const { return speedError; }
+
+private:
+	static const unsigned MAX_SAMPLES = 128;
+
+	bool Fit();
+
+	SingleChannelEncoder& encoder;
+	double tolerance;
+	double speed;
+	double acceleration;
+	double speedError;
+	bool ready;
+	bool inTolerance;
+	double settleTime;
+	double times[MAX_SAMPLES];
+	double revolutions[MAX_SAMPLES];
+};
+
+#endif // READINESSESTIMATOR_H
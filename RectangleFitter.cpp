@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <cmath>
+#include "RectangleFitter.h"
+
+static const int MIN_EDGE_SAMPLES = 5;
+static const double MIN_INLIER_FRACTION = 0.3;	// of the samples along one edge
+static const double MAX_EDGE_SLOPE = 0.3;		// the camera is never rolled this far
+static const double FIT_TOLERANCE = 1.5;		// pixels from the line on the refit pass
+static const double MAX_EDGE_INSET = 0.15;		// of the box size, between a fitted edge and the box side
+
+RectangleFitter::RectangleFitter(double aspect) :
+		aspect(aspect)
+{
+	across.reserve(512);
+	along.reserve(512);
+	sorted.reserve(512);
+}
+
+void RectangleFitter::SampleEdge(const unsigned char* pixels, int stride, int left, int top, int width, int height, Edge edge)
+{
+	across.clear();
+	along.clear();
+
+	switch (edge)
+	{
+	case TOP_EDGE:
+		for (int x = left; x < left + width; x++)
+			for (int y = top; y < top + height; y++)
+				if (pixels[y * stride + x])
+				{
+					across.push_back(x);
+					along.push_back(y);
+					break;
+				}
+		break;
+	case BOTTOM_EDGE:
+		for (int x = left; x < left + width; x++)
+			for (int y = top + height - 1; y >= top; y--)
+				if (pixels[y * stride + x])
+				{
+					across.push_back(x);
+					along.push_back(y);
+					break;
+				}
+		break;
+	case LEFT_EDGE:
+		for (int y = top; y < top + height; y++)
+			for (int x = left; x < left + width; x++)
+				if (pixels[y * stride + x])
+				{
+					across.push_back(y);
+					along.push_back(x);
+					break;
+				}
+		break;
+	case RIGHT_EDGE:
+		for (int y = top; y < top + height; y++)
+			for (int x = left + width - 1; x >= left; x--)
+				if (pixels[y * stride + x])
+				{
+					across.push_back(y);
+					along.push_back(x);
+					break;
+				}
+		break;
+	}
+}
+
+RectangleFitter::EdgeLine RectangleFitter::FitEdge(int extent)
+{
+	EdgeLine line = { 0.0, 0.0, 0, (int)along.size(), false };
+	if (line.samples < MIN_EDGE_SAMPLES)
+		return line;
+
+	// Samples where the edge is covered jump inward; the median sits on the
+	// visible part of the edge as long as most of it can be seen.
+	sorted = along;
+	std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+	double median = sorted[sorted.size() / 2];
+	double tolerance = std::max(2.0, 0.05 * extent);
+
+	// Two passes: around the median, then around the first fit.
+	for (int pass = 0; pass < 2; pass++)
+	{
+		double sumA = 0.0, sumB = 0.0, sumAA = 0.0, sumAB = 0.0;
+		int n = 0;
+		for (unsigned i = 0; i < along.size(); i++)
+		{
+			double expected = (pass == 0) ? median : line.slope * across[i] + line.intercept;
+			if (std::fabs(along[i] - expected) > ((pass == 0) ? tolerance : FIT_TOLERANCE))
+				continue;
+			sumA += across[i];
+			sumB += along[i];
+			sumAA += across[i] * across[i];
+			sumAB += across[i] * along[i];
+			n++;
+		}
+		if (n < MIN_EDGE_SAMPLES)
+			return line;
+
+		double denominator = n * sumAA - sumA * sumA;
+		line.slope = (denominator != 0.0) ? (n * sumAB - sumA * sumB) / denominator : 0.0;
+		line.intercept = (sumB - line.slope * sumA) / n;
+		line.inliers = n;
+	}
+
+	line.valid = line.inliers >= MIN_INLIER_FRACTION * line.samples && std::fabs(line.slope) <= MAX_EDGE_SLOPE;
+	return line;
+}
+
+void RectangleFitter::Intersect(const EdgeLine& horizontal, const EdgeLine& vertical, double& x, double& y)
+{
+	// y = h.slope * x + h.intercept and x = v.slope * y + v.intercept
+	x = (vertical.slope * horizontal.intercept + vertical.intercept) / (1.0 - vertical.slope * horizontal.slope);
+	y = horizontal.slope * x + horizontal.intercept;
+}
+
+bool RectangleFitter::Fit(const unsigned char* pixels, int stride, int imageWidth, int imageHeight,
+		int left, int top, int width, int height, FittedRectangle& result)
+{
+	if (left < 0 || top < 0 || left + width > imageWidth || top + height > imageHeight || width <= 0 || height <= 0)
+		return false;
+
+	EdgeLine edges[4];
+	int missing = 0;
+	int missingEdge = -1;
+	for (int e = TOP_EDGE; e <= LEFT_EDGE; e++)
+	{
+		SampleEdge(pixels, stride, left, top, width, height, (Edge)e);
+		bool horizontal = (e == TOP_EDGE || e == BOTTOM_EDGE);
+		edges[e] = FitEdge(horizontal ? height : width);
+
+		// An outer edge runs along the side of the bounding box. A line well
+		// inside it is the inner edge of the tape showing through where the
+		// outer edge is hidden, so treat that edge as missing.
+		double middle = horizontal ? left + width / 2.0 : top + height / 2.0;
+		double side;
+		switch (e)
+		{
+		case TOP_EDGE:		side = top; break;
+		case BOTTOM_EDGE:	side = top + height - 1; break;
+		case LEFT_EDGE:		side = left; break;
+		default:			side = left + width - 1; break;
+		}
+		double inset = std::fabs(edges[e].slope * middle + edges[e].intercept - side);
+		if (inset > std::max(3.0, MAX_EDGE_INSET * (horizontal ? height : width)))
+			edges[e].valid = false;
+
+		if (!edges[e].valid)
+		{
+			missing++;
+			missingEdge = e;
+		}
+	}
+	if (missing > 1)
+		return false;
+
+	// Rebuild a hidden edge parallel to its opposite, using the size the
+	// two perpendicular edges give and the known aspect ratio.
+	if (missing == 1)
+	{
+		double x0, y0, x1, y1;
+		EdgeLine& hidden = edges[missingEdge];
+		switch (missingEdge)
+		{
+		case TOP_EDGE:
+		case BOTTOM_EDGE:
+		{
+			const EdgeLine& opposite = edges[missingEdge == TOP_EDGE ? BOTTOM_EDGE : TOP_EDGE];
+			Intersect(opposite, edges[LEFT_EDGE], x0, y0);
+			Intersect(opposite, edges[RIGHT_EDGE], x1, y1);
+			double h = (x1 - x0) / aspect;
+			hidden.slope = opposite.slope;
+			hidden.intercept = opposite.intercept + (missingEdge == TOP_EDGE ? -h : h);
+			break;
+		}
+		case LEFT_EDGE:
+		case RIGHT_EDGE:
+		{
+			const EdgeLine& opposite = edges[missingEdge == LEFT_EDGE ? RIGHT_EDGE : LEFT_EDGE];
+			Intersect(edges[TOP_EDGE], opposite, x0, y0);
+			Intersect(edges[BOTTOM_EDGE], opposite, x1, y1);
+			double w = (y1 - y0) * aspect;
+			hidden.slope = opposite.slope;
+			hidden.intercept = opposite.intercept + (missingEdge == LEFT_EDGE ? -w : w);
+			break;
+		}
+		}
+		hidden.inliers = 0;
+	}
+
+	Intersect(edges[TOP_EDGE], edges[LEFT_EDGE], result.cornerX[0], result.cornerY[0]);
+	Intersect(edges[TOP_EDGE], edges[RIGHT_EDGE], result.cornerX[1], result.cornerY[1]);
+	Intersect(edges[BOTTOM_EDGE], edges[RIGHT_EDGE], result.cornerX[2], result.cornerY[2]);
+	Intersect(edges[BOTTOM_EDGE], edges[LEFT_EDGE], result.cornerX[3], result.cornerY[3]);
+
+	double minX = result.cornerX[0], maxX = result.cornerX[0];
+	double minY = result.cornerY[0], maxY = result.cornerY[0];
+	result.centerX = result.centerY = 0.0;
+	for (int i = 0; i < 4; i++)
+	{
+		minX = std::min(minX, result.cornerX[i]);
+		maxX = std::max(maxX, result.cornerX[i]);
+		minY = std::min(minY, result.cornerY[i]);
+		maxY = std::max(maxY, result.cornerY[i]);
+		result.centerX += result.cornerX[i] / 4.0;
+		result.centerY += result.cornerY[i] / 4.0;
+	}
+	result.left = minX;
+	result.top = minY;
+	result.width = maxX - minX + 1.0;
+	result.height = maxY - minY + 1.0;
+	if (result.width <= 2.0 || result.height <= 2.0)
+		return false;
+
+	int support = 0;
+	for (int e = TOP_EDGE; e <= LEFT_EDGE; e++)
+		support += edges[e].inliers;
+	result.edgeSupport = std::min(1.0, support / (2.0 * (result.width + result.height)));
+	result.missingEdges = missing;
+	return true;
+}
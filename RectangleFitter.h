@@ -0,0 +1,85 @@
+#ifndef RECTANGLEFITTER_H
+#define RECTANGLEFITTER_H
+
+#include <vector>
+
+/**
+ * A rectangle recovered from its edges. Corners run top-left, top-right,
+ * bottom-right, bottom-left, in pixels.
+ */
+struct FittedRectangle
+{
+	double cornerX[4];
+	double cornerY[4];
+	double left;
+	double top;
+	double width;
+	double height;
+	double centerX;
+	double centerY;
+	double edgeSupport; // fraction of the perimeter backed by edge pixels, [0,1]
+	int missingEdges;
+};
+
+/**
+ * Recovers a partly hidden rectangle from a binary image by fitting a line
+ * to each of its four outer edges.
+ *
+ * Each edge is sampled by scanning inward from the candidate's bounding box;
+ * samples that jump away from the edge (where something covers it) are
+ * rejected before the least-squares fit. Corners are the intersections of
+ * adjacent edges, so a missing corner is recovered from the edges around
+ * it. A single edge that is hidden entirely is rebuilt from the opposite
+ * edge and the known aspect ratio.
+ */
+class RectangleFitter
+{
+public:
+	/**
+	 * \param aspect the width / height of the real rectangle.
+	 */
+	RectangleFitter(double aspect);
+
+	/**
+	 * \param pixels the binary image, nonzero where the particle is.
+	 * \param stride pixels per image row.
+	 * \param left,top,width,height the bounding box of the candidate particle.
+	 * \param result the recovered rectangle.
+	 * \return true if at least three edges were found.
+	 */
+	bool Fit(const unsigned char* pixels, int stride, int imageWidth, int imageHeight,
+			int left, int top, int width, int height, FittedRectangle& result);
+
+private:
+	enum Edge
+	{
+		TOP_EDGE,
+		RIGHT_EDGE,
+		BOTTOM_EDGE,
+		LEFT_EDGE
+	};
+
+	/**
+	 * The line along = slope * across + intercept, where "across" runs along
+	 * the edge (x for top/bottom, y for left/right).
+	 */
+	struct EdgeLine
+	{
+		double slope;
+		double intercept;
+		int inliers;
+		int samples;
+		bool valid;
+	};
+
+	void SampleEdge(const unsigned char* pixels, int stride, int left, int top, int width, int height, Edge edge);
+	EdgeLine FitEdge(int extent);
+	static void Intersect(const EdgeLine& horizontal, const EdgeLine& vertical, double& x, double& y);
+
+	double aspect;
+	std::vector<double> across;
+	std::vector<double> along;
+	std::vector<double> sorted;
+};
+
+#endif // RECTANGLEFITTER_H
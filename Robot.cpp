@@ -1,15 +1,18 @@
 #include "Collector.h"
+#include "IRCalibration.h"
 #include "DisplayWriter.h"
 #include "DisplayWrapper.h"
 #include "DriveTrain.h"
 #include "JoystickWrapper.h"
 #include "Logger.h"
+#include "PoseEstimator.h"
 #include "Robot.h"
 #include "Singleton.h"
 #include "squarefinder.h"
 #include <time.h>
 #include "SharpIR.h"
 #include "Shooter.h"
+#include "ShotSequencer.h"
 
 bool Robot::operatorControlEnabled = false;
 Robot* Robot::me = NULL;
@@ -27,19 +30,24 @@ Robot::Robot()
 	Logger* logger = new Logger("/ni-rt/system/logs/robot.txt");
 	Singleton<Logger>::SetInstance(logger);
 
-	vision = new Vision(new SquareFinder);
+	SquareFinder* squareFinder = new SquareFinder;
+	Singleton<SquareFinder>::SetInstance(squareFinder);
+	vision = new Vision(squareFinder);
+	Singleton<Vision>::SetInstance(vision);
 	vision->setEnabled(true); //Don't process without button.
 	vision->start();
 	Singleton<DriveTrain>::SetInstance(new DriveTrain);
 	Singleton<Collector>::SetInstance(new Collector);
 	Singleton<Collector>::GetInstance().Start();
 	Singleton<Shooter>::SetInstance(new Shooter);
+	Singleton<ShotSequencer>::SetInstance(new ShotSequencer);
 
 	// The order in which lines are reserved dictates the order
 	// in which lines are displayed on the LCD.
 	this->primaryDisplay.Reserve(1);
 	COLLECTOR.reservePrimaryLines();
 	SHOOTER.reservePrimaryLines();
+	SEQUENCER.reservePrimaryLines();
 	DRIVETRAIN.ReservePrimaryLines();
 	VISION.reservePrimaryLines();
 	SQUAREFINDER.reservePrimaryLines();
@@ -49,6 +57,7 @@ Robot::Robot()
 	this->secondaryDisplay.Reserve(7);
 	COLLECTOR.reserveSecondaryLines();
 	SHOOTER.reserveSecondaryLines();
+	SEQUENCER.reserveSecondaryLines();
 	DRIVETRAIN.ReserveSecondaryLines();
 	VISION.reserveSecondaryLines();
 	SQUAREFINDER.reserveSecondaryLines();
@@ -62,8 +71,14 @@ Robot::Robot()
 	//balancePID = new PIDController(0.1,.01,0.0,balanceAccelerometer,&Singleton<DriveTrain>::GetInstance()); //\todo Tune these! No D.
 	//balancePID->Disable();
 
-	//gyro = new Gyro(1);
-	//gyro->Reset();
+	gyro = NULL;
+	if (GYRO_CHANNEL != 0)
+	{
+		gyro = new Gyro(GYRO_CHANNEL);
+		gyro->Reset();
+	}
+	compass = new LSM303_I2C(DIGITAL_SIDECAR_SLOT);
+	Singleton<PoseEstimator>::SetInstance(new PoseEstimator(DRIVETRAIN, gyro, compass));
 
 	joystick1 = new JoystickWrapper(1, Extreme3DPro);
 	//joystick2 = new JoystickWrapper(2, Attack3);
@@ -84,6 +99,10 @@ Robot::Robot()
 	joystickCallbackHandler->SetDownCallback(COLLECTOR_ADD_BALL_BUTTON, GET_FUNC(CollectorIncBall));
 	joystickCallbackHandler->SetDownCallback(COLLECTOR_SUB_BALL_BUTTON, GET_FUNC(CollectorDecBall));
 
+	// Shot table feedback during practice
+	joystickCallbackHandler->SetDownCallback(SHOT_SHORT_BUTTON, GET_FUNC(ShotWasShort));
+	joystickCallbackHandler->SetDownCallback(SHOT_LONG_BUTTON, GET_FUNC(ShotWasLong));
+
 	joystickCallbackHandler->SetHeldCallback(9, GET_FUNC(MediumSpeedOn));
 	joystickCallbackHandler->SetHeldCallback(11, GET_FUNC(SlowSpeedOn));
 	joystickCallbackHandler->SetUpCallback(9, GET_FUNC(NormalSpeed));
@@ -99,8 +118,10 @@ Robot::~Robot()
 	Singleton<Logger>::GetInstance().Logf("Shutting down the Robot class.");
 
 	//Destroy instances of singletons that we have used
+	Singleton<ShotSequencer>::DestroyInstance();
 	Singleton<Collector>::DestroyInstance();
 	Singleton<DisplayWrapper>::DestroyInstance();
+	Singleton<PoseEstimator>::DestroyInstance();
 	Singleton<DriveTrain>::DestroyInstance();
 	Singleton<Logger>::DestroyInstance();
 	Singleton<Shooter>::DestroyInstance();
@@ -110,6 +131,8 @@ Robot::~Robot()
 
 	//delete balancePID;
 	//delete balanceAccelerometer;
+	delete gyro;
+	delete compass;
 
 	me = NULL;
 }
@@ -173,6 +196,16 @@ void Robot::ShotZDec()
 	shotModifierZ -= 1;
 }
 
+void Robot::ShotWasShort()
+{
+	SHOOTER.ReportShot(SHOT_SHORT);
+}
+
+void Robot::ShotWasLong()
+{
+	SHOOTER.ReportShot(SHOT_LONG);
+}
+
 
 void Robot::RampOff()
 {
@@ -190,9 +223,14 @@ void Robot::Autonomous()
 {
 	Singleton<Logger>::GetInstance().Logf("Starting Autonomous Mode.");
 	Singleton<Collector>::GetInstance().SetBallCount( 2); // preloaded with 2 balls in autonomous
+	POSE.Reset(0.0, 0.0, 0.0);
 
 	primaryDisplay.PrintfLine(0, "Shooting 2");
 	ShootBasket( 2 );
+	while (SEQUENCER.IsActive() && IsAutonomous())
+		Wait(0.05);
+	// Autonomous may have ended mid-shot; don't carry on into teleop.
+	SEQUENCER.Cancel();
 
 	KinectStick leftStick(1);
 	KinectStick rightStick(2);
@@ -240,6 +278,57 @@ void Robot::Autonomous()
 	Singleton<Logger>::GetInstance().Logf("Stopping Autonomous Mode.");
 }
 
+// While disabled, the IR sensors can be calibrated: hold one button with
+// the conveyor empty, then for each sensor in turn hold a ball in front of
+// it and the other button, and save.
+void Robot::Disabled()
+{
+	LOGGER.Logf("Disabled.");
+	IRCalibration& calibration = COLLECTOR.GetIRCalibration();
+	Joystick* stick = joystick1->GetJoystick();
+	IRSensor selected = IR_FRONT;
+	bool nextWasDown = false;
+	bool saveWasDown = false;
+
+	Timer displayUpdateFrequency;
+	displayUpdateFrequency.Start();
+	while (IsDisabled())
+	{
+		if (stick->GetRawButton(IR_SAMPLE_EMPTY_BUTTON))
+			calibration.StartSampling(IR_SENSORS);
+		else if (stick->GetRawButton(IR_SAMPLE_BALL_BUTTON))
+			calibration.StartSampling(selected);
+		else
+			calibration.StopSampling();
+
+		bool nextDown = stick->GetRawButton(IR_NEXT_SENSOR_BUTTON);
+		if (nextDown && !nextWasDown)
+			selected = (IRSensor)((selected + 1) % IR_SENSORS);
+		nextWasDown = nextDown;
+
+		bool saveDown = stick->GetRawButton(IR_SAVE_CALIBRATION_BUTTON);
+		if (saveDown && !saveWasDown)
+		{
+			unsigned calibrated = calibration.Compute();
+			if (calibrated > 0 && calibration.Save())
+				COLLECTOR.ApplyIRCalibration();
+			primaryDisplay.PrintfLine(0, "IR: saved %u sensors", calibrated);
+			calibration.Clear();
+		}
+		saveWasDown = saveDown;
+
+		if (displayUpdateFrequency.HasPeriodPassed(1.0 / 5))
+		{
+			secondaryDisplay.PrintfLine(1, "IR %s: %u/%u", IRCalibration::GetName(selected),
+					calibration.GetSampleCount(selected, false), calibration.GetSampleCount(selected, true));
+			displayUpdateFrequency.Reset();
+			DisplayWrapper::GetInstance()->Output();
+		}
+		Wait(0.02);
+	}
+	calibration.StopSampling();
+}
+
 void Robot::OperatorControl()
 {
 	LOGGER.Logf("Starting operator control.");
@@ -277,7 +366,8 @@ void Robot::OperatorControlLoop()
 
 	while( operatorControlEnabled )
 	{
-		DRIVETRAIN.setEnabled(true);
+		// The shot sequencer holds the drive still while it aims.
+		DRIVETRAIN.setEnabled(!SEQUENCER.IsActive());
 		me->joystickCallbackHandler->Update(); //long call.
 
 		double offset, distance;
@@ -336,60 +426,9 @@ void Robot::ShootBasketTeleoperated()
 
 void Robot::ShootBasket( int shots )
 {
-	double offset = 0.0;
-	double distance = 0.0;
-	Shooter& shooter = Singleton<Shooter>::GetInstance();
-	Collector& collector = Singleton<Collector>::GetInstance();
-	Vision& vision = Singleton<Vision>::GetInstance();
-
-	// disable the drive
-	DRIVETRAIN.setEnabled(false);
-
-	collector.PrepareToShoot();
-
-	Timer alignTimer;
-	alignTimer.Start();
-	int count = 0;
-	
-	double averageDistance = 0.0;
-	
-	while(!alignTimer.HasPeriodPassed(3.5) && (joystick1->GetJoystick()->GetRawButton(1) || shots > 0)) //Shots==0 -> teleop
-	{
-		vision.FindTarget(offset, distance);
-		offset += shotDirectionModifier();
-		distance += shotDistanceModifier();
-
-		ROBOT.secondaryDisplay.PrintfLine(5, "Speed:%f", (SIGN(offset)*-0.175));
-		ROBOT.secondaryDisplay.PrintfLine(6, "Vis:%1.4f,%1.4", offset, distance);
-		DisplayWrapper::GetInstance()->Output();
-		if (fabs(offset) < 0.02 && distance != 0)
-		{
-			averageDistance += distance;
-			count++;
-			if( count >= 10 )
-				break;
-		}
-		shooter.SetTurret((SIGN(offset)*-0.175));
-		Wait(0.05);
-		shooter.SetTurret(0.0);
-		if( fabs(offset) <= .2)
-			Wait(.2 - fabs(offset));
-	}
-	shooter.SetTurret(0.0);
-	
-	averageDistance /= (double) count;
-	distance = averageDistance;
-
-	// if timer expired or the user has released the trigger button
-	if (alignTimer.HasPeriodPassed(3.5) || ( !joystick1->GetJoystick()->GetRawButton(1) && shots == 0 )) { //shots==0==not auto
-		DRIVETRAIN.setEnabled(true); //Fix
-		return;
-	}
-
-	shooter.ShootBasket(distance, joystick1->GetJoystick() , shots );
-	//shooter.SetTopRatio(1.0);
-	//shooter.Shoot(27.7, joystick1->GetJoystick(), shots);
-	DRIVETRAIN.setEnabled(true);
+	// Aiming, spin-up and staging all run in the background at once; the
+	// sequencer fires as soon as they are all ready.
+	SEQUENCER.Start(joystick1->GetJoystick(), shots, shotDirectionModifier(), shotDistanceModifier(), RAPID_FIRE);
 }
 
 void Robot::MoveTurret()
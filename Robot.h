@@ -31,6 +31,7 @@ public:
 	~Robot();
 	void Autonomous();
 	void OperatorControl();
+	void Disabled();
 	
 private:
 	void BalanceRobotOff();
@@ -58,6 +59,8 @@ private:
 	void ShotXDec();
 	void ShotZInc();
 	void ShotZDec();
+	void ShotWasShort();
+	void ShotWasLong();
 
 	void reservePrimaryLines();
 	void reserveSecondaryLines();
@@ -70,6 +73,7 @@ private:
 	AccelPID_Wrapper*			balanceAccelerometer;
 	Vision*						vision;
 	Gyro*						gyro;
+	LSM303_I2C*					compass;
 	PIDController*				balancePID;
 	JoystickCallback<Robot>*	joystickCallbackHandler;
 	JoystickWrapper*			joystick1;
@@ -1,24 +1,78 @@
-#include <WPILib.h>
-#include "SharpIR.h"
-
-SharpIR::SharpIR(UINT8 moduleNumber, UINT32 channel, double signalVoltage, unsigned signalToggleCount ) :
-	AnalogChannel(moduleNumber, channel)
-{
-	this->signalVoltage = signalVoltage;
-	this->signalToggleCount = signalToggleCount;
-	currentCount = 0;
-}
-
-bool SharpIR::Get() 
-{ 
-	if( GetVoltage() > signalVoltage )
-	{
-		currentCount++;
-		return currentCount > signalToggleCount;
-	}
-	else
-	{
-		currentCount = 0;
-		return false;
-	}
-}
+#include <WPILib.h>
+#include "SharpIR.h"
+
+// The FPGA averages 2^AVERAGE_BITS conversions for the trigger, about
+// 2.5 ms of samples at the default module rate.
+static const UINT32 AVERAGE_BITS = 4;
+static const UINT32 OVERSAMPLE_BITS = 0;
+// How far below the signal voltage the trigger switches back off.
+static const float SIGNAL_HYSTERESIS = 0.15f;
+
+SharpIR::SharpIR(UINT8 moduleNumber, UINT32 channel, double signalVoltage, unsigned debounceMs ) :
+	AnalogChannel(moduleNumber, channel),
+	debounceTime(debounceMs / 1000.0),
+	risingTime(0.0),
+	lastSeenEmpty(0.0),
+	handler(NULL),
+	handlerParam(NULL)
+{
+	SetAverageBits(AVERAGE_BITS);
+	SetOversampleBits(OVERSAMPLE_BITS);
+
+	trigger = new AnalogTrigger(moduleNumber, channel);
+	trigger->SetAveraged(true);
+	trigger->SetLimitsVoltage((float)signalVoltage - SIGNAL_HYSTERESIS, (float)signalVoltage);
+	triggerState = trigger->CreateOutput(AnalogTriggerOutput::kState);
+	// Asynchronous interrupts fire on the rising edge of the trigger state.
+	triggerState->RequestInterrupts(Interrupt, this);
+	triggerState->EnableInterrupts();
+}
+
+SharpIR::~SharpIR()
+{
+	delete triggerState;
+	delete trigger;
+}
+
+bool SharpIR::Get() 
+{ 
+	return GetTimeUntilVisible() == 0.0;
+}
+
+double SharpIR::GetTimeUntilVisible()
+{
+	double now = Timer::GetFPGATimestamp();
+	if( !triggerState->Get() )
+	{
+		lastSeenEmpty = now;
+		return -1.0;
+	}
+
+	// If the interrupt for this ball has not been handled yet, it arrived
+	// after we last saw the sensor empty.
+	double since = risingTime;
+	if( since < lastSeenEmpty )
+		since = lastSeenEmpty;
+	double remaining = debounceTime - (now - since);
+	return remaining > 0.0 ? remaining : 0.0;
+}
+
+void SharpIR::RequestInterrupts(tInterruptHandler handler, void* param)
+{
+	handlerParam = param;
+	this->handler = handler;
+}
+
+void SharpIR::SetLimits(double low, double high)
+{
+	trigger->SetLimitsVoltage((float)low, (float)high);
+}
+
+void SharpIR::Interrupt(UINT32 mask, void* param)
+{
+	SharpIR* sensor = (SharpIR*)param;
+	sensor->risingTime = Timer::GetFPGATimestamp();
+	tInterruptHandler handler = sensor->handler;
+	if( handler != NULL )
+		handler(mask, sensor->handlerParam);
+}
@@ -1,18 +1,64 @@
-#ifndef SHARPIR_H
-#define SHARPIR_H
-
-#include <WPILib.h>
-
-class SharpIR : public AnalogChannel
-{
-public:
-	SharpIR(UINT8 moduleNumber, UINT32 channel, double signalVoltage, unsigned signalToggleCount );
-	bool Get();
-
-private:
-	double signalVoltage;
-	unsigned signalToggleCount;
-	unsigned currentCount;
-};
-
-#endif
+#ifndef SHARPIR_H
+#define SHARPIR_H
+
+#include <WPILib.h>
+
+/**
+ * A Sharp IR range sensor used as a ball detector.
+ *
+ * The FPGA averages the sensor's samples and compares them against a
+ * hysteresis band, switching on at the signal voltage and off a little
+ * below it. A ball counts once the comparator has stayed on for the
+ * debounce time, measured from the interrupt its rising edge raises, so
+ * the delay is the same however often anyone looks.
+ */
+class SharpIR : public AnalogChannel
+{
+public:
+	/**
+	 * \param signalVoltage the voltage above which a ball is in view.
+	 * \param debounceMs how long a ball must stay in view to count.
+	 */
+	SharpIR(UINT8 moduleNumber, UINT32 channel, double signalVoltage, unsigned debounceMs );
+	~SharpIR();
+
+	/**
+	 * \return true if a ball has been in view for the debounce time. Goes
+	 * false as soon as the ball leaves.
+	 */
+	bool Get();
+
+	/**
+	 * \return the time until a ball now in view counts (in seconds), 0 if
+	 * it already does, or a negative number if there is none.
+	 */
+	double GetTimeUntilVisible();
+
+	/**
+	 * Call a handler from the interrupt task each time a ball comes into
+	 * view. It runs before the debounce time, so check
+	 * GetTimeUntilVisible(). Balls leaving do not interrupt.
+	 */
+	void RequestInterrupts(tInterruptHandler handler, void* param);
+
+	/**
+	 * Replace the trigger's hysteresis band, such as with calibrated limits.
+	 *
+	 * \param low the voltage below which the ball has gone.
+	 * \param high the voltage above which a ball is in view.
+	 */
+	void SetLimits(double low, double high);
+
+private:
+	static void Interrupt(UINT32 mask, void* param);
+
+	double debounceTime;
+	AnalogTrigger* trigger;
+	AnalogTriggerOutput* triggerState;
+	volatile double risingTime;
+	double lastSeenEmpty;
+	tInterruptHandler handler;
+	void* handlerParam;
+};
+
+#endif
@@ -7,13 +7,23 @@
 #include "DisplayWriter.h"
 #include "DisplayWrapper.h"
 
+static const double DEFAULT_DISTANCE = 16.0;	// the key
+static const char* const SHOT_TABLE_FILE = "/ni-rt/system/shottable.txt";
+static const char* const TELEMETRY_DIRECTORY = "/ni-rt/system/logs";
+// Longest Shoot() waits for the wheels before shooting anyway.
+static const double READY_TIMEOUT = 7.5;
+// How often the rates on the display are refreshed while waiting.
+static const double DISPLAY_PERIOD = 0.1;
+
 void Shooter::reservePrimaryLines() { primaryDisplay.Reserve(1); }
 void Shooter::reserveSecondaryLines() { secondaryDisplay.Reserve(3); }
 
 Shooter::Shooter() :
 		turretDirection(0.0),
 		topRatio(1.0),
-		turretRatio(0.607)
+		turretRatio(0.607),
+		speed(0.0),
+		shotDistance(DEFAULT_DISTANCE)
 {
 	Singleton<Logger>::GetInstance().Logf("Shooter: Starting up...");
 	//Setup Jaguars
@@ -24,20 +34,27 @@ Shooter::Shooter() :
 	bottomEncoder = new SingleChannelEncoder(SHOOTER_BOTTOM_ENCODER_A, *bottomJag);
 	turretEncoder = new Encoder(TURRET_ENCODER_A, TURRET_ENCODER_B);
 	
-	topPID = new PIDController(.12, .013, 0.0, topEncoder, topJag);
-	bottomPID = new PIDController(.12, .013, 0.0, bottomEncoder, bottomJag);
-	
 	topEncoder->Reset();
 	topEncoder->Start();
 	bottomEncoder->Reset();
 	bottomEncoder->Start();
 	
-	topPID->SetSetpoint(0);
-	bottomPID->SetSetpoint(0);
+	// The wheels shoot when driven backwards.
+	topWheel = new FlywheelController("top", *topJag, *topEncoder, true);
+	bottomWheel = new FlywheelController("bottom", *bottomJag, *bottomEncoder, true);
+	readySignal = semBCreate(SEM_Q_PRIORITY, SEM_EMPTY);
+	topWheel->SetReadySignal(readySignal);
+	bottomWheel->SetReadySignal(readySignal);
 	
 	double pulseDistance = (TURRET_WHEEL_DIAMETER / TURRET_LAZY_SUSAN_DIAMETER) * 360.0 / (double)TURRET_ENCODER_PULSES;
 	turretEncoder->SetDistancePerPulse(pulseDistance);
 	turretEncoder->Start(); // This should be running at all times
+	turret = new TurretController(*turretVictor, *turretEncoder, true);
+	
+	shotTable = new ShotTable(SHOT_TABLE_FILE);
+	shotDetector = new ShotDetector(*bottomEncoder, *topEncoder);
+	telemetry = new ShooterTelemetry(TELEMETRY_DIRECTORY, *bottomEncoder, *topEncoder,
+			*bottomWheel, *topWheel, *bottomJag, *topJag);
 }
 
 Shooter::~Shooter()
@@ -46,6 +63,12 @@ Shooter::~Shooter()
 	
 	turretEncoder->Stop();
 	
+	delete telemetry;
+	delete shotDetector;
+	delete turret;
+	delete topWheel;
+	delete bottomWheel;
+	semDelete(readySignal);
 	delete topJag;
 	delete bottomJag;
 	delete turretVictor;
@@ -53,62 +76,47 @@ Shooter::~Shooter()
 	delete topEncoder;
 	delete bottomEncoder;
 	delete turretEncoder;
-	delete topPID;
-	delete bottomPID;
+	delete shotTable;
 }
 
 void Shooter::Shoot(double speed , Joystick* joystick, int shots )
 {
 	Collector& collector = Singleton<Collector>::GetInstance();
 	
-	topPID->Enable();
-	bottomPID->Enable();
-	
-	topPID->SetSetpoint(-1.0 * topRatio * speed);
-	bottomPID->SetSetpoint(-1.0 * speed);
+	SetSpeed(speed);
+	bool firstBall = true;
 	
     do
     {
-	    int count = 0;
-	    int limiter = 0;
+	    Timer readyTimer;
+	    readyTimer.Start();
 	    // wait for shooter to get up to speed as long as they are still pushing the trigger
-        while( count < 10 && limiter < 750 && ( joystick->GetRawButton(1) || shots > 0))
+        // after the first ball, rapid fire only waits for the wheels to recover
+        ConditionFuture ready = firstBall || !RAPID_FIRE ? WhenAtSpeed() : WhenInTolerance();
+        while( !ready.Wait(DISPLAY_PERIOD) && readyTimer.Get() < READY_TIMEOUT && ( joystick->GetRawButton(1) || shots > 0))
 	    {
-            // both encoders there?
-		    if( (fabs(bottomEncoder->GetRate() - speed) <= 0.25 ) && (fabs(topEncoder->GetRate() - (topRatio * speed)) <= 0.25 ))
-			    count++;
-		    else
-			    count = 0;
 		    SHOOTER.secondaryDisplay.PrintfLine(0, "TopRate:%.3f", SHOOTER.topEncoder->GetRate());
 		    SHOOTER.secondaryDisplay.PrintfLine(1, "BotRate:%.3f", SHOOTER.bottomEncoder->GetRate());
 			DisplayWrapper::GetInstance()->Output();
-		    Wait(0.01);
-		    limiter++;
 	    }
         if( joystick->GetRawButton(1) || shots > 0 )
         {
+            LOGGER.Logf("Shooter: %s after %.3f s at %.1f/%.1f rps", IsAtSpeed() ? "ready" : "gave up waiting",
+            		readyTimer.Get(), bottomWheel->GetSpeed(), topWheel->GetSpeed());
             collector.Shoot();
+            RecordShot();
             shots--;
+            firstBall = false;
         }
 
     } while ( joystick->GetRawButton(1) || shots > 0 ); // while joystick trigger is pressed, continue firing
     
-    topPID->SetSetpoint(0);
-	bottomPID->SetSetpoint(0);
-	
-	topPID->Disable();
-	bottomPID->Disable();
-
-	bottomJag->Set(0.0);
-	topJag->Set(0.0);
+    Stop();
 }
 
 void Shooter::ShootBasket(double distance, Joystick* joystick, int shots )
 {
-	if(distance < 1.0) //If bad data, default to key.
-		distance = 16.0;
-	double spin = 1.827142857E-2*distance - 0.19;
-	SetTopRatio(spin);
+	SetDistance(distance);
 	
 	/*
 	// Waiting for the top to stop moving
@@ -119,13 +127,95 @@ void Shooter::ShootBasket(double distance, Joystick* joystick, int shots )
 	}
 	*/
 	
-	Shoot(27.7, joystick, shots );
+	Shoot(speed, joystick, shots );
+}
+
+void Shooter::SetDistance(double distance)
+{
+	if(distance < 1.0) //If bad data, default to key.
+		distance = DEFAULT_DISTANCE;
+	shotDistance = distance;
+	double bottomSpeed, ratio;
+	shotTable->Lookup(distance, bottomSpeed, ratio);
+	SetTopRatio(ratio);
+	SetSpeed(bottomSpeed);
+}
+
+void Shooter::ReportShot(ShotResult result)
+{
+	shotTable->Adjust(shotDistance, result);
+}
+
+void Shooter::RecordShot()
+{
+	telemetry->EndShot();
 }
 
 void Shooter::SetPID(double p, double i, double d)
 {
-	this->bottomPID->SetPID(p, i, d);
-	this->topPID->SetPID(p, i, d);
+	this->bottomWheel->SetPID(p, i, d);
+	this->topWheel->SetPID(p, i, d);
+}
+
+void Shooter::SetFeedforward(double kS, double kV)
+{
+	bottomWheel->SetFeedforward(kS, kV);
+	topWheel->SetFeedforward(kS, kV);
+}
+
+void Shooter::SetSpeed(double speed)
+{
+	if (this->speed <= 0.0 && speed > 0.0)
+		telemetry->StartShot();
+	this->speed = speed;
+	bottomWheel->SetSpeed(speed);
+	topWheel->SetSpeed(topRatio * speed);
+}
+
+bool Shooter::IsAtSpeed() const
+{
+	return bottomWheel->IsAtSpeed() && topWheel->IsAtSpeed();
+}
+
+ConditionFuture Shooter::WhenAtSpeed()
+{
+	return ConditionFuture(readySignal, CallIsAtSpeed, this);
+}
+
+ConditionFuture Shooter::WhenInTolerance()
+{
+	return ConditionFuture(readySignal, CallIsInTolerance, this);
+}
+
+bool Shooter::CallIsAtSpeed(void* shooter)
+{
+	return ((Shooter*)shooter)->IsAtSpeed();
+}
+
+bool Shooter::CallIsInTolerance(void* shooter)
+{
+	return ((Shooter*)shooter)->IsInTolerance();
+}
+
+bool Shooter::IsInTolerance() const
+{
+	return bottomWheel->IsInTolerance() && topWheel->IsInTolerance();
+}
+
+double Shooter::GetSettleTime() const
+{
+	double bottom = bottomWheel->GetSettleTime();
+	double top = topWheel->GetSettleTime();
+	if (bottom < 0.0 || top < 0.0)
+		return -1.0;
+	return bottom > top ? bottom : top;
+}
+
+void Shooter::Stop()
+{
+	speed = 0.0;
+	bottomWheel->Stop();
+	topWheel->Stop();
 }
 
 void Shooter::SetTopRatio(double ratio)
@@ -133,15 +223,31 @@ void Shooter::SetTopRatio(double ratio)
 	topRatio = ratio;
 	if( topRatio > 1.0 )
 		topRatio = 1.0;
+	topWheel->SetSpeed(topRatio * speed);
 }
 
 void Shooter::SetTurret(double direction)
 {
+	turret->Disable();
 	turretDirection = direction;
 	this->turretVictor->Set( -1.0 * turretRatio * direction );
 	SHOOTER.secondaryDisplay.PrintfLine(2, "T:%f", direction);
 }
 
+void Shooter::AimTurret(double offset)
+{
+	// The offset is proportional to the tangent of the bearing, not the bearing.
+	double bearing = radToDeg(atan(offset * tan(degToRad(CAMERA_HALF_FOV))));
+	double angle = turret->GetAngle();
+	turret->SetAngle(angle - bearing);
+	SHOOTER.secondaryDisplay.PrintfLine(2, "T:%.1f->%.1f", angle, angle - bearing);
+}
+
+bool Shooter::IsTurretMoving() const
+{
+	return turret->IsMoving();
+}
+
 void Shooter::SetTurretRatio(double ratio)
 {
 	turretRatio = ratio;
@@ -150,12 +256,11 @@ void Shooter::SetTurretRatio(double ratio)
 
 void Shooter::Update()
 {
+	// The turret controller keeps itself inside its travel.
 	double rotation = turretEncoder->GetDistance();
-	if( (rotation < -90 && turretDirection < 0)  || (rotation > 90 && turretDirection > 0) )
+	if( !turret->IsEnabled() && ((rotation < -90 && turretDirection < 0)  || (rotation > 90 && turretDirection > 0)) )
 		SetTurret(0);
 	
-	topEncoder->PIDGet();
-	bottomEncoder->PIDGet();
     SHOOTER.secondaryDisplay.PrintfLine(0, "TopRate:%.3f", SHOOTER.topEncoder->GetRate());
     SHOOTER.secondaryDisplay.PrintfLine(1, "BotRate:%.3f", SHOOTER.bottomEncoder->GetRate());
 }
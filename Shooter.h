@@ -3,8 +3,14 @@
 
 #include <WPILib.h>
 #include "DisplayWriter.h"
+#include "FlywheelController.h"
+#include "Future.h"
 #include "SharpIR.h"
+#include "ShooterTelemetry.h"
+#include "ShotDetector.h"
+#include "ShotTable.h"
 #include "SingleChannelEncoder.h"
+#include "TurretController.h"
 
 class Shooter
 {
@@ -14,10 +20,69 @@ public:
 	
 	double GetTopRatio() const { return topRatio; }
 	double GetTurretRatio() const { return turretRatio; }
+	bool IsAtSpeed() const;
+	bool IsInTolerance() const;
+
+	/**
+	 * \return a future done when both wheels are at speed.
+	 */
+	ConditionFuture WhenAtSpeed();
+
+	/**
+	 * \return a future done when both wheels are back in tolerance.
+	 */
+	ConditionFuture WhenInTolerance();
+
+	/**
+	 * \return the predicted time until both wheels are at speed (in
+	 * seconds), 0 if they are, or a negative number if it cannot tell.
+	 */
+	double GetSettleTime() const;
+	ShotDetector& GetShotDetector() { return *shotDetector; }
 	void SetPID(double p, double i, double d);
+	void SetFeedforward(double kS, double kV);
 	void SetTopRatio(double ratio);
+	/**
+	 * Drive the turret by hand, cancelling any aiming move.
+	 *
+	 * \param direction the turret speed, positive toward positive angles.
+	 */
 	void SetTurret(double direction);
+
+	/**
+	 * Turn the turret onto a vision target in one profiled move.
+	 *
+	 * \param offset the target's horizontal position in the image, -1 to 1.
+	 */
+	void AimTurret(double offset);
+	bool IsTurretMoving() const;
 	void SetTurretRatio(double ratio);
+
+	/**
+	 * Spin the wheels up, the top one at the top ratio.
+	 *
+	 * \param speed the bottom wheel speed (in revolutions per second).
+	 */
+	void SetSpeed(double speed);
+
+	/**
+	 * Set the wheel speeds for a basket at a distance.
+	 *
+	 * \param distance the distance to the basket (in feet); below 1 means unknown.
+	 */
+	void SetDistance(double distance);
+
+	/**
+	 * Tell the shot table how the last shot taken with SetDistance() went.
+	 */
+	void ReportShot(ShotResult result);
+
+	/**
+	 * Save the telemetry of the shot just taken, from the spin-up or the
+	 * previous shot until the wheels have recovered.
+	 */
+	void RecordShot();
+	void Stop();
 	void Shoot(double speed, Joystick* joyStick, int shots );
 	void ShootBasket(double distance, Joystick* joyStick, int shots );
 	void Update();
@@ -31,15 +96,25 @@ private:
 	double 					turretDirection;
 	Jaguar* 				bottomJag;
 	Jaguar* 				topJag;
-	PIDController*			bottomPID;
-	PIDController*			topPID;
+	FlywheelController*		bottomWheel;
+	FlywheelController*		topWheel;
 	SingleChannelEncoder*	bottomEncoder;
 	SingleChannelEncoder*	topEncoder;
 	Encoder*				turretEncoder;
+	TurretController*		turret;
 	Victor* 				turretVictor;
 	SharpIR*				turretIR;
 	double					topRatio;
 	double					turretRatio;
+	double					speed;
+	double					shotDistance;
+	ShotTable*				shotTable;
+	ShooterTelemetry*		telemetry;
+	ShotDetector*			shotDetector;
+	SEM_ID					readySignal;
+
+	static bool CallIsAtSpeed(void* shooter);
+	static bool CallIsInTolerance(void* shooter);
 };
 
 #endif // SHOOTER_H
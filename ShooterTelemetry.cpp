@@ -0,0 +1,219 @@
+#include <cstdio>
+#include <cstring>
+#include "Collector.h"
+#include "Constants.h"
+#include "FlywheelController.h"
+#include "Logger.h"
+#include "ShooterTelemetry.h"
+#include "SingleChannelEncoder.h"
+#include "Singleton.h"
+
+const double ShooterTelemetry::RATE_SCALE = 100.0;
+const double ShooterTelemetry::OUTPUT_SCALE = 10000.0;
+
+static const double SAMPLE_PERIOD = 0.001;
+// Keep this long after a shot so the file shows the wheels recovering.
+static const UINT32 AFTER_SHOT_SAMPLES = 300;
+// Below the default task priority, so writing never holds up the robot.
+static const INT32 WRITER_PRIORITY = 150;
+static const unsigned MAX_FILES = 1000;
+static const UINT32 COPY_MARGIN = 512;
+
+#define COMPILER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+ShooterTelemetry* ShooterTelemetry::instance = NULL;
+
+ShooterTelemetry::ShooterTelemetry(const char* directory,
+		SingleChannelEncoder& bottomEncoder, SingleChannelEncoder& topEncoder,
+		FlywheelController& bottomWheel, FlywheelController& topWheel,
+		SpeedController& bottomMotor, SpeedController& topMotor) :
+		directory(directory),
+		bottomEncoder(bottomEncoder),
+		topEncoder(topEncoder),
+		bottomWheel(bottomWheel),
+		topWheel(topWheel),
+		bottomMotor(bottomMotor),
+		topMotor(topMotor),
+		samplesWritten(0),
+		pendingCount(0),
+		shotStart(0),
+		fileNumber(0),
+		failed(false)
+{
+	memset(ring, 0, sizeof(ring));
+
+	// Carry on numbering after the files already there.
+	char path[128];
+	for (; fileNumber < MAX_FILES; fileNumber++)
+	{
+		sprintf(path, "%s/shot_%03u.bin", directory, fileNumber);
+		FILE* file = fopen(path, "rb");
+		if (file == NULL)
+			break;
+		fclose(file);
+	}
+	fileNumber %= MAX_FILES;
+
+	// There is only one shooter, so the writer task finds it here.
+	instance = this;
+	lock = semMCreate(SEM_Q_PRIORITY | SEM_DELETE_SAFE | SEM_INVERSION_SAFE);
+	pendingSignal = semBCreate(SEM_Q_PRIORITY, SEM_EMPTY);
+	writerTask = new Task("2502Tl", (FUNCPTR)WriterLoop, WRITER_PRIORITY);
+	writerTask->Start();
+
+	sampler = new Notifier(CallRecord, this);
+	sampler->StartPeriodic(SAMPLE_PERIOD);
+}
+
+ShooterTelemetry::~ShooterTelemetry()
+{
+	sampler->Stop();
+	delete sampler;
+	writerTask->Stop();
+	delete writerTask;
+	semDelete(pendingSignal);
+	semDelete(lock);
+	instance = NULL;
+}
+
+void ShooterTelemetry::StartShot()
+{
+	Synchronized sync(lock);
+	shotStart = samplesWritten;
+}
+
+void ShooterTelemetry::EndShot()
+{
+	Synchronized sync(lock);
+	if (pendingCount == MAX_PENDING)
+	{
+		LOGGER.Logf("ShooterTelemetry: writer behind, shot not saved");
+		return;
+	}
+	Request& request = pending[pendingCount++];
+	request.first = shotStart;
+	request.end = samplesWritten + AFTER_SHOT_SAMPLES;
+	shotStart = request.end;
+	semGive(pendingSignal);
+}
+
+void ShooterTelemetry::CallRecord(void* telemetry)
+{
+	((ShooterTelemetry*)telemetry)->Record();
+}
+
+INT16 ShooterTelemetry::Scale(double value, double scale)
+{
+	double scaled = value * scale;
+	if (scaled > 32767.0)
+		return 32767;
+	if (scaled < -32767.0)
+		return -32767;
+	return (INT16)(scaled < 0.0 ? scaled - 0.5 : scaled + 0.5);
+}
+
+// Only the sampler writes the ring, and only ever the slot after the last.
+void ShooterTelemetry::Record()
+{
+	UINT32 index = samplesWritten;
+	Sample& sample = ring[index % RING_SIZE];
+	sample.time = GetFPGATime();
+	sample.bottomSetpoint = Scale(bottomWheel.GetSpeed(), RATE_SCALE);
+	sample.topSetpoint = Scale(topWheel.GetSpeed(), RATE_SCALE);
+	sample.bottomRate = Scale(bottomEncoder.GetPeriodRate(), RATE_SCALE);
+	sample.topRate = Scale(topEncoder.GetPeriodRate(), RATE_SCALE);
+	sample.bottomOutput = Scale(bottomWheel.GetOutput(), OUTPUT_SCALE);
+	sample.topOutput = Scale(topWheel.GetOutput(), OUTPUT_SCALE);
+	sample.bottomCommand = Scale(bottomMotor.Get(), OUTPUT_SCALE);
+	sample.topCommand = Scale(topMotor.Get(), OUTPUT_SCALE);
+	sample.collectorState = (UINT8)Collector::GetState();
+	sample.flags = (bottomWheel.IsAtSpeed() ? FLAG_BOTTOM_AT_SPEED : 0)
+			| (topWheel.IsAtSpeed() ? FLAG_TOP_AT_SPEED : 0)
+			| (bottomWheel.IsDipping() ? FLAG_BOTTOM_DIPPING : 0);
+	COMPILER_BARRIER();
+	samplesWritten = index + 1;
+}
+
+void ShooterTelemetry::WriterLoop()
+{
+	while (true)
+	{
+		semTake(instance->pendingSignal, WAIT_FOREVER);
+		instance->WritePending();
+	}
+}
+
+void ShooterTelemetry::WritePending()
+{
+	while (true)
+	{
+		Request request;
+		{
+			Synchronized sync(lock);
+			if (pendingCount == 0)
+				return;
+			request = pending[0];
+			for (unsigned i = 1; i < pendingCount; i++)
+				pending[i - 1] = pending[i];
+			pendingCount--;
+		}
+
+		// Let the sampler catch up with the end of the shot.
+		while ((INT32)(request.end - samplesWritten) > 0)
+			Wait(0.01);
+		Write(request);
+	}
+}
+
+void ShooterTelemetry::Write(const Request& request)
+{
+	UINT32 first = request.first;
+	UINT32 end = request.end;
+	Header header;
+	memcpy(header.magic, "SHOT", sizeof(header.magic));
+	header.version = FORMAT_VERSION;
+	header.sampleSize = sizeof(Sample);
+	header.shot = fileNumber;
+	header.dropped = 0;
+
+	// Leave a margin behind the sampler, which keeps overwriting the oldest
+	// slots while this copies.
+	if (end - first > RING_SIZE - COPY_MARGIN)
+	{
+		header.dropped = end - first - (RING_SIZE - COPY_MARGIN);
+		first = end - (RING_SIZE - COPY_MARGIN);
+	}
+	header.count = end - first;
+	for (UINT32 i = first; i != end; i++)
+		copy[i - first] = ring[i % RING_SIZE];
+	COMPILER_BARRIER();
+	// Anything overwritten during the copy is lost too, including the slot
+	// being written now.
+	UINT32 overwritten = samplesWritten + 1 - RING_SIZE;
+	if ((INT32)(overwritten - first) > 0)
+	{
+		UINT32 lost = overwritten - first;
+		if (lost > header.count)
+			lost = header.count;
+		memmove(copy, copy + lost, (header.count - lost) * sizeof(Sample));
+		header.count -= lost;
+		header.dropped += lost;
+	}
+
+	char path[128];
+	sprintf(path, "%s/shot_%03u.bin", directory, fileNumber);
+	FILE* file = fopen(path, "wb");
+	if (file == NULL)
+	{
+		if (!failed)
+			LOGGER.Logf("ShooterTelemetry: could not open %s", path);
+		failed = true;
+		return;
+	}
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(copy, sizeof(Sample), header.count, file);
+	fclose(file);
+	failed = false;
+	LOGGER.Logf("ShooterTelemetry: %u samples to %s, %u dropped", (unsigned)header.count, path, (unsigned)header.dropped);
+	fileNumber = (fileNumber + 1) % MAX_FILES;
+}
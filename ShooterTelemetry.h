@@ -0,0 +1,121 @@
+#ifndef SHOOTERTELEMETRY_H
+#define SHOOTERTELEMETRY_H
+
+#include <WPILib.h>
+
+class FlywheelController;
+class SingleChannelEncoder;
+
+/**
+ * Records the shooter at 1 kHz for plotting each shot afterwards.
+ *
+ * A notifier (which WPILib runs from its high priority interrupt task)
+ * copies the wheel speeds, controller outputs, Jaguar commands and
+ * collector state into a fixed ring; nothing is allocated or written to
+ * disk while sampling. After each shot a low priority task copies that
+ * shot's samples out of the ring into a file of its own.
+ *
+ * Each file is a Header followed by Header::count Samples, written raw in
+ * the cRIO's byte order (big-endian); a reader can tell the order from
+ * Header::version.
+ */
+class ShooterTelemetry
+{
+public:
+	static const UINT16 FORMAT_VERSION = 1;
+
+	struct Header
+	{
+		char magic[4];			// "SHOT"
+		UINT16 version;
+		UINT16 sampleSize;		// sizeof(Sample)
+		UINT32 shot;
+		UINT32 count;
+		UINT32 dropped;			// samples overwritten before they were saved
+	};
+
+	struct Sample
+	{
+		UINT32 time;			// FPGA time (in microseconds)
+		INT16 bottomSetpoint;	// rps * RATE_SCALE
+		INT16 topSetpoint;
+		INT16 bottomRate;
+		INT16 topRate;
+		INT16 bottomOutput;		// controller output * OUTPUT_SCALE
+		INT16 topOutput;
+		INT16 bottomCommand;	// Jaguar command * OUTPUT_SCALE
+		INT16 topCommand;
+		UINT8 collectorState;
+		UINT8 flags;			// FLAG_*
+	};
+
+	static const double RATE_SCALE;
+	static const double OUTPUT_SCALE;
+	static const UINT8 FLAG_BOTTOM_AT_SPEED = 0x01;
+	static const UINT8 FLAG_TOP_AT_SPEED = 0x02;
+	static const UINT8 FLAG_BOTTOM_DIPPING = 0x04;
+
+	/**
+	 * \param directory where the shot files go; must already exist.
+	 */
+	ShooterTelemetry(const char* directory,
+			SingleChannelEncoder& bottomEncoder, SingleChannelEncoder& topEncoder,
+			FlywheelController& bottomWheel, FlywheelController& topWheel,
+			SpeedController& bottomMotor, SpeedController& topMotor);
+	~ShooterTelemetry();
+
+	/**
+	 * Start the next shot's recording from now, e.g. when the wheels start
+	 * spinning up. Otherwise it starts where the last one ended.
+	 */
+	void StartShot();
+
+	/**
+	 * Save everything since the last shot, plus a little after now so the
+	 * wheels' recovery is included. Returns straight away.
+	 */
+	void EndShot();
+
+private:
+	static const unsigned RING_SIZE = 4096;
+	static const unsigned MAX_PENDING = 8;
+
+	struct Request
+	{
+		UINT32 first;
+		UINT32 end;
+	};
+
+	static void CallRecord(void* telemetry);
+	static void WriterLoop();
+	void Record();
+	void WritePending();
+	void Write(const Request& request);
+	static INT16 Scale(double value, double scale);
+
+	static ShooterTelemetry* instance;
+
+	const char* directory;
+	SingleChannelEncoder& bottomEncoder;
+	SingleChannelEncoder& topEncoder;
+	FlywheelController& bottomWheel;
+	FlywheelController& topWheel;
+	SpeedController& bottomMotor;
+	SpeedController& topMotor;
+
+	Notifier* sampler;
+	Sample ring[RING_SIZE];
+	volatile UINT32 samplesWritten;
+
+	Task* writerTask;
+	SEM_ID lock;
+	SEM_ID pendingSignal;
+	Request pending[MAX_PENDING];
+	unsigned pendingCount;
+	UINT32 shotStart;
+	unsigned fileNumber;
+	bool failed;
+	Sample copy[RING_SIZE];
+};
+
+#endif // SHOOTERTELEMETRY_H
@@ -0,0 +1,178 @@
+#include <cmath>
+#include "Constants.h"
+#include "Logger.h"
+#include "ShotDetector.h"
+#include "SingleChannelEncoder.h"
+#include "Singleton.h"
+
+static const double LOOP_PERIOD = 0.002;
+// The baseline follows the speed with this time constant (in seconds).
+static const double BASELINE_TIME_CONSTANT = 0.05;
+// Slower than this (rps), a ball would hardly move the wheel.
+static const double MIN_SPEED = 5.0;
+// Within this fraction of the baseline for this many samples is steady,
+// until the wheel speeds up past it again.
+static const double STEADY_FRACTION = 0.02;
+static const unsigned STEADY_SAMPLES = 20;
+// Below the baseline by this fraction for this many samples is a ball.
+static const double DIP_FRACTION = 0.04;
+static const unsigned DIP_SAMPLES = 3;
+// Back up this fraction of the baseline from the lowest point means the
+// ball has let go.
+static const double RECOVERY_FRACTION = 0.01;
+// A dip longer than this is the wheel being stopped, not a ball.
+static const double MAX_DIP_TIME = 0.3;
+// Both wheels see the same ball.
+static const double SAME_BALL_TIME = 0.1;
+// Longest wait between checks, in case a shot lands just before a wait.
+static const double MAX_WAIT_SLICE = 0.01;
+
+ShotDetector::ShotDetector(SingleChannelEncoder& bottomEncoder, SingleChannelEncoder& topEncoder) :
+		shotListener(NULL),
+		shotCount(0),
+		lastExitTime(0.0)
+{
+	bottom.encoder = &bottomEncoder;
+	top.encoder = &topEncoder;
+	Reset(bottom, 0.0);
+	Reset(top, 0.0);
+	shotSignal = semBCreate(SEM_Q_PRIORITY, SEM_EMPTY);
+	loop = new Notifier(CallUpdate, this);
+	loop->StartPeriodic(LOOP_PERIOD);
+}
+
+ShotDetector::~ShotDetector()
+{
+	loop->Stop();
+	delete loop;
+	semDelete(shotSignal);
+}
+
+bool ShotDetector::IsWatching() const
+{
+	return bottom.baseline > MIN_SPEED || top.baseline > MIN_SPEED;
+}
+
+bool ShotDetector::IsSteady(const Wheel& wheel)
+{
+	return wheel.baseline > MIN_SPEED && (wheel.dipping || wheel.recovering || wheel.steadyCount >= STEADY_SAMPLES);
+}
+
+bool ShotDetector::WaitForShot(unsigned count, double timeout)
+{
+	Timer timer;
+	timer.Start();
+	while (shotCount == count)
+	{
+		double remaining = timeout - timer.Get();
+		if (remaining <= 0.0)
+			return false;
+		if (remaining > MAX_WAIT_SLICE)
+			remaining = MAX_WAIT_SLICE;
+		semTake(shotSignal, (int)(remaining * sysClkRateGet()) + 1);
+	}
+	return true;
+}
+
+void ShotDetector::Reset(Wheel& wheel, double speed)
+{
+	wheel.baseline = speed;
+	wheel.steadyCount = 0;
+	wheel.lowCount = 0;
+	wheel.dipping = false;
+	wheel.recovering = false;
+	wheel.dipStart = 0.0;
+	wheel.lowest = speed;
+	wheel.lowestTime = 0.0;
+}
+
+void ShotDetector::CallUpdate(void* detector)
+{
+	((ShotDetector*)detector)->Update();
+}
+
+void ShotDetector::Update()
+{
+	double now = Timer::GetFPGATimestamp();
+	bool bottomShot = Track(bottom, now);
+	bool topShot = Track(top, now);
+	if (!bottomShot && !topShot)
+		return;
+
+	// Take whichever wheel the ball let go of first.
+	double exitTime;
+	if (bottomShot && topShot)
+		exitTime = bottom.lowestTime < top.lowestTime ? bottom.lowestTime : top.lowestTime;
+	else
+		exitTime = bottomShot ? bottom.lowestTime : top.lowestTime;
+	if (shotCount > 0 && exitTime - lastExitTime < SAME_BALL_TIME)
+		return;
+
+	lastExitTime = exitTime;
+	shotCount++;
+	semFlush(shotSignal);
+	SEM_ID listener = shotListener;
+	if (listener != NULL)
+		semGive(listener);
+	LOGGER.LogfLater("ShotDetector: ball %u left at %.3f, seen %.3f s later", shotCount, exitTime, now - exitTime);
+}
+
+// The FPGA's edge period follows the wheel within a pulse, which the count
+// over a window cannot.
+bool ShotDetector::Track(Wheel& wheel, double now)
+{
+	double speed = wheel.encoder->GetPeriodRate();
+	if (wheel.dipping)
+	{
+		if (speed < wheel.lowest)
+		{
+			wheel.lowest = speed;
+			wheel.lowestTime = now;
+		}
+		else if (speed > wheel.lowest + RECOVERY_FRACTION * wheel.baseline)
+		{
+			wheel.dipping = false;
+			wheel.recovering = true;
+			wheel.lowCount = 0;
+			return true;
+		}
+		if (now - wheel.dipStart > MAX_DIP_TIME)
+			Reset(wheel, speed);
+		return false;
+	}
+
+	// Hold the baseline until the wheel is most of the way back, so the
+	// rest of the recovery does not look like another ball.
+	if (wheel.recovering)
+	{
+		if (speed >= wheel.baseline * (1.0 - DIP_FRACTION))
+			wheel.recovering = false;
+		else if (now - wheel.dipStart > MAX_DIP_TIME)
+			Reset(wheel, speed);
+		else
+			return false;
+	}
+
+	if (IsSteady(wheel) && speed < wheel.baseline * (1.0 - DIP_FRACTION))
+	{
+		if (wheel.lowCount == 0 || speed < wheel.lowest)
+		{
+			wheel.lowest = speed;
+			wheel.lowestTime = now;
+		}
+		if (wheel.lowCount == 0)
+			wheel.dipStart = now;
+		if (++wheel.lowCount >= DIP_SAMPLES)
+			wheel.dipping = true;
+		// Hold the baseline while the ball is in the wheels.
+		return false;
+	}
+
+	wheel.lowCount = 0;
+	wheel.baseline += (speed - wheel.baseline) * LOOP_PERIOD / BASELINE_TIME_CONSTANT;
+	if (speed > wheel.baseline * (1.0 + STEADY_FRACTION))
+		wheel.steadyCount = 0;
+	else if (fabs(speed - wheel.baseline) <= STEADY_FRACTION * wheel.baseline)
+		wheel.steadyCount++;
+	return false;
+}
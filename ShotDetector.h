@@ -0,0 +1,84 @@
+#ifndef SHOTDETECTOR_H
+#define SHOTDETECTOR_H
+
+#include <WPILib.h>
+
+class SingleChannelEncoder;
+
+/**
+ * Sees balls go through the shooter from the wheel speeds.
+ *
+ * A ball squeezed between the wheels slows them down until it lets go, and
+ * then the wheels start to recover. Each wheel's speed is watched against a
+ * slow baseline; a drop that lasts a few samples is a ball, and the moment
+ * the speed bottoms out is when the ball left. Runs on its own notifier and
+ * wakes anyone waiting for a shot.
+ */
+class ShotDetector
+{
+public:
+	ShotDetector(SingleChannelEncoder& bottomEncoder, SingleChannelEncoder& topEncoder);
+	~ShotDetector();
+
+	/**
+	 * \return the number of balls seen leaving since the detector started.
+	 */
+	unsigned GetShotCount() const { return shotCount; }
+
+	/**
+	 * \return the FPGA time the last ball left the wheels (in seconds).
+	 */
+	double GetLastExitTime() const { return lastExitTime; }
+
+	/**
+	 * \return true if a wheel is spinning fast enough to show a ball.
+	 */
+	bool IsWatching() const;
+
+	/**
+	 * Wait for a ball to leave.
+	 *
+	 * \param count the shot count to wait past, e.g. from before firing.
+	 * \param timeout how long to wait (in seconds).
+	 * \return true if the shot count passed count in time.
+	 */
+	bool WaitForShot(unsigned count, double timeout);
+
+	/**
+	 * Give a semaphore each time a ball leaves, for a task that waits on
+	 * other things as well.
+	 *
+	 * \param semaphore the semaphore to give, or NULL to stop.
+	 */
+	void NotifyOnShot(SEM_ID semaphore) { shotListener = semaphore; }
+
+private:
+	struct Wheel
+	{
+		SingleChannelEncoder* encoder;
+		double baseline;
+		unsigned steadyCount;
+		unsigned lowCount;
+		bool dipping;
+		bool recovering;
+		double dipStart;
+		double lowest;
+		double lowestTime;
+	};
+
+	static void CallUpdate(void* detector);
+	void Update();
+	bool Track(Wheel& wheel, double now);
+	static void Reset(Wheel& wheel, double speed);
+	static bool IsSteady(const Wheel& wheel);
+
+	Wheel bottom;
+	Wheel top;
+	Notifier* loop;
+	SEM_ID shotSignal;
+	SEM_ID volatile shotListener;
+	volatile unsigned shotCount;
+	volatile double lastExitTime;
+};
+
+#endif // SHOTDETECTOR_H
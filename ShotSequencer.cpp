@@ -0,0 +1,333 @@
+#include <WPILib.h>
+#include <cmath>
+#include "Collector.h"
+#include "Constants.h"
+#include "DriveTrain.h"
+#include "Logger.h"
+#include "Math.h"
+#include "Shooter.h"
+#include "ShotSequencer.h"
+#include "Singleton.h"
+#include "Vision.h"
+
+static const double LOOP_PERIOD = 0.02;
+static const double ALIGN_TIMEOUT = 3.5;
+// TURRET_ALIGN_TOLERANCE as a vision offset, which goes with the tangent
+// of the bearing.
+static const double ALIGN_TOLERANCE = tan(degToRad(TURRET_ALIGN_TOLERANCE)) / tan(degToRad(CAMERA_HALF_FOV));
+// Frames in a row, each taken with the turret still, that must agree.
+static const unsigned ALIGNED_READINGS = 5;
+// A frame arrives this long after it was taken.
+static const double FRAME_LATENCY = 0.1;
+// Weight given to each new range reading.
+static const double RANGE_FILTER = 0.3;
+// A ball takes longer than this to reach the wheels once the collector
+// starts lifting it, so the wheels only need to be that close to ready.
+static const double FEED_LEAD = 0.15;
+// Give up on wheels that never get to speed, or a ball that never stages
+// or never leaves, by then.
+static const double SPIN_UP_TIMEOUT = 3.0;
+static const double STAGE_TIMEOUT = 3.0;
+static const double FIRE_TIMEOUT = 5.0;
+// After the collector turns a ball down, wait this long before asking again.
+static const double FIRE_RETRY_DELAY = 0.1;
+
+static const char* const PHASE_NAMES[] = { "idle", "aligning", "spinning", "staging", "firing" };
+
+void ShotSequencer::reservePrimaryLines() { primaryDisplay.Reserve(1); }
+void ShotSequencer::reserveSecondaryLines() { secondaryDisplay.Reserve(1); }
+
+ShotSequencer::ShotSequencer() :
+		phase(SHOT_IDLE),
+		joystick(NULL),
+		shots(0),
+		shotsFired(0),
+		offsetTrim(0.0),
+		distanceTrim(0.0),
+		rapidFire(false),
+		offset(0.0),
+		range(0.0),
+		targetVisible(false),
+		targetFrameTime(0.0),
+		countedFrameTime(0.0),
+		alignedCount(0),
+		turretStoppedAt(0.0),
+		shotsAtFire(0),
+		retryTime(0.0),
+		firstExitTime(0.0),
+		lastExitTime(0.0)
+{
+	lock = semMCreate(SEM_Q_PRIORITY | SEM_DELETE_SAFE | SEM_INVERSION_SAFE);
+	sequencerTask = new Task("2502Sq", (FUNCPTR)ThreadLoop);
+	for (int i = 0; i <= FIRING; i++)
+		phaseTimes[i] = 0.0;
+}
+
+ShotSequencer::~ShotSequencer()
+{
+	sequencerTask->Stop();
+	delete sequencerTask;
+	semDelete(lock);
+}
+
+void ShotSequencer::Start(Joystick* joystick, int shots, double offsetTrim, double distanceTrim, bool rapidFire)
+{
+	Synchronized sync(lock);
+	if (IsActive())
+		return;
+
+	// The task needs the singleton, so it waits for the first shot.
+	if (!sequencerTask->Verify())
+		sequencerTask->Start();
+
+	this->joystick = joystick;
+	this->shots = shots;
+	this->offsetTrim = offsetTrim;
+	this->distanceTrim = distanceTrim;
+	this->rapidFire = rapidFire;
+	shotsFired = 0;
+	range = 0.0;
+	targetVisible = false;
+	targetFrameTime = 0.0;
+	countedFrameTime = 0.0;
+	alignedCount = 0;
+	for (int i = 0; i <= FIRING; i++)
+		phaseTimes[i] = 0.0;
+
+	DRIVETRAIN.setEnabled(false);
+	COLLECTOR.PrepareToShoot();
+	// Spin up on the default range now; the vision range replaces it as
+	// soon as there is one.
+	SHOOTER.SetDistance(range);
+
+	turretStoppedAt = 0.0;
+	sequenceTimer.Reset();
+	sequenceTimer.Start();
+	phaseTimer.Reset();
+	phaseTimer.Start();
+	phase = ALIGNING;
+	LOGGER.Logf("ShotSequencer: starting, %d shots%s", shots, rapidFire ? ", rapid fire" : "");
+}
+
+void ShotSequencer::Cancel()
+{
+	Synchronized sync(lock);
+	if (IsActive())
+		Finish("cancelled");
+}
+
+void ShotSequencer::ThreadLoop()
+{
+	while (true)
+	{
+		SEQUENCER.Update();
+		Wait(LOOP_PERIOD);
+	}
+}
+
+bool ShotSequencer::WantsMoreShots() const
+{
+	return shots > 0 || joystick->GetRawButton(1);
+}
+
+void ShotSequencer::Update()
+{
+	Synchronized sync(lock);
+	if (phase == SHOT_IDLE)
+		return;
+	if (phase != FIRING && !WantsMoreShots())
+	{
+		Finish("trigger released");
+		return;
+	}
+
+	UpdateTarget();
+
+	// Several conditions can come true in the same loop; don't wait a loop
+	// for each of them.
+	ShotPhase before;
+	CommandStatus fireStatus;
+	do
+	{
+		before = phase;
+		switch (phase)
+		{
+		case ALIGNING:
+			Aim();
+			// The turret controller holds the angle from here on.
+			if (alignedCount >= ALIGNED_READINGS)
+				EnterPhase(SPINNING);
+			else if (sequenceTimer.Get() > ALIGN_TIMEOUT)
+				Finish("could not align");
+			break;
+		case SPINNING:
+			// In rapid fire the wheels only have to be back in tolerance
+			// after a ball, not settled there. Otherwise start the ball
+			// moving when they are predicted to settle before it arrives.
+			if (rapidFire && shotsFired > 0)
+			{
+				if (SHOOTER.IsInTolerance())
+					EnterPhase(STAGING);
+			}
+			else
+			{
+				double settleTime = SHOOTER.GetSettleTime();
+				if (settleTime >= 0.0 && settleTime <= FEED_LEAD)
+					EnterPhase(STAGING);
+			}
+			if (phase == SPINNING && phaseTimer.Get() > SPIN_UP_TIMEOUT)
+				Finish("wheels never ready");
+			break;
+		case STAGING:
+			if (stageTimer.Get() > STAGE_TIMEOUT)
+			{
+				Finish("no ball staged");
+				break;
+			}
+			if (Timer::GetFPGATimestamp() < retryTime)
+				break;
+			fireShot = COLLECTOR.Fire();
+			if (fireShot.IsPosted())
+			{
+				shotsAtFire = SHOOTER.GetShotDetector().GetShotCount();
+				EnterPhase(FIRING);
+			}
+			break;
+		case FIRING:
+			// The collector finishes as soon as the wheels see the ball go.
+			fireStatus = fireShot.GetStatus();
+			// Going back to staging keeps its deadline; the time counts as
+			// staging too.
+			if (fireStatus == COMMAND_REJECTED || fireStatus == COMMAND_CANCELLED)
+			{
+				// Still busy, stopped, or empty.
+				phase = STAGING;
+				retryTime = Timer::GetFPGATimestamp() + FIRE_RETRY_DELAY;
+			}
+			else if (fireStatus == COMMAND_TIMED_OUT)
+			{
+				// Nothing left the shooter; try the next ball, if any.
+				LOGGER.Logf("ShotSequencer: no ball seen leaving");
+				phase = STAGING;
+				retryTime = Timer::GetFPGATimestamp() + FIRE_RETRY_DELAY;
+			}
+			else if (fireStatus != COMMAND_QUEUED && fireStatus != COMMAND_RUNNING)
+			{
+				ShotDetector& detector = SHOOTER.GetShotDetector();
+				if (detector.GetShotCount() != shotsAtFire)
+					lastExitTime = detector.GetLastExitTime();
+				else
+					lastExitTime = Timer::GetFPGATimestamp();
+				if (shotsFired == 0)
+					firstExitTime = lastExitTime;
+				phaseTimes[FIRING] += phaseTimer.Get();
+				phaseTimer.Reset();
+				shotsFired++;
+				SHOOTER.RecordShot();
+				if (shots > 0)
+					shots--;
+				LOGGER.Logf("ShotSequencer: shot %d at %.1f ft: aligning %.3f spinning %.3f staging %.3f firing %.3f s",
+						shotsFired, range, phaseTimes[ALIGNING], phaseTimes[SPINNING], phaseTimes[STAGING], phaseTimes[FIRING]);
+				secondaryDisplay.PrintfLine(0, "Shot:%.2f/%.2f/%.2f/%.2f", phaseTimes[ALIGNING], phaseTimes[SPINNING],
+						phaseTimes[STAGING], phaseTimes[FIRING]);
+				for (int i = 0; i <= FIRING; i++)
+					phaseTimes[i] = 0.0;
+
+				// Still aligned; the next ball only waits for the wheels.
+				if (WantsMoreShots())
+					phase = SPINNING;
+				else
+					Finish("done");
+			}
+			else if (phaseTimer.Get() > FIRE_TIMEOUT)
+				Finish("ball never left");
+			break;
+		case SHOT_IDLE:
+			break;
+		}
+	} while (phase != before && phase != SHOT_IDLE);
+}
+
+void ShotSequencer::UpdateTarget()
+{
+	double visionOffset, distance, confidence;
+	VISION.FindTarget(visionOffset, distance, confidence, targetFrameTime);
+	targetVisible = (distance != 0.0);
+	if (!targetVisible)
+		return;
+
+	offset = visionOffset + offsetTrim;
+	distance += distanceTrim;
+	range = (range < 1.0) ? distance : range + RANGE_FILTER * (distance - range);
+
+	// Keep refining the wheel speeds until the ball is on its way.
+	if (phase != FIRING)
+		SHOOTER.SetDistance(range);
+	primaryDisplay.PrintfLine(0, "%s %.1fft", PHASE_NAMES[phase], range);
+}
+
+// The vision offset is only meaningful for a frame taken with the turret
+// still, so aim in one profiled move and look again once it has stopped.
+// The loop runs faster than the camera, so each frame is only counted once.
+void ShotSequencer::Aim()
+{
+	double now = Timer::GetFPGATimestamp();
+	if (SHOOTER.IsTurretMoving())
+	{
+		turretStoppedAt = now;
+		alignedCount = 0;
+		return;
+	}
+	if (!targetVisible)
+	{
+		alignedCount = 0;
+		return;
+	}
+	// Taken after the turret stopped, and not seen before.
+	if (targetFrameTime - FRAME_LATENCY < turretStoppedAt || targetFrameTime <= countedFrameTime)
+		return;
+	countedFrameTime = targetFrameTime;
+
+	if (fabs(offset) < ALIGN_TOLERANCE)
+	{
+		alignedCount++;
+		return;
+	}
+	alignedCount = 0;
+	SHOOTER.AimTurret(offset);
+	turretStoppedAt = now;
+}
+
+void ShotSequencer::EnterPhase(ShotPhase next)
+{
+	phaseTimes[phase] += phaseTimer.Get();
+	phaseTimer.Reset();
+	if (next == STAGING)
+	{
+		stageTimer.Reset();
+		stageTimer.Start();
+		retryTime = 0.0;
+	}
+	phase = next;
+}
+
+void ShotSequencer::Finish(const char* reason)
+{
+	if (phase != SHOT_IDLE)
+		phaseTimes[phase] += phaseTimer.Get();
+	LOGGER.Logf("ShotSequencer: %s after %d shots, %.3f s, in %s", reason, shotsFired, sequenceTimer.Get(),
+			PHASE_NAMES[phase]);
+	// The first ball only starts the clock, so it is not counted in the rate.
+	if (rapidFire && shotsFired > 1 && lastExitTime > firstExitTime)
+	{
+		double rate = (shotsFired - 1) / (lastExitTime - firstExitTime);
+		LOGGER.Logf("ShotSequencer: %d balls, %.3f s from the first leaving to the last, %.2f balls/s", shotsFired,
+				lastExitTime - firstExitTime, rate);
+		secondaryDisplay.PrintfLine(0, "Rapid:%d %.2f/s", shotsFired, rate);
+	}
+	phase = SHOT_IDLE;
+	SHOOTER.SetTurret(0.0);
+	SHOOTER.Stop();
+	DRIVETRAIN.setEnabled(true);
+	primaryDisplay.PrintfLine(0, "Shot %s", reason);
+}
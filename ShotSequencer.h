@@ -0,0 +1,90 @@
+#ifndef SHOTSEQUENCER_H
+#define SHOTSEQUENCER_H
+
+#include <WPILib.h>
+#include "CommandQueue.h"
+#include "DisplayWriter.h"
+
+enum ShotPhase
+{
+	SHOT_IDLE,
+	ALIGNING,		// turret still turning onto the target
+	SPINNING,		// aligned, wheels not at speed yet
+	STAGING,		// aligned and at speed, ball not staged yet
+	FIRING			// ball on its way out
+};
+
+/**
+ * Runs a shot in the background. The wheels start spinning on the latest
+ * vision range while the turret is still aligning, the range keeps being
+ * refined until the ball is fired, and the ball is fired as soon as the
+ * turret, the wheels and the collector are all ready.
+ */
+class ShotSequencer
+{
+public:
+	ShotSequencer();
+	~ShotSequencer();
+
+	/**
+	 * Begin shooting and return immediately.
+	 *
+	 * \param joystick while shots is 0, keep shooting as long as its trigger is held.
+	 * \param shots the number of balls to shoot, 0 to follow the trigger.
+	 * \param offsetTrim added to the vision offset.
+	 * \param distanceTrim added to the vision distance (in feet).
+	 * \param rapidFire feed each ball after the first as soon as the wheels
+	 * have recovered from the last one, rather than waiting for them to
+	 * settle again.
+	 */
+	void Start(Joystick* joystick, int shots, double offsetTrim, double distanceTrim, bool rapidFire = false);
+	void Cancel();
+	bool IsActive() const { return phase != SHOT_IDLE; }
+	ShotPhase GetPhase() const { return phase; }
+
+	void reservePrimaryLines();
+	void reserveSecondaryLines();
+
+	DisplayWriter primaryDisplay;
+	DisplayWriter secondaryDisplay;
+
+private:
+	static void ThreadLoop();
+	void Update();
+	void UpdateTarget();
+	void Aim();
+	void EnterPhase(ShotPhase next);
+	void Finish(const char* reason);
+	bool WantsMoreShots() const;
+
+	Task* sequencerTask;
+	SEM_ID lock;
+	ShotPhase phase;
+	Joystick* joystick;
+	int shots;
+	int shotsFired;
+	double offsetTrim;
+	double distanceTrim;
+	bool rapidFire;
+
+	double offset;
+	double range;
+	bool targetVisible;
+	double targetFrameTime;
+	double countedFrameTime;
+	unsigned alignedCount;
+	double turretStoppedAt;
+
+	unsigned shotsAtFire;
+	CommandFuture fireShot;
+	double retryTime;
+	double firstExitTime;
+	double lastExitTime;
+
+	Timer phaseTimer;
+	Timer stageTimer;		// since staging this ball began, across retries
+	Timer sequenceTimer;
+	double phaseTimes[FIRING + 1];
+};
+
+#endif // SHOTSEQUENCER_H
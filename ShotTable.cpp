@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include "Constants.h"
+#include "Logger.h"
+#include "Singleton.h"
+#include "ShotTable.h"
+
+using std::string;
+using std::vector;
+
+// How much a miss moves the bottom wheel speed (rps).
+static const double SPEED_STEP = 0.3;
+static const double MIN_SPEED = 10.0;
+static const double MAX_SPEED = 40.0;
+
+// Used when there is no table file yet: the old fitted line at 27.7 rps.
+static const double DEFAULT_SPEED = 27.7;
+static const double DEFAULT_FIRST_DISTANCE = 12.0;
+static const double DEFAULT_LAST_DISTANCE = 24.0;
+static const double DEFAULT_STEP = 2.0;
+
+/**
+ * Fritsch-Carlson tangents for a monotone cubic through the points.
+ */
+static void MonotoneSlopes(const vector<double>& x, const vector<double>& y, vector<double>& m)
+{
+	unsigned n = x.size();
+	m.assign(n, 0.0);
+	if (n < 2)
+		return;
+
+	vector<double> delta(n - 1);
+	for (unsigned k = 0; k + 1 < n; k++)
+		delta[k] = (y[k + 1] - y[k]) / (x[k + 1] - x[k]);
+
+	m[0] = delta[0];
+	m[n - 1] = delta[n - 2];
+	for (unsigned k = 1; k + 1 < n; k++)
+		m[k] = (delta[k - 1] * delta[k] > 0.0) ? (delta[k - 1] + delta[k]) / 2.0 : 0.0;
+
+	for (unsigned k = 0; k + 1 < n; k++)
+	{
+		if (delta[k] == 0.0)
+		{
+			m[k] = 0.0;
+			m[k + 1] = 0.0;
+			continue;
+		}
+		double a = m[k] / delta[k];
+		double b = m[k + 1] / delta[k];
+		double length = a * a + b * b;
+		if (length > 9.0)
+		{
+			double tau = 3.0 / sqrt(length);
+			m[k] = tau * a * delta[k];
+			m[k + 1] = tau * b * delta[k];
+		}
+	}
+}
+
+ShotTable::ShotTable(const string& fileName) :
+		fileName(fileName)
+{
+	lock = semMCreate(SEM_Q_PRIORITY | SEM_DELETE_SAFE | SEM_INVERSION_SAFE);
+	Load();
+}
+
+ShotTable::~ShotTable()
+{
+	semDelete(lock);
+}
+
+void ShotTable::LoadDefaults()
+{
+	entries.clear();
+	for (double distance = DEFAULT_FIRST_DISTANCE; distance <= DEFAULT_LAST_DISTANCE; distance += DEFAULT_STEP)
+	{
+		Entry entry;
+		entry.distance = distance;
+		entry.bottomSpeed = DEFAULT_SPEED;
+		entry.topRatio = 1.827142857E-2 * distance - 0.19;
+		entries.push_back(entry);
+	}
+	ComputeSlopes();
+}
+
+bool ShotTable::EarlierEntry(const Entry& a, const Entry& b)
+{
+	return a.distance < b.distance;
+}
+
+bool ShotTable::Load()
+{
+	Synchronized sync(lock);
+	std::ifstream file(fileName.c_str());
+	vector<Entry> loaded;
+	string line;
+	while (file && std::getline(file, line))
+	{
+		string::size_type comment = line.find('#');
+		if (comment != string::npos)
+			line.erase(comment);
+		Entry entry;
+		if (sscanf(line.c_str(), "%lf %lf %lf", &entry.distance, &entry.bottomSpeed, &entry.topRatio) != 3)
+			continue;
+		loaded.push_back(entry);
+	}
+	std::sort(loaded.begin(), loaded.end(), EarlierEntry);
+
+	// Two entries at the same distance would leave nothing to interpolate.
+	entries.clear();
+	for (unsigned i = 0; i < loaded.size(); i++)
+		if (entries.empty() || loaded[i].distance > entries.back().distance)
+			entries.push_back(loaded[i]);
+
+	if (entries.size() < 2)
+	{
+		LOGGER.Logf("ShotTable: no usable table in %s, using the defaults", fileName.c_str());
+		LoadDefaults();
+		return false;
+	}
+	ComputeSlopes();
+	LOGGER.Logf("ShotTable: loaded %u entries from %s", entries.size(), fileName.c_str());
+	return true;
+}
+
+bool ShotTable::Save() const
+{
+	Synchronized sync(lock);
+	std::ofstream file(fileName.c_str(), std::ios::trunc);
+	if (!file)
+	{
+		LOGGER.Logf("ShotTable: could not write %s", fileName.c_str());
+		return false;
+	}
+	file << "# distance(ft) bottom(rps) topRatio" << std::endl;
+	for (unsigned i = 0; i < entries.size(); i++)
+	{
+		char line[80];
+		sprintf(line, "%.2f %.3f %.4f", entries[i].distance, entries[i].bottomSpeed, entries[i].topRatio);
+		file << line << std::endl;
+	}
+	return true;
+}
+
+void ShotTable::ComputeSlopes()
+{
+	vector<double> x, speed, ratio, speedSlopes, ratioSlopes;
+	for (unsigned i = 0; i < entries.size(); i++)
+	{
+		x.push_back(entries[i].distance);
+		speed.push_back(entries[i].bottomSpeed);
+		ratio.push_back(entries[i].topRatio);
+	}
+	MonotoneSlopes(x, speed, speedSlopes);
+	MonotoneSlopes(x, ratio, ratioSlopes);
+	for (unsigned i = 0; i < entries.size(); i++)
+	{
+		entries[i].speedSlope = speedSlopes[i];
+		entries[i].ratioSlope = ratioSlopes[i];
+	}
+}
+
+// The index of the entry starting the interval holding a distance, which
+// the caller has already clamped to the table.
+unsigned ShotTable::FindInterval(double distance) const
+{
+	unsigned k = 0;
+	while (k + 2 < entries.size() && distance > entries[k + 1].distance)
+		k++;
+	return k;
+}
+
+double ShotTable::Hermite(double x0, double x1, double y0, double y1, double m0, double m1, double x)
+{
+	double h = x1 - x0;
+	double t = (x - x0) / h;
+	double t2 = t * t;
+	double t3 = t2 * t;
+	return (2 * t3 - 3 * t2 + 1) * y0 + (t3 - 2 * t2 + t) * h * m0 + (-2 * t3 + 3 * t2) * y1 + (t3 - t2) * h * m1;
+}
+
+void ShotTable::Lookup(double distance, double& bottomSpeed, double& topRatio) const
+{
+	Synchronized sync(lock);
+	if (distance <= entries.front().distance)
+	{
+		bottomSpeed = entries.front().bottomSpeed;
+		topRatio = entries.front().topRatio;
+		return;
+	}
+	if (distance >= entries.back().distance)
+	{
+		bottomSpeed = entries.back().bottomSpeed;
+		topRatio = entries.back().topRatio;
+		return;
+	}
+
+	unsigned k = FindInterval(distance);
+	const Entry& a = entries[k];
+	const Entry& b = entries[k + 1];
+	bottomSpeed = Hermite(a.distance, b.distance, a.bottomSpeed, b.bottomSpeed, a.speedSlope, b.speedSlope, distance);
+	topRatio = Hermite(a.distance, b.distance, a.topRatio, b.topRatio, a.ratioSlope, b.ratioSlope, distance);
+}
+
+void ShotTable::Adjust(double distance, ShotResult result)
+{
+	Synchronized sync(lock);
+	unsigned k = FindInterval(distance);
+	Entry& a = entries[k];
+	Entry& b = entries[k + 1];
+	double t = (distance - a.distance) / (b.distance - a.distance);
+	if (t < 0.0)
+		t = 0.0;
+	if (t > 1.0)
+		t = 1.0;
+
+	if (result == SHOT_HIT)
+	{
+		LOGGER.Logf("ShotTable: hit at %.1f ft", distance);
+		return;
+	}
+
+	double step = (result == SHOT_SHORT) ? SPEED_STEP : -SPEED_STEP;
+	a.bottomSpeed = std::max(MIN_SPEED, std::min(MAX_SPEED, a.bottomSpeed + step * (1.0 - t)));
+	b.bottomSpeed = std::max(MIN_SPEED, std::min(MAX_SPEED, b.bottomSpeed + step * t));
+	ComputeSlopes();
+	LOGGER.Logf("ShotTable: %s at %.1f ft, %.1f ft now %.2f rps, %.1f ft now %.2f rps",
+			result == SHOT_SHORT ? "short" : "long", distance, a.distance, a.bottomSpeed, b.distance, b.bottomSpeed);
+	Save();
+}
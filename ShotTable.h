@@ -0,0 +1,86 @@
+#ifndef SHOTTABLE_H
+#define SHOTTABLE_H
+
+#include <WPILib.h>
+#include <string>
+#include <vector>
+
+enum ShotResult
+{
+	SHOT_HIT,
+	SHOT_SHORT,
+	SHOT_LONG
+};
+
+/**
+ * The wheel settings for each distance, loaded from a text file so they
+ * can be retuned without a redeploy.
+ *
+ * Each line of the file holds "distance bottomSpeed topRatio" (feet, rps,
+ * ratio); '#' starts a comment. Between entries each column is
+ * interpolated with a monotone cubic (Fritsch-Carlson), so the curve never
+ * overshoots the measured points. Beyond the ends the end entries are used.
+ */
+class ShotTable
+{
+public:
+	/**
+	 * \param fileName where the table is loaded from and saved to.
+	 */
+	ShotTable(const std::string& fileName);
+	~ShotTable();
+
+	/**
+	 * Reload the table from its file, falling back to the built-in table if
+	 * the file is missing or has fewer than two entries.
+	 *
+	 * \return true if the file was read.
+	 */
+	bool Load();
+
+	/**
+	 * \return true if the table was written.
+	 */
+	bool Save() const;
+
+	/**
+	 * \param distance the distance to the basket (in feet).
+	 * \param bottomSpeed the bottom wheel speed (in revolutions per second).
+	 * \param topRatio the top wheel speed as a fraction of the bottom.
+	 */
+	void Lookup(double distance, double& bottomSpeed, double& topRatio) const;
+
+	/**
+	 * Nudge the entries around a distance after a miss and save the table.
+	 * The nudge is split between the two entries either side, by how close
+	 * the shot was to each.
+	 *
+	 * \param distance the distance the shot was taken from (in feet).
+	 * \param result whether it went in, fell short or went long.
+	 */
+	void Adjust(double distance, ShotResult result);
+
+	unsigned GetSize() const { return entries.size(); }
+
+private:
+	struct Entry
+	{
+		double distance;
+		double bottomSpeed;
+		double topRatio;
+		double speedSlope;
+		double ratioSlope;
+	};
+
+	static bool EarlierEntry(const Entry& a, const Entry& b);
+	void LoadDefaults();
+	void ComputeSlopes();
+	unsigned FindInterval(double distance) const;
+	static double Hermite(double x0, double x1, double y0, double y1, double m0, double m1, double x);
+
+	std::string fileName;
+	std::vector<Entry> entries;
+	SEM_ID lock;
+};
+
+#endif // SHOTTABLE_H
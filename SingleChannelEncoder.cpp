@@ -1,29 +1,143 @@
-#include "Math.h"
-#include "SingleChannelEncoder.h"
-
-SingleChannelEncoder::SingleChannelEncoder(UINT32 channel, SpeedController& controller) :
-		Counter(channel),
-		rate(0.0),
-		controller(controller)
-{
-	timer = new Timer();
-	timer->Start();
-}
-
-SingleChannelEncoder::~SingleChannelEncoder()
-{
-	delete timer;
-}
-
-double SingleChannelEncoder::GetRate() const
-{
-	return rate;
-}
-
-double SingleChannelEncoder::PIDGet()
-{
-	rate = ((double)Get() / 128.0) / timer->Get();
-	Reset();
-	timer->Reset();
-	return rate * (controller.Get() > 0 ? 1.0 : -1.0);
-}
+#include "Math.h"
+#include "SingleChannelEncoder.h"
+
+const double SingleChannelEncoder::PULSES_PER_REVOLUTION = 128.0;
+const double SingleChannelEncoder::DEFAULT_RATE_WINDOW = 0.04;
+
+static const double SAMPLE_PERIOD = 0.002;		// 128 samples covers 0.256 s
+static const double MAX_EDGE_PERIOD = 0.1;		// slower than 0.08 rps counts as stopped
+static const UINT32 WRITING = 0xFFFFFFFF;
+
+// The cRIO has a single core, so keeping the compiler from reordering the
+// ring accesses is all the ordering the readers need.
+#define COMPILER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+SingleChannelEncoder::SingleChannelEncoder(UINT32 channel, SpeedController& controller) :
+		Counter(channel),
+		controller(controller),
+		samplesWritten(0),
+		lastRawCount(0),
+		totalCount(0)
+{
+	for (unsigned i = 0; i < HISTORY_SIZE; i++)
+		history[i].sequence = WRITING;
+	SetMaxPeriod(MAX_EDGE_PERIOD);
+
+	sampler = new Notifier(SampleCount, this);
+	sampler->StartPeriodic(SAMPLE_PERIOD);
+}
+
+SingleChannelEncoder::~SingleChannelEncoder()
+{
+	sampler->Stop();
+	delete sampler;
+}
+
+void SingleChannelEncoder::SampleCount(void* encoder)
+{
+	((SingleChannelEncoder*)encoder)->Record();
+}
+
+// Only the sampler writes the ring. Each slot carries the index of the
+// sample in it, so a reader that was overtaken by the writer can tell.
+void SingleChannelEncoder::Record()
+{
+	INT32 raw = Get();
+	// Someone reset the counter; keep the history monotonic.
+	totalCount += (raw >= lastRawCount) ? raw - lastRawCount : raw;
+	lastRawCount = raw;
+
+	UINT32 index = samplesWritten;
+	Sample& slot = history[index % HISTORY_SIZE];
+	slot.sequence = WRITING;
+	COMPILER_BARRIER();
+	slot.time = Timer::GetFPGATimestamp();
+	slot.count = totalCount;
+	COMPILER_BARRIER();
+	slot.sequence = index;
+	COMPILER_BARRIER();
+	samplesWritten = index + 1;
+}
+
+bool SingleChannelEncoder::ReadSample(UINT32 index, double& time, INT32& count) const
+{
+	const Sample& slot = history[index % HISTORY_SIZE];
+	if (slot.sequence != index)
+		return false;
+	COMPILER_BARRIER();
+	time = slot.time;
+	count = slot.count;
+	COMPILER_BARRIER();
+	return slot.sequence == index;
+}
+
+double SingleChannelEncoder::GetRate() const
+{
+	return GetRate(DEFAULT_RATE_WINDOW);
+}
+
+double SingleChannelEncoder::GetRate(double window) const
+{
+	UINT32 written = samplesWritten;
+	if (written < 2)
+		return 0.0;
+
+	double newestTime;
+	INT32 newestCount;
+	if (!ReadSample(written - 1, newestTime, newestCount))
+		return 0.0;
+
+	// Walk back to the first sample at least a window old, stopping early if
+	// the history runs out or the writer laps us.
+	UINT32 oldest = (written > HISTORY_SIZE - 1) ? written - (HISTORY_SIZE - 1) : 0;
+	double startTime = newestTime;
+	INT32 startCount = newestCount;
+	for (UINT32 index = written - 1; index-- > oldest;)
+	{
+		double time;
+		INT32 count;
+		if (!ReadSample(index, time, count))
+			break;
+		startTime = time;
+		startCount = count;
+		if (newestTime - time >= window)
+			break;
+	}
+
+	if (newestTime <= startTime)
+		return 0.0;
+	return (newestCount - startCount) / PULSES_PER_REVOLUTION / (newestTime - startTime);
+}
+
+unsigned SingleChannelEncoder::GetHistory(double window, double* times, double* revolutions, unsigned size) const
+{
+	UINT32 written = samplesWritten;
+	UINT32 oldest = (written > HISTORY_SIZE - 1) ? written - (HISTORY_SIZE - 1) : 0;
+	unsigned copied = 0;
+	for (UINT32 index = written; index-- > oldest && copied < size;)
+	{
+		double time;
+		INT32 count;
+		if (!ReadSample(index, time, count))
+			break;
+		if (copied > 0 && times[0] - time > window)
+			break;
+		times[copied] = time;
+		revolutions[copied] = count / PULSES_PER_REVOLUTION;
+		copied++;
+	}
+	return copied;
+}
+
+double SingleChannelEncoder::GetPeriodRate()
+{
+	double period = GetPeriod();
+	if (GetStopped() || period <= 0.0 || period > MAX_EDGE_PERIOD)
+		return 0.0;
+	return 1.0 / (period * PULSES_PER_REVOLUTION);
+}
+
+double SingleChannelEncoder::PIDGet()
+{
+	return GetRate() * (controller.Get() > 0 ? 1.0 : -1.0);
+}
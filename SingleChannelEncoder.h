@@ -1,21 +1,81 @@
-#ifndef SINGLECHANNELENCODER_H
-#define SINGLECHANNELENCODER_H
-
-#include <WPILib.h>
-
-class SingleChannelEncoder : public Counter, public PIDSource
-{
-public:
-	SingleChannelEncoder(UINT32 channel, SpeedController& controller);
-	~SingleChannelEncoder();
-	
-	double GetRate() const;
-	double PIDGet();
-	
-private:
-	double rate;
-	SpeedController& controller;
-	Timer* timer;
-};
-
-#endif // SINGLECHANNELENCODER_H
+#ifndef SINGLECHANNELENCODER_H
+#define SINGLECHANNELENCODER_H
+
+#include <WPILib.h>
+
+/**
+ * A wheel speed sensor on a single digital channel.
+ *
+ * A notifier samples the count with an FPGA timestamp into a ring, so any
+ * number of readers can measure the rate over their own window without
+ * disturbing each other. Reading never resets the counter.
+ */
+class SingleChannelEncoder : public Counter, public PIDSource
+{
+public:
+	static const double PULSES_PER_REVOLUTION;
+	static const double DEFAULT_RATE_WINDOW;
+
+	SingleChannelEncoder(UINT32 channel, SpeedController& controller);
+	~SingleChannelEncoder();
+
+	/**
+	 * Get the wheel speed averaged over the default window.
+	 *
+	 * \return the speed (in revolutions per second).
+	 */
+	double GetRate() const;
+
+	/**
+	 * Get the wheel speed averaged over a window.
+	 *
+	 * \param window how far back to look (in seconds). Windows longer than
+	 * the sample history use all of it.
+	 * \return the speed (in revolutions per second).
+	 */
+	double GetRate(double window) const;
+
+	/**
+	 * Get the wheel speed from the FPGA's measurement of the time between the
+	 * last two edges. This has the least lag but is also the noisiest.
+	 *
+	 * \return the speed (in revolutions per second), 0 if the wheel stopped.
+	 */
+	double GetPeriodRate();
+
+	/**
+	 * Copy out the recent samples, newest first.
+	 *
+	 * \param window how far back to look (in seconds).
+	 * \param times the FPGA time of each sample (in seconds).
+	 * \param revolutions the total count at each sample (in revolutions).
+	 * \param size the room in times and revolutions.
+	 * \return the number of samples copied.
+	 */
+	unsigned GetHistory(double window, double* times, double* revolutions, unsigned size) const;
+
+	double PIDGet();
+
+private:
+	struct Sample
+	{
+		volatile UINT32 sequence;
+		double time;
+		INT32 count;
+	};
+
+	static const unsigned HISTORY_SIZE = 128;
+
+	static void SampleCount(void* encoder);
+	void Record();
+	bool ReadSample(UINT32 index, double& time, INT32& count) const;
+
+	SpeedController& controller;
+	Notifier* sampler;
+	Sample history[HISTORY_SIZE];
+	volatile UINT32 samplesWritten;
+	INT32 lastRawCount;
+	INT32 totalCount;
+};
+
+#endif // SINGLECHANNELENCODER_H
@@ -6,22 +6,99 @@
 #include <fstream>
 #include "SquareFinder.h"
 #include "Math.h"
+#include "RectangleFitter.h"
 #include "DisplayWriter.h"
 #include "Singleton.h"
 
 static bool ParticleLogging = false;	// false to turn off; true to turn on
 
+static const double TARGET_ASPECT = 24.0 / 18.0;	// outer edge of the tape, width / height
+static const int EDGE_PROBE = 2;					// pixels inside/outside the box edge to compare
+static const double OCCLUDED_PENALTY = 0.8;		// confidence scale for rectangles rebuilt from their edges
+
+/**
+ * Average how much brighter the pixels just inside a bounding box are than
+ * the pixels just outside it. A crisp piece of tape scores near 1, a blob
+ * with soft or noisy edges scores low.
+ */
+static double MeasureEdgeSharpness(const ImageInfo& info, int left, int top, int w, int h)
+{
+	const unsigned char* pixels = (const unsigned char*)info.imageStart;
+	int stride = info.pixelsPerLine;
+	int right = left + w - 1;
+	int bottom = top + h - 1;
+	double sum = 0.0;
+	int samples = 0;
+
+	for (int x = left; x <= right; x += 2)
+	{
+		if (top - EDGE_PROBE >= 0)
+		{
+			sum += pixels[(top + EDGE_PROBE) * stride + x] - pixels[(top - EDGE_PROBE) * stride + x];
+			samples++;
+		}
+		if (bottom + EDGE_PROBE < info.yRes)
+		{
+			sum += pixels[(bottom - EDGE_PROBE) * stride + x] - pixels[(bottom + EDGE_PROBE) * stride + x];
+			samples++;
+		}
+	}
+	for (int y = top; y <= bottom; y += 2)
+	{
+		if (left - EDGE_PROBE >= 0)
+		{
+			sum += pixels[y * stride + left + EDGE_PROBE] - pixels[y * stride + left - EDGE_PROBE];
+			samples++;
+		}
+		if (right + EDGE_PROBE < info.xRes)
+		{
+			sum += pixels[y * stride + right - EDGE_PROBE] - pixels[y * stride + right + EDGE_PROBE];
+			samples++;
+		}
+	}
+
+	if (samples == 0)
+		return 0.0;
+	double sharpness = sum / samples / 255.0;
+	return sharpness < 0.0 ? 0.0 : (sharpness > 1.0 ? 1.0 : sharpness);
+}
+
+/**
+ * Fill in the quality metrics of a report and combine them into one score.
+ * The caller has already set rectangularity (for rectangles rebuilt from
+ * their edges, the fraction of the perimeter that was actually seen).
+ */
+static void ScoreReport(TargetReport& report, const ImageInfo& info)
+{
+	report.aspectError = fabs((report.width / report.height) / TARGET_ASPECT - 1.0);
+	report.edgeSharpness = MeasureEdgeSharpness(info, (int)report.x, (int)report.y, (int)report.width, (int)report.height);
+
+	double rectangularScore = (report.rectangularity - 0.5) / 0.5;
+	double aspectScore = 1.0 - report.aspectError / 0.5;
+	double edgeScore = report.edgeSharpness / 0.5;
+	rectangularScore = rectangularScore < 0.0 ? 0.0 : (rectangularScore > 1.0 ? 1.0 : rectangularScore);
+	aspectScore = aspectScore < 0.0 ? 0.0 : aspectScore;
+	edgeScore = edgeScore > 1.0 ? 1.0 : edgeScore;
+	report.confidence = rectangularScore * aspectScore * edgeScore;
+	if (report.occluded)
+		report.confidence *= OCCLUDED_PENALTY;
+}
+
 void SquareFinder::reservePrimaryLines() { primaryDisplay.Reserve(0); }
 void SquareFinder::reserveSecondaryLines() { secondaryDisplay.Reserve(0); }
 
 
-SquareFinder::SquareFinder()
+SquareFinder::SquareFinder() :
+	fitter(TARGET_ASPECT)
 {
 	lumPlane = imaqCreateImage(IMAQ_IMAGE_U8, 7);
+	binaryPlane = imaqCreateImage(IMAQ_IMAGE_U8, 7);
+	fixedThreshold = -1;
 }
 
 SquareFinder::~SquareFinder()
 {
+	imaqDispose(binaryPlane);
 	imaqDispose(lumPlane);
 }
 
@@ -48,9 +125,13 @@ void SquareFinder::GetBestTargets(HSLImage *img, vector<TargetReport> &targets,
 
 	imaqExtractColorPlanes(image, IMAQ_HSL, NULL, NULL, lumPlane);
 
-	image = lumPlane;
+	// Binarize into a separate plane so the luminance survives for exposure control.
+	image = binaryPlane;
 
-	imaqAutoThreshold2(image, image, 2, IMAQ_THRESH_INTERCLASS, NULL);
+	if (fixedThreshold >= 0)
+		imaqThreshold(image, lumPlane, (float)fixedThreshold, 255.0f, TRUE, 1.0f);
+	else
+		imaqAutoThreshold2(image, lumPlane, 2, IMAQ_THRESH_INTERCLASS, NULL);
 	imaqParticleFilter3(image, image, particleCriteria_initial, 1, particleFilterOptions, NULL, &numParticles);
 	imaqFillHoles(image, image, TRUE);
 
@@ -61,6 +142,9 @@ void SquareFinder::GetBestTargets(HSLImage *img, vector<TargetReport> &targets,
 	imaqParticleFilter3(image, image, particleCriteria, 1, particleFilterOptions_conn8, NULL, &numParticles);
 
 	vector<TargetReport> reports;
+	ImageInfo lumInfo, binaryInfo;
+	bool haveLuminance = imaqGetImageInfo(lumPlane, &lumInfo) != 0;
+	bool haveBinary = imaqGetImageInfo(image, &binaryInfo) != 0;
 	
 	ofstream STREAM;
 	
@@ -102,8 +186,38 @@ void SquareFinder::GetBestTargets(HSLImage *img, vector<TargetReport> &targets,
 					report.normalizedWidth = (w / width);
 					report.normalizedHeight = (h / height);
 					report.distance = MagicConstantY / h; //In feet.
+					report.rectangularity = area / (w * h);
+					report.occluded = false;
+					if (haveLuminance)
+						ScoreReport(report, lumInfo);
+					else
+						report.confidence = report.aspectError = report.edgeSharpness = 0.0;
 					reports.push_back(report);
 				}
+				else if((w*h) > 125 && haveBinary && haveLuminance) {
+					// Not solid enough to be a whole rectangle: something may be
+					// covering part of it. Try to rebuild it from its edges.
+					FittedRectangle fit;
+					if(fitter.Fit((const unsigned char*)binaryInfo.imageStart, binaryInfo.pixelsPerLine, binaryInfo.xRes, binaryInfo.yRes,
+							(int)x, (int)y, (int)w, (int)h, fit) && fit.width > fit.height) {
+						report.height = fit.height;
+						report.width = fit.width;
+						report.size = area;
+						report.x = fit.left;
+						report.y = fit.top;
+						report.centerX = fit.centerX;
+						report.centerY = fit.centerY;
+						report.normalizedX = (-1.0+2.0*(fit.centerX/width));
+						report.normalizedY = (-1.0+2.0*(fit.centerY/height));
+						report.normalizedWidth = (fit.width / width);
+						report.normalizedHeight = (fit.height / height);
+						report.distance = MagicConstantY / fit.height;
+						report.rectangularity = fit.edgeSupport;
+						report.occluded = true;
+						ScoreReport(report, lumInfo);
+						reports.push_back(report);
+					}
+				}
 			}
 		}
 	}
@@ -113,6 +227,7 @@ void SquareFinder::GetBestTargets(HSLImage *img, vector<TargetReport> &targets,
 		STREAM.close();
 	}
 	
+	// Keep the four most trustworthy rectangles.
 	sort(reports.begin(),reports.end());
 	if (reports.size() > 4)
 	{
@@ -2,6 +2,7 @@
 #define SQUAREFINDER_H
 
 #include "vision.h"
+#include "RectangleFitter.h"
 
 class SquareFinder : public VisionSpecifics
 {
@@ -10,6 +11,8 @@ public:
 	~SquareFinder();
 	
 	void GetBestTargets(HSLImage *img, vector<TargetReport> &targets, int &count);
+	Image* GetLuminancePlane() { return lumPlane; }
+	void SetFixedThreshold(int threshold) { fixedThreshold = threshold; }
 	
 	void reservePrimaryLines();
 	void reserveSecondaryLines();
@@ -19,6 +22,9 @@ private:
 	DisplayWriter secondaryDisplay;
 
 	Image* lumPlane;
+	Image* binaryPlane;
+	int fixedThreshold;
+	RectangleFitter fitter;
 };
 
 #endif
@@ -0,0 +1,275 @@
+#ifndef STATEMACHINE_H
+#define STATEMACHINE_H
+
+#include <cstring>
+#include <WPILib.h>
+#include "Logger.h"
+#include "Singleton.h"
+
+/**
+ * A state machine described by tables.
+ *
+ * Each state has an entry action, an update run while nothing moves the
+ * machine on, an exit action and a timeout. Transitions are rows of (from,
+ * guard, to, action), checked in order; the first whose guard passes is
+ * taken. A row back to its own state just runs its action, without leaving.
+ * Others can ask for a state with Request(), which Run() then moves to.
+ *
+ * Every change of state goes into a trace with its time, and the time spent
+ * in each state is added up as it is left, so both can be read afterwards
+ * for the cost of a few stores per change.
+ *
+ * Guards that send the machine round a loop would keep Run() going for
+ * ever, so it stops after MAX_CHANGES changes and logs the loop from the
+ * trace. The next Run() carries on from there.
+ *
+ * Not locked: only the owning task should call Run() or Request(). Other
+ * tasks may read the state and the trace, which are only ever a change out
+ * of date.
+ */
+template <typename State, unsigned STATES>
+class StateMachine
+{
+public:
+	typedef void (*Action)();
+	typedef bool (*Guard)();
+	typedef void (*Listener)(State from, State to);
+
+	static const unsigned TRACE_SIZE = 64;
+	// Each state can be passed through twice in one Run().
+	static const unsigned MAX_CHANGES = 2 * STATES;
+
+	struct StateSpec
+	{
+		const char* name;
+		Action enter;
+		Action update;
+		Action exit;
+		double timeout;			// seconds after entry, or 0 for none
+		State timeoutState;
+		Action timeoutAction;	// run before leaving on a timeout
+	};
+
+	struct Transition
+	{
+		State from;
+		Guard guard;
+		State to;
+		Action action;			// run before leaving, or NULL
+	};
+
+	struct TraceEntry
+	{
+		double time;
+		State from;
+		State to;
+		bool timedOut;
+	};
+
+	/**
+	 * \param states one spec for each state, in the order of State.
+	 * \param transitions the transition rows, checked in order.
+	 * \param initial the state to start in. Its entry action is not run.
+	 * \param listener called on every change, after the old state's exit
+	 * action and before the new state's entry action, or NULL.
+	 */
+	StateMachine(const StateSpec* states, const Transition* transitions, unsigned transitionCount, State initial,
+			Listener listener = NULL) :
+			states(states),
+			transitions(transitions),
+			transitionCount(transitionCount),
+			listener(listener),
+			state(initial),
+			target(initial),
+			enteredAt(-1.0),
+			deadline(-1.0),
+			timedOut(false),
+			cycling(false),
+			traceCount(0)
+	{
+		for (unsigned i = 0; i < STATES; i++)
+			timeIn[i] = 0.0;
+	}
+
+	/**
+	 * Move to a state at the next Run(). Asking for the current state does
+	 * nothing.
+	 */
+	void Request(State state) { target = state; }
+
+	/**
+	 * Take any timeout and requested change, then keep checking the
+	 * transitions until the state settles, and run its update.
+	 */
+	void Run()
+	{
+		double now = Timer::GetFPGATimestamp();
+		if (enteredAt < 0.0)
+			enteredAt = now;
+		if (deadline >= 0.0 && now >= deadline && target == state)
+		{
+			const StateSpec& spec = states[state];
+			deadline = -1.0;
+			if (spec.timeoutAction != NULL)
+				spec.timeoutAction();
+			target = spec.timeoutState;
+			timedOut = true;
+		}
+
+		// Entering one state can find the sensors already calling for the
+		// next, so go round until nothing fires.
+		unsigned changes = 0;
+		while (true)
+		{
+			if (target != state)
+			{
+				if (changes == MAX_CHANGES)
+				{
+					LogCycle(changes);
+					return;
+				}
+				Change(target);
+				changes++;
+			}
+			if (!CheckTransitions())
+				break;
+		}
+		cycling = false;
+		if (states[state].update != NULL)
+			states[state].update();
+	}
+
+	State GetState() const { return state; }
+	/// \return the state being moved to, or the current one.
+	State GetTarget() const { return target; }
+	bool IsChanging() const { return target != state; }
+	const char* GetName(State s) const { return states[s].name; }
+
+	/**
+	 * \return the time until the current state times out (in seconds), or
+	 * a negative number if it has no timeout.
+	 */
+	double GetTimeToTimeout() const
+	{
+		if (deadline < 0.0)
+			return -1.0;
+		double remaining = deadline - Timer::GetFPGATimestamp();
+		return remaining > 0.0 ? remaining : 0.0;
+	}
+
+	/**
+	 * \return the total time spent in a state (in seconds), including the
+	 * current visit.
+	 */
+	double GetTimeIn(State s) const
+	{
+		double total = timeIn[s];
+		if (s == state && enteredAt >= 0.0)
+			total += Timer::GetFPGATimestamp() - enteredAt;
+		return total;
+	}
+
+	/**
+	 * Copy out the most recent changes of state.
+	 *
+	 * \param trace filled with the changes, oldest first.
+	 * \param size the room in trace.
+	 * \return the number of changes copied.
+	 */
+	unsigned GetTrace(TraceEntry* trace, unsigned size) const
+	{
+		unsigned count = traceCount < TRACE_SIZE ? traceCount : TRACE_SIZE;
+		if (count > size)
+			count = size;
+		for (unsigned i = 0; i < count; i++)
+			trace[i] = this->trace[(traceCount - count + i) % TRACE_SIZE];
+		return count;
+	}
+
+	/// \return the number of changes of state since starting.
+	unsigned GetChangeCount() const { return traceCount; }
+
+private:
+	// Once per cycle, not on every Run() it keeps going round.
+	void LogCycle(unsigned changes)
+	{
+		if (cycling)
+			return;
+		cycling = true;
+		char path[160] = "";
+		TraceEntry recent[MAX_CHANGES];
+		unsigned count = GetTrace(recent, changes);
+		for (unsigned i = 0; i < count; i++)
+		{
+			const char* name = states[recent[i].from].name;
+			if (strlen(path) + strlen(name) + 4 >= sizeof(path))
+				break;
+			strcat(path, name);
+			strcat(path, " > ");
+		}
+		Singleton<Logger>::GetInstance().Logf("StateMachine: transitions go round in a loop, stopped after %u changes: %s%s",
+				changes, path, states[state].name);
+	}
+
+	bool CheckTransitions()
+	{
+		for (unsigned i = 0; i < transitionCount; i++)
+		{
+			const Transition& row = transitions[i];
+			if (row.from != state || !row.guard())
+				continue;
+			if (row.action != NULL)
+				row.action();
+			if (row.to != state)
+				target = row.to;
+			return target != state;
+		}
+		return target != state;
+	}
+
+	void Change(State to)
+	{
+		State from = state;
+		if (states[from].exit != NULL)
+			states[from].exit();
+
+		double now = Timer::GetFPGATimestamp();
+		timeIn[from] += now - enteredAt;
+		TraceEntry& entry = trace[traceCount % TRACE_SIZE];
+		entry.time = now;
+		entry.from = from;
+		entry.to = to;
+		entry.timedOut = timedOut;
+		traceCount++;
+		timedOut = false;
+
+		state = to;
+		enteredAt = now;
+		deadline = states[to].timeout > 0.0 ? now + states[to].timeout : -1.0;
+		if (listener != NULL)
+			listener(from, to);
+		if (states[to].enter != NULL)
+			states[to].enter();
+	}
+
+	const StateSpec* states;
+	const Transition* transitions;
+	unsigned transitionCount;
+	Listener listener;
+	State volatile state;
+	State volatile target;
+	double enteredAt;
+	double deadline;
+	bool timedOut;
+	bool cycling;
+	double timeIn[STATES];
+	TraceEntry trace[TRACE_SIZE];
+	unsigned volatile traceCount;
+};
+
+template <typename State, unsigned STATES>
+const unsigned StateMachine<State, STATES>::TRACE_SIZE;
+template <typename State, unsigned STATES>
+const unsigned StateMachine<State, STATES>::MAX_CHANGES;
+
+#endif // STATEMACHINE_H
@@ -0,0 +1,120 @@
+#include <cmath>
+#include "TimerWheel.h"
+
+TimerWheel::TimerWheel(double tick) :
+		tick(tick)
+{
+	currentTick = GetTick();
+	for (unsigned i = 0; i < SLOTS; i++)
+		slots[i] = NONE;
+	for (unsigned i = 0; i < MAX_TIMERS; i++)
+	{
+		next[i] = NONE;
+		previous[i] = NONE;
+		expiryTick[i] = 0;
+		scheduled[i] = false;
+	}
+}
+
+UINT32 TimerWheel::GetTick() const
+{
+	return (UINT32)(Timer::GetFPGATimestamp() / tick);
+}
+
+void TimerWheel::Schedule(unsigned id, double delay)
+{
+	if (id >= MAX_TIMERS)
+		return;
+	if (scheduled[id])
+		Unlink(id);
+
+	UINT32 ticks = (UINT32)ceil(delay / tick);
+	if (ticks < 1)
+		ticks = 1;
+	expiryTick[id] = GetTick() + ticks;
+
+	unsigned slot = expiryTick[id] % SLOTS;
+	previous[id] = NONE;
+	next[id] = slots[slot];
+	if (slots[slot] != NONE)
+		previous[slots[slot]] = id;
+	slots[slot] = id;
+	scheduled[id] = true;
+}
+
+void TimerWheel::Cancel(unsigned id)
+{
+	if (id < MAX_TIMERS && scheduled[id])
+		Unlink(id);
+}
+
+bool TimerWheel::IsScheduled(unsigned id) const
+{
+	return id < MAX_TIMERS && scheduled[id];
+}
+
+double TimerWheel::GetTimeLeft(unsigned id) const
+{
+	if (!IsScheduled(id))
+		return -1.0;
+	double remaining = expiryTick[id] * tick - Timer::GetFPGATimestamp();
+	return remaining > 0.0 ? remaining : 0.0;
+}
+
+void TimerWheel::Unlink(unsigned id)
+{
+	if (previous[id] != NONE)
+		next[previous[id]] = next[id];
+	else
+		slots[expiryTick[id] % SLOTS] = next[id];
+	if (next[id] != NONE)
+		previous[next[id]] = previous[id];
+	next[id] = NONE;
+	previous[id] = NONE;
+	scheduled[id] = false;
+}
+
+unsigned TimerWheel::Expire(unsigned* expired, unsigned size)
+{
+	UINT32 now = GetTick();
+	unsigned count = 0;
+	// currentTick is the last tick whose slot has been fully emptied.
+	while ((INT32)(now - currentTick) > 0)
+	{
+		UINT32 nextTick = currentTick + 1;
+		unsigned id = slots[nextTick % SLOTS];
+		while (id != NONE)
+		{
+			unsigned following = next[id];
+			// Timers more than a turn out stay for their later turn.
+			if ((INT32)(expiryTick[id] - nextTick) <= 0)
+			{
+				if (count == size)
+					return count;
+				Unlink(id);
+				expired[count++] = id;
+			}
+			id = following;
+		}
+		currentTick = nextTick;
+	}
+	return count;
+}
+
+double TimerWheel::GetTimeToNext() const
+{
+	bool any = false;
+	UINT32 soonest = 0;
+	for (unsigned i = 0; i < MAX_TIMERS; i++)
+	{
+		if (scheduled[i] && (!any || (INT32)(expiryTick[i] - soonest) < 0))
+		{
+			soonest = expiryTick[i];
+			any = true;
+		}
+	}
+	if (!any)
+		return -1.0;
+	double remaining = soonest * tick - Timer::GetFPGATimestamp();
+	return remaining > 0.0 ? remaining : 0.0;
+}
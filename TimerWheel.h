@@ -0,0 +1,72 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <WPILib.h>
+
+/**
+ * A hashed timing wheel for a task's timeouts.
+ *
+ * Time is cut into ticks and each timer hangs off the slot for the tick it
+ * expires on, so scheduling, cancelling and expiring are all constant time
+ * and nothing is allocated. Timers further out than one turn of the wheel
+ * wait out the extra turns in their slot. Timers are named by small
+ * integers chosen by the owner; scheduling one again moves it.
+ *
+ * Not locked: only the owning task should touch it.
+ */
+class TimerWheel
+{
+public:
+	static const unsigned MAX_TIMERS = 16;
+
+	/**
+	 * \param tick the wheel's resolution (in seconds).
+	 */
+	explicit TimerWheel(double tick);
+
+	/**
+	 * \param id which timer, below MAX_TIMERS.
+	 * \param delay how long from now it expires (in seconds).
+	 */
+	void Schedule(unsigned id, double delay);
+	void Cancel(unsigned id);
+	bool IsScheduled(unsigned id) const;
+
+	/**
+	 * \return the time until a timer expires (in seconds), or a negative
+	 * number if it is not scheduled.
+	 */
+	double GetTimeLeft(unsigned id) const;
+
+	/**
+	 * Turn the wheel up to now and collect the timers that have expired.
+	 *
+	 * \param expired filled with the ids of the expired timers.
+	 * \param size the room in expired; any more wait for the next call.
+	 * \return the number of ids in expired.
+	 */
+	unsigned Expire(unsigned* expired, unsigned size);
+
+	/**
+	 * \return the time until the next timer expires (in seconds), or a
+	 * negative number if none is scheduled.
+	 */
+	double GetTimeToNext() const;
+
+private:
+	static const unsigned SLOTS = 64;
+	static const unsigned NONE = 0xFFFFFFFF;
+
+	UINT32 GetTick() const;
+	void Unlink(unsigned id);
+
+	double tick;
+	UINT32 currentTick;
+	unsigned slots[SLOTS];
+	unsigned next[MAX_TIMERS];
+	unsigned previous[MAX_TIMERS];
+	UINT32 expiryTick[MAX_TIMERS];
+	bool scheduled[MAX_TIMERS];
+};
+
+#endif // TIMERWHEEL_H
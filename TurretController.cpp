@@ -0,0 +1,134 @@
+#include <cmath>
+#include "Constants.h"
+#include "TurretController.h"
+
+static const double LOOP_PERIOD = 0.01;
+static const double TRAVEL_LIMIT = 90.0;		// degrees either side of straight ahead
+static const double MAX_VELOCITY = 120.0;		// deg/s
+static const double MAX_ACCELERATION = 400.0;	// deg/s^2
+// Holding, leave the turret alone this close rather than hunt a count
+// either way.
+static const double HOLD_DEADBAND = TURRET_DEGREES_PER_COUNT;
+// Loops on the same count before the turret is taken to have stopped.
+static const unsigned SETTLE_LOOPS = 5;
+
+// Output per deg/s of profile velocity, to overcome friction while moving,
+// and per degree behind the profile.
+static const double KV = 0.005; ///\todo characterize the turret
+static const double KS = 0.08;
+static const double KP = 0.03;
+
+TurretController::TurretController(SpeedController& motor, Encoder& encoder, bool reversed) :
+		motor(motor),
+		encoder(encoder),
+		direction(reversed ? -1.0 : 1.0),
+		enabled(false),
+		settled(true),
+		setpoint(0.0),
+		profilePosition(0.0),
+		profileVelocity(0.0),
+		lastAngle(0.0),
+		stillLoops(0)
+{
+	lock = semMCreate(SEM_Q_PRIORITY | SEM_DELETE_SAFE | SEM_INVERSION_SAFE);
+	loop = new Notifier(CallUpdate, this);
+	loop->StartPeriodic(LOOP_PERIOD);
+}
+
+TurretController::~TurretController()
+{
+	loop->Stop();
+	delete loop;
+	semDelete(lock);
+}
+
+double TurretController::GetAngle()
+{
+	return encoder.GetDistance();
+}
+
+void TurretController::SetAngle(double degrees)
+{
+	Synchronized sync(lock);
+	if (degrees > TRAVEL_LIMIT)
+		degrees = TRAVEL_LIMIT;
+	if (degrees < -TRAVEL_LIMIT)
+		degrees = -TRAVEL_LIMIT;
+
+	// Starting from rest, plan from where the turret actually is.
+	if (!enabled)
+	{
+		profilePosition = GetAngle();
+		profileVelocity = 0.0;
+	}
+	setpoint = degrees;
+	settled = false;
+	enabled = true;
+}
+
+void TurretController::Disable()
+{
+	Synchronized sync(lock);
+	enabled = false;
+	settled = true;
+	motor.Set(0.0);
+}
+
+void TurretController::CallUpdate(void* controller)
+{
+	((TurretController*)controller)->Update();
+}
+
+void TurretController::Update()
+{
+	Synchronized sync(lock);
+	if (!enabled)
+		return;
+
+	// Online trapezoid: the fastest speed from which the turret can still
+	// stop at the setpoint, capped at the cruise speed, reached without
+	// exceeding the acceleration limit.
+	double remaining = setpoint - profilePosition;
+	double wanted = sqrt(2.0 * MAX_ACCELERATION * fabs(remaining));
+	if (wanted > MAX_VELOCITY)
+		wanted = MAX_VELOCITY;
+	if (remaining < 0.0)
+		wanted = -wanted;
+
+	double step = MAX_ACCELERATION * LOOP_PERIOD;
+	if (wanted > profileVelocity + step)
+		profileVelocity += step;
+	else if (wanted < profileVelocity - step)
+		profileVelocity -= step;
+	else
+		profileVelocity = wanted;
+
+	profilePosition += profileVelocity * LOOP_PERIOD;
+	// Snap onto the setpoint rather than dither around it.
+	if (fabs(setpoint - profilePosition) < step * LOOP_PERIOD)
+	{
+		profilePosition = setpoint;
+		profileVelocity = 0.0;
+	}
+
+	double angle = GetAngle();
+	double error = profilePosition - angle;
+	double output = KP * error;
+	if (profileVelocity != 0.0)
+		output += KV * profileVelocity + (profileVelocity > 0.0 ? KS : -KS);
+	else if (fabs(error) > HOLD_DEADBAND)
+		output += error > 0.0 ? KS : -KS;
+	if (output > 1.0)
+		output = 1.0;
+	if (output < -1.0)
+		output = -1.0;
+
+	// Never drive past the ends of travel.
+	if ((angle >= TRAVEL_LIMIT && output > 0.0) || (angle <= -TRAVEL_LIMIT && output < 0.0))
+		output = 0.0;
+	motor.Set(direction * output);
+
+	stillLoops = (angle == lastAngle) ? stillLoops + 1 : 0;
+	lastAngle = angle;
+	settled = (profilePosition == setpoint) && fabs(setpoint - angle) < TURRET_SETTLED_ERROR && stillLoops >= SETTLE_LOOPS;
+}
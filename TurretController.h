@@ -0,0 +1,67 @@
+#ifndef TURRETCONTROLLER_H
+#define TURRETCONTROLLER_H
+
+#include <WPILib.h>
+
+/**
+ * Moves the turret to an absolute angle along a trapezoidal profile:
+ * accelerate, cruise, decelerate, then hold. The motor follows the
+ * profile's velocity as feedforward, with a proportional correction on
+ * the position error. Holding, the static friction term comes back in
+ * whenever the turret is more than a count off, since the proportional
+ * term alone cannot move it that little. Runs on its own notifier.
+ */
+class TurretController
+{
+public:
+	/**
+	 * \param motor the turret motor.
+	 * \param encoder the turret encoder, scaled to degrees.
+	 * \param reversed true if a negative motor output turns toward positive angles.
+	 */
+	TurretController(SpeedController& motor, Encoder& encoder, bool reversed);
+	~TurretController();
+
+	/**
+	 * Start moving to an angle, clamped to the turret's travel. A new angle
+	 * mid-move is picked up from the current profile state.
+	 *
+	 * \param degrees the turret angle (in degrees, 0 straight ahead).
+	 */
+	void SetAngle(double degrees);
+
+	/**
+	 * Stop driving the turret and leave it where it is.
+	 */
+	void Disable();
+
+	bool IsEnabled() const { return enabled; }
+	double GetAngle();
+	double GetSetpoint() const { return setpoint; }
+
+	/**
+	 * \return true while the profile has not reached the setpoint or the
+	 * turret is still settling onto it: off by more than
+	 * TURRET_SETTLED_ERROR, or still changing count.
+	 */
+	bool IsMoving() const { return enabled && !settled; }
+
+private:
+	static void CallUpdate(void* controller);
+	void Update();
+
+	SpeedController& motor;
+	Encoder& encoder;
+	double direction;
+	Notifier* loop;
+	SEM_ID lock;
+	bool enabled;
+	bool settled;
+	double setpoint;
+	double profilePosition;
+	double profileVelocity;
+	double lastAngle;
+	unsigned stillLoops;
+};
+
+#endif // TURRETCONTROLLER_H
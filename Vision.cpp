@@ -6,15 +6,26 @@
 
 #include "Constants.h"
 #include "DisplayWriter.h"
+#include "ExposureControl.h"
+#include "MjpegClient.h"
 #include "Singleton.h"
 #include "Vision.h"
 #include <fstream>
 
+// Decodes a JPEG held in memory into an IMAQ image (from the NI Vision runtime).
+extern "C" int Priv_ReadJPEGString_C(Image* image, const unsigned char* string, UINT32 stringLength);
+
 bool Vision::enabled = true;
-AxisCamera *Vision::cam= NULL;
+MjpegClient *Vision::camera = NULL;
+ExposureControl *Vision::exposure = NULL;
 VisionSpecifics *Vision::engine= NULL;
 int Vision::bestTargetCount = 0;
 vector<TargetReport> Vision::bestTargets = vector<TargetReport>();
+double Vision::bestFrameTime = 0.0;
+SEM_ID Vision::targetLock = semMCreate(SEM_Q_PRIORITY | SEM_INVERSION_SAFE | SEM_DELETE_SAFE);
+
+// Basket hypotheses scoring below this are reported as no target at all.
+static const double MIN_TARGET_CONFIDENCE = 0.2;
 
 void Vision::reservePrimaryLines() { primaryDisplay.Reserve(1); }
 void Vision::reserveSecondaryLines() { secondaryDisplay.Reserve(5); }
@@ -35,43 +46,82 @@ static double GetDistanceFromHeight(double realHeight, double imageHeight)
 Vision::Vision(VisionSpecifics *backend)
 {
 	engine = backend;
-	cam = &AxisCamera::GetInstance("10.25.2.11");
-	cam->WriteResolution(AxisCamera::kResolution_320x240);
+	camera = new MjpegClient(CAMERA_ADDRESS, CAMERA_PORT, CAMERA_FPS);
+	exposure = new ExposureControl(camera);
 	visionTask = new Task("2502Vn",(FUNCPTR)loop);
 }
 
 Vision::~Vision()
 {
-	delete engine;
 	visionTask->Stop();
 	delete visionTask;
+	delete exposure;
+	delete camera;
+	delete engine;
 }
 
 void Vision::start()
 {
+	camera->Start();
 	visionTask->Start();
 }
 
 void Vision::stop()
 {
 	visionTask->Stop();
+	camera->Stop();
 }
 
 void Vision::loop()
 {
+	// The decoded image is reused from frame to frame; the JPEG itself is
+	// decoded straight out of the camera client's ring.
+	HSLImage* cap = new HSLImage;
+	MjpegFrame frame;
+	vector<TargetReport> found;
+	int foundCount;
 	while (true)
 	{
-		HSLImage* cap = new HSLImage;
-		if(enabled) {
-			cam->GetImage(cap);
-			engine->GetBestTargets(cap, bestTargets, bestTargetCount);
-			VISION.primaryDisplay.PrintfLine(0, "Vis #:%d Dist:%f H:%f", bestTargetCount, bestTargets[0].distance, bestTargets[0].height);
+		if(!enabled) {
+			Wait(0.01);
+			continue;
 		}
-		delete cap;
-		Wait(0.01);
+		if(!camera->AcquireLatest(frame, 0.5))
+			continue;
+		int decoded = Priv_ReadJPEGString_C(cap->GetImaqImage(), frame.data, frame.size);
+		camera->Release(frame);
+		if(!decoded)
+			continue;
+
+		engine->GetBestTargets(cap, found, foundCount);
+		{
+			Synchronized sync(targetLock);
+			bestTargets = found;
+			bestTargetCount = foundCount;
+			bestFrameTime = frame.timestamp;
+		}
+
+		// Keep the targets saturated and the background dark so the next
+		// frame can be binarized with one compare per pixel.
+		exposure->Update(engine->GetLuminancePlane(), found, foundCount);
+		engine->SetFixedThreshold(exposure->GetThreshold());
+		VISION.secondaryDisplay.PrintfLine(4, "Exp:%d Br:%d Th:%d", exposure->GetExposure(), exposure->GetBrightness(), exposure->GetThreshold());
+
+		if(foundCount > 0)
+			VISION.primaryDisplay.PrintfLine(0, "Vis #:%d Dist:%.1f C:%.2f", foundCount, found[0].distance, found[0].confidence);
+		else
+			VISION.primaryDisplay.PrintfLine(0, "Vis #:0 (frame %u)", frame.sequence);
 	}
 }
 
+TargetReport Vision::GetBestTarget() const
+{
+	Synchronized sync(targetLock);
+	if (bestTargetCount == 0)
+		return TargetReport();
+	return bestTargets[0];
+}
+
 bool Vision::isHorizontallyAligned(TargetReport &targets1, TargetReport &targets2)
 {
 	return (fabs(targets1.centerX - targets2.centerX) <= (targets1.width + targets2.width) / 2 * 0.4);
@@ -354,72 +404,109 @@ void Vision::GetTargetCase(vector <TargetReport> &targets, int numtargets, int&
 }
 
 void Vision::FindTarget(double& offset, double& distance)
+{
+	double confidence;
+	FindTarget(offset, distance, confidence);
+}
+
+void Vision::ConsiderHypothesis(double offset, double distance, double confidence, double& bestOffset, double& bestDistance, double& bestConfidence)
+{
+	if (confidence > bestConfidence)
+	{
+		bestOffset = offset;
+		bestDistance = distance;
+		bestConfidence = confidence;
+	}
+}
+
+void Vision::FindTarget(double& offset, double& distance, double& confidence)
+{
+	double frameTime;
+	FindTarget(offset, distance, confidence, frameTime);
+}
+
+void Vision::FindTarget(double& offset, double& distance, double& confidence, double& frameTime)
 {
 	distance = 0.0;
 	offset = 0.0;
+	confidence = 0.0;
 
-	TargetReport tmp = GetBestTarget();
-	if (tmp.normalizedY > 0.0)
+	// Work on a snapshot; the vision task replaces the list every frame.
+	vector<TargetReport> targets;
+	int targetCount;
 	{
-		distance = tmp.distance;
-		offset = tmp.normalizedX;
+		Synchronized sync(targetLock);
+		targets = bestTargets;
+		targetCount = bestTargetCount;
+		frameTime = bestFrameTime;
 	}
 
-	if (bestTargetCount == 0)
+	if (targetCount == 0)
 		return;
 	int targetCase[4] = { -1, -1, -1, -1 };
-	GetTargetCase(bestTargets, bestTargetCount, targetCase[TOP_TARGET], targetCase[LEFT_TARGET], targetCase[RIGHT_TARGET], targetCase[BOTTOM_TARGET]);
+	GetTargetCase(targets, targetCount, targetCase[TOP_TARGET], targetCase[LEFT_TARGET], targetCase[RIGHT_TARGET], targetCase[BOTTOM_TARGET]);
 	
 	secondaryDisplay.PrintfLine(0, "Top Target: %d", targetCase[TOP_TARGET]);
 	secondaryDisplay.PrintfLine(1, "Left Target: %d", targetCase[LEFT_TARGET]);
 	secondaryDisplay.PrintfLine(2, "Right Target: %d", targetCase[RIGHT_TARGET]);
 	secondaryDisplay.PrintfLine(3, "Bottom Target: %d", targetCase[BOTTOM_TARGET]);
-	// Handle target cases
 
-	if (targetCase[TOP_TARGET] >= 0 && targetCase[BOTTOM_TARGET] >= 0)
+	// Every basket the targets support is a hypothesis, scored by the
+	// confidence of the rectangles it rests on and by how well the pair
+	// constrains range. The best scoring one wins.
+	int top = targetCase[TOP_TARGET];
+	int bottom = targetCase[BOTTOM_TARGET];
+	int left = targetCase[LEFT_TARGET];
+	int right = targetCase[RIGHT_TARGET];
+	int side = (left >= 0 && (right < 0 || targets[left].confidence >= targets[right].confidence)) ? left : right;
+
+	if (top >= 0 && bottom >= 0)
 	{
 		//Top / Bottom (best case scenario)
-		offset = bestTargets[TOP_TARGET].normalizedX;
-
 		double realHeight = BASKET_TOP_ELEVATION - BASKET_BOTTOM_ELEVATION;
-		distance = GetDistanceFromHeight(realHeight, fabs(bestTargets[targetCase[BOTTOM_TARGET]].centerY - bestTargets[targetCase[TOP_TARGET]].centerY));
+		ConsiderHypothesis(targets[top].normalizedX,
+				GetDistanceFromHeight(realHeight, fabs(targets[bottom].centerY - targets[top].centerY)),
+				(targets[top].confidence + targets[bottom].confidence) / 2.0,
+				offset, distance, confidence);
 	}
-	else if (targetCase[TOP_TARGET] >= 0 && (targetCase[LEFT_TARGET] >= 0 || targetCase[RIGHT_TARGET] >= 0))
+	if (top >= 0 && side >= 0)
 	{
 		//One of the top diagonals
-		offset = bestTargets[targetCase[TOP_TARGET]].normalizedX;
-
 		double realHeight = BASKET_TOP_ELEVATION - BASKET_MIDDLE_ELEVATION;
-		if (targetCase[LEFT_TARGET] >= 0)
-		{
-			distance = GetDistanceFromHeight(realHeight, fabs(bestTargets[targetCase[LEFT_TARGET]].centerY - bestTargets[targetCase[TOP_TARGET]].centerY));
-		}
-		else if (targetCase[RIGHT_TARGET] >= 0)
-		{
-			distance = GetDistanceFromHeight(realHeight, fabs(bestTargets[targetCase[RIGHT_TARGET]].centerY - bestTargets[targetCase[TOP_TARGET]].centerY));
-		}
+		ConsiderHypothesis(targets[top].normalizedX,
+				GetDistanceFromHeight(realHeight, fabs(targets[side].centerY - targets[top].centerY)),
+				0.9 * (targets[top].confidence + targets[side].confidence) / 2.0,
+				offset, distance, confidence);
 	}
-	else if (targetCase[BOTTOM_TARGET] >= 0 && (targetCase[LEFT_TARGET] >= 0 || targetCase[RIGHT_TARGET] >= 0))
+	if (bottom >= 0 && side >= 0)
 	{
 		//One of the bottom diagonals
-		offset = bestTargets[targetCase[BOTTOM_TARGET]].normalizedX;
-
 		double realHeight = BASKET_MIDDLE_ELEVATION - BASKET_BOTTOM_ELEVATION;
-		if (targetCase[LEFT_TARGET] >= 0)
-		{
-			distance = GetDistanceFromHeight(realHeight, fabs(bestTargets[targetCase[BOTTOM_TARGET]].centerY - bestTargets[targetCase[LEFT_TARGET]].centerY));
-		}
-		else if (targetCase[RIGHT_TARGET] >= 0)
-		{
-			distance = GetDistanceFromHeight(realHeight, fabs(bestTargets[targetCase[BOTTOM_TARGET]].centerY - bestTargets[targetCase[RIGHT_TARGET]].centerY));
-		}
-
+		ConsiderHypothesis(targets[bottom].normalizedX,
+				GetDistanceFromHeight(realHeight, fabs(targets[bottom].centerY - targets[side].centerY)),
+				0.9 * (targets[bottom].confidence + targets[side].confidence) / 2.0,
+				offset, distance, confidence);
 	}
-	else if( targetCase[LEFT_TARGET] >= 0 && targetCase[RIGHT_TARGET] >= 0 )
+	if (left >= 0 && right >= 0)
 	{
 		//Both side targets
-		offset = (bestTargets[targetCase[RIGHT_TARGET]].normalizedX + bestTargets[targetCase[LEFT_TARGET]].normalizedX) / 2.0;
-		distance = (bestTargets[targetCase[LEFT_TARGET]].distance + bestTargets[targetCase[RIGHT_TARGET]].distance) / 2.0;
+		ConsiderHypothesis((targets[right].normalizedX + targets[left].normalizedX) / 2.0,
+				(targets[left].distance + targets[right].distance) / 2.0,
+				0.85 * (targets[left].confidence + targets[right].confidence) / 2.0,
+				offset, distance, confidence);
 	}
 
+	// A lone rectangle in the lower half of the image is most likely the
+	// bottom basket; its own height gives a rough range.
+	for (int i = 0; i < targetCount; i++)
+	{
+		if (isBottomTarget(targets[i]))
+			ConsiderHypothesis(targets[i].normalizedX, targets[i].distance, 0.5 * targets[i].confidence, offset, distance, confidence);
+	}
+
+	if (confidence < MIN_TARGET_CONFIDENCE)
+	{
+		offset = 0.0;
+		distance = 0.0;
+	}
 }
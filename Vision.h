@@ -5,6 +5,9 @@
 #include "DisplayWriter.h"
 #include <vector>
 
+class ExposureControl;
+class MjpegClient;
+
 struct TargetReport 
 {
 	double width;
@@ -19,8 +22,14 @@ struct TargetReport
 	double normalizedWidth;
 	double normalizedHeight;
 	double distance; //ft
+	double rectangularity; //particle area / bounding box area
+	double aspectError; //relative error from the 24"x18" target aspect ratio
+	double edgeSharpness; //mean luminance step across the box edges, [0,1]
+	double confidence; //combined quality score, [0,1]
+	bool occluded; //rebuilt from its edges because part of it was hidden
 	//bool operator<(TargetReport &rhs) {return size > rhs.size;}
-	bool operator<(TargetReport &rhs) {return normalizedY > rhs.normalizedY;}
+	//bool operator<(TargetReport &rhs) {return normalizedY > rhs.normalizedY;}
+	bool operator<(TargetReport &rhs) {return confidence > rhs.confidence;}
 };
 
 struct TargetPair
@@ -36,6 +45,19 @@ class VisionSpecifics
 public:
 	virtual ~VisionSpecifics() {}
 	virtual void GetBestTargets(HSLImage * img, vector<TargetReport> &targets, int& count) = 0;
+
+	/**
+	 * \return the luminance plane of the last processed frame, or NULL if
+	 * the backend does not keep one.
+	 */
+	virtual Image* GetLuminancePlane() { return NULL; }
+
+	/**
+	 * Binarize with a fixed threshold instead of an adaptive one.
+	 *
+	 * \param threshold the luminance threshold, or -1 for adaptive.
+	 */
+	virtual void SetFixedThreshold(int threshold) {}
 };
 
 class Vision
@@ -55,8 +77,22 @@ public:
      * \param targetLevel the height level of the target.
      */
 	void FindTarget(double& offset, double& distance);
+
+    /**
+     * Find the best target and report how much to trust it.
+     *
+     * \param confidence the combined confidence of the chosen basket hypothesis, [0,1].
+     */
+	void FindTarget(double& offset, double& distance, double& confidence);
+
+    /**
+     * Find the best target and say which frame it came from.
+     *
+     * \param frameTime the FPGA time (seconds) the frame arrived from the camera.
+     */
+	void FindTarget(double& offset, double& distance, double& confidence, double& frameTime);
     
-	TargetReport GetBestTarget() const { return bestTargets[0]; }
+	TargetReport GetBestTarget() const;
 
 	void reservePrimaryLines();
 	void reserveSecondaryLines();
@@ -72,12 +108,16 @@ private:
     bool isHorizontallyAligned(TargetReport &targets1, TargetReport &targets2);
     bool isVerticallyAligned(TargetReport &targets1, TargetReport &targets2);
     bool isBottomTarget( TargetReport &target );
+    void ConsiderHypothesis(double offset, double distance, double confidence, double& bestOffset, double& bestDistance, double& bestConfidence);
 	Task* visionTask;
 	
 	static bool enabled;
     static int bestTargetCount;
 	static vector<TargetReport> bestTargets;
-	static AxisCamera* cam;
+	static double bestFrameTime;
+	static SEM_ID targetLock;
+	static MjpegClient* camera;
+	static ExposureControl* exposure;
 	static VisionSpecifics* engine;
 };
 
@@ -0,0 +1,175 @@
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "WPILib.h"
+#include "SimClock.h"
+#include "../Logger.h"
+#include "../MjpegClient.h"
+#include "../Singleton.h"
+
+/*
+ * Camera check: stream made-up frames from tools/MjpegReplayServer through
+ * the camera client, with a consumer that keeps up, one that falls behind
+ * and one that stalls, and write a parameter while the stream is open.
+ *
+ * The server runs on real time; the simulated clock keeps pace with it
+ * while the client waits on its socket.
+ */
+
+static const unsigned PORT = 18502;
+static const unsigned FPS = 30;
+static const unsigned FRAME_FILES = 5;
+static const double FRAME_PERIOD = 1.0 / FPS;
+static const double CHECK_TIME = 2.0;			// seconds each consumer runs for
+static const double STALL_TIME = 0.5;
+static const double ACQUIRE_TIMEOUT = 1.0;
+
+static bool Check(bool condition, const char* what)
+{
+	printf("[%8.3f] %-40s %s\n", SimClock::Now(), what, condition ? "ok" : "FAILED");
+	return condition;
+}
+
+// Stand-ins for JPEGs: the start and end markers around filler of a
+// different length each, which the client never decodes.
+static bool WriteFrames(char names[][32])
+{
+	for (unsigned i = 0; i < FRAME_FILES; i++)
+	{
+		snprintf(names[i], sizeof(names[i]), "frame%u.jpg", i);
+		FILE* file = fopen(names[i], "wb");
+		if (!file)
+			return false;
+		fputc(0xFF, file);
+		fputc(0xD8, file);
+		for (unsigned j = 0; j < 2000 + 3000 * i; j++)
+			fputc(j & 0xFF, file);
+		fputc(0xFF, file);
+		fputc(0xD9, file);
+		fclose(file);
+	}
+	return true;
+}
+
+static pid_t StartServer(char names[][32])
+{
+	pid_t server = fork();
+	if (server != 0)
+		return server;
+
+	char port[16], fps[16];
+	snprintf(port, sizeof(port), "%u", PORT);
+	snprintf(fps, sizeof(fps), "%u", FPS);
+	char* args[FRAME_FILES + 4] = { (char*)"MjpegReplayServer", port, fps };
+	for (unsigned i = 0; i < FRAME_FILES; i++)
+		args[3 + i] = names[i];
+	args[FRAME_FILES + 3] = NULL;
+	freopen("/dev/null", "w", stdout);
+	execv("./MjpegReplayServer", args);
+	perror("MjpegReplayServer");
+	_exit(1);
+}
+
+// Wait in real time for the server to take connections.
+static bool WaitForServer()
+{
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(PORT);
+	address.sin_addr.s_addr = inet_addr("127.0.0.1");
+	for (unsigned tries = 0; tries < 200; tries++)
+	{
+		int sock = socket(AF_INET, SOCK_STREAM, 0);
+		bool connected = connect(sock, (struct sockaddr*)&address, sizeof(address)) == 0;
+		close(sock);
+		if (connected)
+			return true;
+		usleep(10000);
+	}
+	return false;
+}
+
+static bool IsIntact(const MjpegFrame& frame)
+{
+	return frame.size >= 4 && frame.data[0] == 0xFF && frame.data[1] == 0xD8
+			&& frame.data[frame.size - 2] == 0xFF && frame.data[frame.size - 1] == 0xD9;
+}
+
+/**
+ * Take frames for a while, spending work seconds on each.
+ *
+ * \return true if every frame came whole and newer than the last.
+ */
+static bool Consume(MjpegClient& camera, double work)
+{
+	double end = SimClock::Now() + CHECK_TIME;
+	unsigned last = 0;
+	bool good = true;
+	while (SimClock::Now() < end)
+	{
+		MjpegFrame frame;
+		if (!camera.AcquireLatest(frame, ACQUIRE_TIMEOUT))
+			return false;
+		good &= IsIntact(frame) && frame.sequence > last;
+		last = frame.sequence;
+		Wait(work);
+		camera.Release(frame);
+	}
+	return good;
+}
+
+int main(int argc, char** argv)
+{
+	bool passed = true;
+	Singleton<Logger>::SetInstance(new Logger("camera.log"));
+
+	char names[FRAME_FILES][32];
+	if (!WriteFrames(names))
+	{
+		fprintf(stderr, "cannot write the frames\n");
+		return 1;
+	}
+	pid_t server = StartServer(names);
+	if (server < 0 || !WaitForServer())
+	{
+		fprintf(stderr, "replay server did not start\n");
+		return 1;
+	}
+
+	MjpegClient camera("127.0.0.1", PORT, FPS);
+	camera.Start();
+
+	passed &= Check(Consume(camera, FRAME_PERIOD / 3.0) && camera.GetFramesDropped() == 0,
+			"frames taken while keeping up");
+
+	// Frames skipped over while the consumer is busy were never going to be
+	// asked for, so filling their slots again drops nothing.
+	passed &= Check(Consume(camera, 1.5 * FRAME_PERIOD) && camera.GetFramesDropped() == 0,
+			"frames skipped while falling behind");
+
+	Wait(STALL_TIME);
+	MjpegFrame frame;
+	bool acquired = camera.AcquireLatest(frame, ACQUIRE_TIMEOUT);
+	passed &= Check(acquired && IsIntact(frame) && SimClock::Now() - frame.timestamp < 2.0 * FRAME_PERIOD
+			&& camera.GetFramesDropped() > 0, "newest frame taken after a stall");
+	if (acquired)
+		camera.Release(frame);
+
+	passed &= Check(camera.WriteParameter("ImageSource.I0.Sensor.ExposureValue", "50"),
+			"parameter written during the stream");
+	passed &= Check(camera.GetReconnects() == 0, "stream stayed connected");
+	printf("[%8.3f] %u frames received, %u dropped\n", SimClock::Now(),
+			camera.GetFramesReceived(), camera.GetFramesDropped());
+
+	camera.Stop();
+	kill(server, SIGTERM);
+	waitpid(server, NULL, 0);
+	fflush(stdout);
+	return passed ? 0 : 1;
+}
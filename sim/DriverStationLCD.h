@@ -0,0 +1,34 @@
+#ifndef SIM_DRIVERSTATIONLCD_H
+#define SIM_DRIVERSTATIONLCD_H
+
+#include "VxWorks.h"
+
+/**
+ * The driver station's user LCD. Lines are kept in memory; set echo to
+ * print each update to stdout.
+ */
+class DriverStationLCD
+{
+public:
+	static const UINT32 kLineLength = 21;
+	static const UINT32 kNumLines = 6;
+
+	enum Line { kMain_Line6 = 0, kUser_Line1 = 0, kUser_Line2, kUser_Line3, kUser_Line4, kUser_Line5, kUser_Line6 };
+
+	static DriverStationLCD* GetInstance();
+
+	void UpdateLCD();
+	void Printf(Line line, INT32 startingColumn, const char* format, ...);
+	void PrintfLine(Line line, const char* format, ...);
+	void Clear();
+	const char* GetLine(Line line) const { return lines[line]; }
+
+	static bool echo;
+
+private:
+	DriverStationLCD();
+
+	char lines[kNumLines][kLineLength + 1];
+};
+
+#endif // SIM_DRIVERSTATIONLCD_H
@@ -0,0 +1,109 @@
+#include <cmath>
+#include "FlywheelModel.h"
+#include "SimHardware.h"
+
+// CIM motor at 12 V.
+static const double BATTERY_VOLTAGE = 12.0;
+static const double MOTOR_STALL_TORQUE = 2.42;		// N m
+static const double MOTOR_STALL_CURRENT = 133.0;	// A
+static const double MOTOR_FREE_SPEED = 5310.0 * 2.0 * M_PI / 60.0;	// rad/s
+static const double MOTOR_RESISTANCE = BATTERY_VOLTAGE / MOTOR_STALL_CURRENT;
+static const double MOTOR_KT = MOTOR_STALL_TORQUE / MOTOR_STALL_CURRENT;
+static const double MOTOR_KE = BATTERY_VOLTAGE / MOTOR_FREE_SPEED;
+
+// Wheel and gearbox, which leaves a free speed of about 40 rev/s and a
+// time constant of about 0.27 s. The friction matches the feedforward the
+// robot was characterized with (0.04 + 0.024 per rev/s).
+static const double GEAR_RATIO = 2.0;				// motor turns per wheel turn
+static const double WHEEL_INERTIA = 0.005;			// kg m^2, wheel, hub and gears
+static const double WHEEL_RADIUS = 0.1016;			// m
+static const double COULOMB_FRICTION = 0.19;		// N m
+static const double VISCOUS_FRICTION = 1.09e-3;		// N m per rad/s
+static const double ENCODER_PULSES = 128.0;
+
+// Ball contact: the ball leaves at a fraction of the wheels' surface speed,
+// and squashing it and spinning it up costs a fraction of its launch energy
+// on top.
+static const double BALL_MASS = 0.31;				// kg
+static const double EXIT_EFFICIENCY = 0.6;
+static const double CONTACT_LOSS = 0.6;
+static const double CONTACT_TIME = 0.03;			// s
+
+unsigned FlywheelModel::launches = 0;
+
+FlywheelModel::FlywheelModel(UINT32 motorChannel, UINT32 encoderChannel, bool reversed) :
+		motorChannel(motorChannel),
+		encoderChannel(encoderChannel),
+		direction(reversed ? -1.0 : 1.0),
+		omega(0.0),
+		pulses(0.0),
+		ballPower(0.0),
+		contactEnds(0.0)
+{
+}
+
+double FlywheelModel::GetSpeed() const
+{
+	return omega / (2.0 * M_PI);
+}
+
+void FlywheelModel::Launch(FlywheelModel& bottom, FlywheelModel& top)
+{
+	double bottomSurface = bottom.omega * WHEEL_RADIUS;
+	double topSurface = top.omega * WHEEL_RADIUS;
+	double surface = bottomSurface + topSurface;
+	launches++;
+	if (surface <= 0.0)
+		return;
+
+	double exit = EXIT_EFFICIENCY * surface / 2.0;
+	double energy = 0.5 * BALL_MASS * exit * exit * (1.0 + CONTACT_LOSS);
+	bottom.TakeEnergy(energy * bottomSurface / surface);
+	top.TakeEnergy(energy * topSurface / surface);
+}
+
+void FlywheelModel::TakeEnergy(double joules)
+{
+	ballPower = joules / CONTACT_TIME;
+	contactEnds = SimClock::Now() + CONTACT_TIME;
+}
+
+void FlywheelModel::Step(double now, double dt)
+{
+	// A Jaguar in coast leaves the motor open between pulses, so it only
+	// drives while its voltage is above the back EMF.
+	double voltage = direction * SimHardware::GetPWM(motorChannel) * BATTERY_VOLTAGE;
+	double current = (voltage - MOTOR_KE * GEAR_RATIO * omega) / MOTOR_RESISTANCE;
+	if (voltage == 0.0 || current * voltage < 0.0)
+		current = 0.0;
+	double torque = GEAR_RATIO * MOTOR_KT * current;
+
+	if (now < contactEnds && omega > 0.0)
+		torque -= ballPower / omega;
+
+	// Friction stops the wheel but never turns it backwards.
+	double friction = COULOMB_FRICTION + VISCOUS_FRICTION * fabs(omega);
+	if (omega > 0.0)
+		torque -= friction;
+	else if (omega < 0.0)
+		torque += friction;
+	else if (fabs(torque) <= friction)
+		torque = 0.0;
+	else
+		torque -= (torque > 0.0 ? friction : -friction);
+
+	double next = omega + torque / WHEEL_INERTIA * dt;
+	if ((omega > 0.0 && next < 0.0) || (omega < 0.0 && next > 0.0))
+		next = 0.0;
+	omega = next;
+
+	// The single-channel encoder cannot see direction.
+	double rate = fabs(omega) / (2.0 * M_PI) * ENCODER_PULSES;
+	pulses += rate * dt;
+	INT32 whole = (INT32)pulses;
+	if (whole > 0)
+	{
+		SimHardware::AddCounts(encoderChannel, whole, 1.0 / rate);
+		pulses -= whole;
+	}
+}
@@ -0,0 +1,59 @@
+#ifndef FLYWHEELMODEL_H
+#define FLYWHEELMODEL_H
+
+#include "VxWorks.h"
+#include "SimClock.h"
+
+/**
+ * A shooter wheel driven by a CIM through a Jaguar, ticking its
+ * single-channel encoder.
+ *
+ * The motor torque comes from the Jaguar's voltage less the motor's back
+ * EMF, through the gearbox, against the wheel's inertia and its Coulomb and
+ * viscous friction. The Jaguars are in coast, so the motor can drive the
+ * wheel but never brakes it. A ball squeezed through the wheels takes its
+ * launch energy out of them over the contact time.
+ */
+class FlywheelModel : public SimModel
+{
+public:
+	/**
+	 * \param motorChannel the Jaguar's PWM channel.
+	 * \param encoderChannel the encoder's digital channel.
+	 * \param reversed true if a negative Jaguar command spins the wheel forward.
+	 */
+	FlywheelModel(UINT32 motorChannel, UINT32 encoderChannel, bool reversed);
+
+	/**
+	 * \return the wheel speed (in revolutions per second).
+	 */
+	double GetSpeed() const;
+
+	/**
+	 * Shoot a ball through two wheels: it leaves at a fraction of their mean
+	 * surface speed and each gives up energy in proportion to its own.
+	 */
+	static void Launch(FlywheelModel& bottom, FlywheelModel& top);
+
+	/**
+	 * \return how many balls have been launched.
+	 */
+	static unsigned GetLaunches() { return launches; }
+
+	virtual void Step(double now, double dt);
+
+private:
+	void TakeEnergy(double joules);
+
+	static unsigned launches;
+
+	UINT32 motorChannel;
+	UINT32 encoderChannel;
+	double direction;
+	double omega;				// rad/s
+	double pulses;
+	double ballPower;			// W drawn by a ball in contact
+	double contactEnds;
+};
+
+#endif // FLYWHEELMODEL_H
@@ -0,0 +1,6 @@
+#ifndef SIM_SENSORBASE_H
+#define SIM_SENSORBASE_H
+
+#include "WPILib.h"
+
+#endif // SIM_SENSORBASE_H
@@ -0,0 +1,157 @@
+#include <cmath>
+#include <cstdio>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "WPILib.h"
+#include "FlywheelModel.h"
+#include "SimClock.h"
+#include "../Constants.h"
+#include "../Logger.h"
+#include "../Shooter.h"
+#include "../Singleton.h"
+
+/*
+ * Shooter controller benchmark: spin the wheels up and shoot three balls
+ * through the flywheel model with each controller configuration, and report
+ * how long each ball waited for the wheels and how far off speed the wheels
+ * were when it went through.
+ *
+ * Each configuration runs in a child process so it starts from a fresh
+ * robot and a fresh clock.
+ */
+
+static const double SHOT_SPEED = 27.7;		// rev/s, the key
+static const unsigned BALLS = 3;
+// From the collector firing to the ball reaching the wheels.
+static const double FEED_TIME = 0.15;
+static const double READY_TIMEOUT = 3.0;
+static const double EXIT_TIMEOUT = 0.5;
+static const double POLL_PERIOD = 0.001;
+
+struct Configuration
+{
+	const char* name;
+	bool setGains;
+	double p, i, d;
+	double kS, kV;
+	bool rapidFire;
+	// Start each ball when the wheels are predicted to settle by the time
+	// it gets there, as the shot sequencer does.
+	bool predicted;
+};
+
+static const Configuration CONFIGURATIONS[] =
+{
+	{ "default",             false, 0.0,  0.0,  0.0, 0.0,  0.0,   false, false },
+	{ "default, predicted",  false, 0.0,  0.0,  0.0, 0.0,  0.0,   false, true },
+	{ "default, rapid fire", false, 0.0,  0.0,  0.0, 0.0,  0.0,   true,  false },
+	{ "feedforward only",    true,  0.0,  0.0,  0.0, 0.04, 0.024, false, false },
+	{ "stiff PID",           true,  0.05, 0.05, 0.0, 0.04, 0.024, false, false },
+	{ "PID only",            true,  0.05, 0.1,  0.0, 0.0,  0.0,   false, false },
+	// The PIDController gains before the flywheel controllers, 0.12 and
+	// 0.013; its integral summed errors every 50 ms rather than per second.
+	{ "old PID gains",       true,  0.12, 0.26, 0.0, 0.0,  0.0,   false, false },
+	{ "old gains + ff",      true,  0.12, 0.26, 0.0, 0.04, 0.024, false, false },
+};
+
+static const unsigned CONFIGURATION_COUNT = sizeof(CONFIGURATIONS) / sizeof(CONFIGURATIONS[0]);
+
+static bool IsReady(const Configuration& configuration, unsigned shot)
+{
+	if (configuration.rapidFire && shot > 0)
+		return SHOOTER.IsInTolerance();
+	if (configuration.predicted)
+	{
+		double settleTime = SHOOTER.GetSettleTime();
+		return settleTime >= 0.0 && settleTime <= FEED_TIME;
+	}
+	return SHOOTER.IsAtSpeed();
+}
+
+static void Run(const Configuration& configuration, unsigned index)
+{
+	char logName[32];
+	sprintf(logName, "benchmark-%u.log", index);
+	Singleton<Logger>::SetInstance(new Logger(logName));
+	FlywheelModel topWheel(SHOOTER_TOP_JAG_CHANNEL, SHOOTER_TOP_ENCODER_A, true);
+	FlywheelModel bottomWheel(SHOOTER_BOTTOM_JAG_CHANNEL, SHOOTER_BOTTOM_ENCODER_A, true);
+	SimClock::AddModel(&topWheel);
+	SimClock::AddModel(&bottomWheel);
+
+	Singleton<Shooter>::SetInstance(new Shooter());
+	if (configuration.setGains)
+	{
+		SHOOTER.SetPID(configuration.p, configuration.i, configuration.d);
+		SHOOTER.SetFeedforward(configuration.kS, configuration.kV);
+	}
+
+	double readyTimes[BALLS];
+	double errors[BALLS];
+	double squaredError = 0.0;
+	double start = SimClock::Now();
+	double since = start;
+	SHOOTER.SetSpeed(SHOT_SPEED);
+	unsigned shot;
+	for (shot = 0; shot < BALLS; shot++)
+	{
+		while (!IsReady(configuration, shot) && SimClock::Now() - since < READY_TIMEOUT)
+			SimClock::RunUntil(SimClock::Now() + POLL_PERIOD);
+		if (SimClock::Now() - since >= READY_TIMEOUT)
+			break;
+		readyTimes[shot] = SimClock::Now() - since;
+
+		SimClock::RunUntil(SimClock::Now() + FEED_TIME);
+		errors[shot] = bottomWheel.GetSpeed() - SHOT_SPEED;
+		double topError = topWheel.GetSpeed() - SHOOTER.GetTopRatio() * SHOT_SPEED;
+		squaredError += errors[shot] * errors[shot] + topError * topError;
+		// The next ball waits for the collector, which waits for the wheels
+		// to see this one go.
+		unsigned shotsBefore = SHOOTER.GetShotDetector().GetShotCount();
+		FlywheelModel::Launch(bottomWheel, topWheel);
+		since = SimClock::Now();
+		while (SHOOTER.GetShotDetector().GetShotCount() == shotsBefore && SimClock::Now() - since < EXIT_TIMEOUT)
+			SimClock::RunUntil(SimClock::Now() + POLL_PERIOD);
+	}
+	double total = SimClock::Now() - start;
+	SHOOTER.Stop();
+
+	printf("%-20s", configuration.name);
+	for (unsigned i = 0; i < BALLS; i++)
+	{
+		if (i < shot)
+			printf(" %6.3f", readyTimes[i]);
+		else
+			printf("  never");
+	}
+	for (unsigned i = 0; i < BALLS; i++)
+	{
+		if (i < shot)
+			printf(" %+6.2f", errors[i]);
+		else
+			printf("      -");
+	}
+	if (shot == BALLS)
+		printf(" %6.3f %6.2f\n", total, sqrt(squaredError / (2 * BALLS)));
+	else
+		printf("  timed out\n");
+}
+
+int main(int argc, char** argv)
+{
+	printf("%-20s %-20s %-20s %6s %6s\n", "", "ready (s)", "bottom error (rps)", "total", "rms");
+	fflush(stdout);
+	for (unsigned i = 0; i < CONFIGURATION_COUNT; i++)
+	{
+		pid_t child = fork();
+		if (child == 0)
+		{
+			Run(CONFIGURATIONS[i], i);
+			fflush(stdout);
+			// The robot's tasks are still running; don't wait for them.
+			_exit(0);
+		}
+		int status;
+		waitpid(child, &status, 0);
+	}
+	return 0;
+}
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include "SimClock.h"
+#include "SimSemaphore.h"
+
+const double SimClock::kModelStep = 0.0005;
+const double SimClock::kQuantum = 0.001;
+const double SimClock::kReadCost = 0.00001;
+
+static const double NEVER = 1.0e300;
+
+pthread_mutex_t SimClock::lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_once_t SimClock::once = PTHREAD_ONCE_INIT;
+pthread_key_t SimClock::selfKey;
+double SimClock::now = 0.0;
+SimClock::Thread* SimClock::current = NULL;
+std::deque<SimClock::Thread*> SimClock::runQueue;
+std::vector<SimClock::Thread*> SimClock::sleepers;
+std::vector<SimModel*> SimClock::models;
+
+static SimClock::Thread* NewThread(const char* name)
+{
+	SimClock::Thread* thread = new SimClock::Thread;
+	pthread_cond_init(&thread->wakeup, NULL);
+	thread->name = name;
+	thread->wakeTime = NEVER;
+	thread->charged = 0.0;
+	thread->blockedOn = NULL;
+	thread->sleeping = false;
+	thread->timedOut = false;
+	thread->stopRequested = false;
+	thread->finished = false;
+	thread->function = NULL;
+	thread->entry = NULL;
+	thread->context = NULL;
+	return thread;
+}
+
+void SimClock::Initialize()
+{
+	pthread_key_create(&selfKey, NULL);
+	// Whoever touches the simulation first is the main thread and starts
+	// out holding the CPU.
+	Thread* main = NewThread("main");
+	main->handle = pthread_self();
+	pthread_setspecific(selfKey, main);
+	current = main;
+}
+
+pthread_mutex_t& SimClock::Lock()
+{
+	pthread_once(&once, Initialize);
+	return lock;
+}
+
+SimClock::Thread* SimClock::Self()
+{
+	pthread_once(&once, Initialize);
+	return (Thread*)pthread_getspecific(selfKey);
+}
+
+double SimClock::Now()
+{
+	pthread_once(&once, Initialize);
+	return now;
+}
+
+void SimClock::Sleep(double seconds)
+{
+	pthread_mutex_lock(&Lock());
+	Thread* self = Self();
+	self->charged = 0.0;
+	self->sleeping = true;
+	self->wakeTime = now + std::max(seconds, 0.0);
+	sleepers.push_back(self);
+	Block(self);
+	pthread_mutex_unlock(&lock);
+}
+
+void SimClock::Charge(double seconds)
+{
+	Thread* self = Self();
+	self->charged += seconds;
+	if (self->charged >= kQuantum)
+		Sleep(self->charged);
+}
+
+SimClock::Thread* SimClock::Spawn(const char* name, int (*function)(...), const unsigned* args)
+{
+	Thread* thread = NewThread(name);
+	thread->function = function;
+	for (int i = 0; i < 10; i++)
+		thread->args[i] = args ? args[i] : 0;
+	return Start(thread);
+}
+
+SimClock::Thread* SimClock::Spawn(const char* name, void (*entry)(void*), void* context)
+{
+	Thread* thread = NewThread(name);
+	thread->entry = entry;
+	thread->context = context;
+	return Start(thread);
+}
+
+SimClock::Thread* SimClock::Start(Thread* thread)
+{
+	pthread_mutex_lock(&Lock());
+	runQueue.push_back(thread);
+	pthread_create(&thread->handle, NULL, Trampoline, thread);
+	pthread_detach(thread->handle);
+	pthread_mutex_unlock(&lock);
+	return thread;
+}
+
+void SimClock::Stop(Thread* thread)
+{
+	pthread_mutex_lock(&Lock());
+	if (thread->finished || thread->stopRequested)
+	{
+		pthread_mutex_unlock(&lock);
+		return;
+	}
+	thread->stopRequested = true;
+	if (thread == Self())
+		Exit(thread);
+
+	// Get it off whatever it is waiting for so it can notice and exit.
+	if (thread->sleeping || thread->blockedOn)
+	{
+		if (thread->blockedOn)
+			thread->blockedOn->Forget(thread);
+		MakeRunnable(thread);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+void SimClock::AddModel(SimModel* model)
+{
+	pthread_mutex_lock(&Lock());
+	models.push_back(model);
+	pthread_mutex_unlock(&lock);
+}
+
+void SimClock::RemoveModel(SimModel* model)
+{
+	pthread_mutex_lock(&Lock());
+	models.erase(std::remove(models.begin(), models.end(), model), models.end());
+	pthread_mutex_unlock(&lock);
+}
+
+void SimClock::RunUntil(double time)
+{
+	Sleep(time - Now());
+}
+
+void SimClock::BlockOn(SimSemaphore* semaphore, double timeout)
+{
+	Thread* self = Self();
+	self->blockedOn = semaphore;
+	self->timedOut = false;
+	if (timeout >= 0.0)
+	{
+		self->wakeTime = now + timeout;
+		sleepers.push_back(self);
+	}
+	else
+	{
+		self->wakeTime = NEVER;
+	}
+	Block(self);
+}
+
+void SimClock::MakeRunnable(Thread* thread)
+{
+	sleepers.erase(std::remove(sleepers.begin(), sleepers.end(), thread), sleepers.end());
+	thread->sleeping = false;
+	thread->blockedOn = NULL;
+	thread->wakeTime = NEVER;
+	runQueue.push_back(thread);
+}
+
+// Hand the CPU to the next runnable thread, moving time forward until
+// there is one. The scheduler lock is held.
+void SimClock::Dispatch()
+{
+	current = NULL;
+	while (runQueue.empty())
+	{
+		if (sleepers.empty())
+		{
+			fprintf(stderr, "sim: every thread is blocked forever at t=%.6f\n", now);
+			abort();
+		}
+
+		double earliest = NEVER;
+		for (unsigned i = 0; i < sleepers.size(); i++)
+			earliest = std::min(earliest, sleepers[i]->wakeTime);
+		AdvanceTo(earliest);
+
+		std::vector<Thread*> waking;
+		for (unsigned i = 0; i < sleepers.size(); i++)
+			if (sleepers[i]->wakeTime <= now)
+				waking.push_back(sleepers[i]);
+		for (unsigned i = 0; i < waking.size(); i++)
+		{
+			if (waking[i]->blockedOn)
+			{
+				waking[i]->blockedOn->Forget(waking[i]);
+				waking[i]->timedOut = true;
+			}
+			MakeRunnable(waking[i]);
+		}
+	}
+
+	current = runQueue.front();
+	runQueue.pop_front();
+	pthread_cond_signal(&current->wakeup);
+}
+
+void SimClock::Block(Thread* self)
+{
+	Dispatch();
+	while (current != self)
+		pthread_cond_wait(&self->wakeup, &lock);
+	if (self->stopRequested)
+		Exit(self);
+}
+
+void SimClock::AdvanceTo(double time)
+{
+	while (now < time)
+	{
+		double dt = std::min(kModelStep, time - now);
+		now = (time - now <= kModelStep) ? time : now + dt;
+		for (unsigned i = 0; i < models.size(); i++)
+			models[i]->Step(now, dt);
+	}
+}
+
+void* SimClock::Trampoline(void* argument)
+{
+	Thread* self = (Thread*)argument;
+	pthread_setspecific(selfKey, self);
+
+	pthread_mutex_lock(&lock);
+	while (current != self)
+		pthread_cond_wait(&self->wakeup, &lock);
+	if (self->stopRequested)
+		Exit(self);
+	pthread_mutex_unlock(&lock);
+
+	if (self->entry)
+		self->entry(self->context);
+	else
+		self->function(self->args[0], self->args[1], self->args[2], self->args[3], self->args[4],
+				self->args[5], self->args[6], self->args[7], self->args[8], self->args[9]);
+
+	pthread_mutex_lock(&lock);
+	Exit(self);
+	return NULL;
+}
+
+// Give up the CPU for good. The scheduler lock is held on entry.
+void SimClock::Exit(Thread* self)
+{
+	self->finished = true;
+	Dispatch();
+	pthread_mutex_unlock(&lock);
+	pthread_exit(NULL);
+}
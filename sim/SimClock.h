@@ -0,0 +1,107 @@
+#ifndef SIMCLOCK_H
+#define SIMCLOCK_H
+
+#include <pthread.h>
+#include <deque>
+#include <vector>
+
+class SimSemaphore;
+
+/**
+ * Anything that evolves with simulated time (a motor, a ball on the
+ * conveyor). Models are stepped while the clock advances, never while robot
+ * code is running.
+ */
+class SimModel
+{
+public:
+	virtual ~SimModel() {}
+	virtual void Step(double now, double dt) = 0;
+};
+
+/**
+ * The virtual clock and the scheduler behind the simulated Task, Wait,
+ * Notifier and semaphores.
+ *
+ * Robot code runs on real threads, but only one of them holds the CPU at a
+ * time, the same as on the single-core cRIO. Time only moves when every
+ * thread is waiting, and then it jumps straight to the next wake-up, so a
+ * Wait(0.01) loop costs nothing. Reading hardware charges a little CPU time
+ * so loops that spin without waiting still see the clock move.
+ */
+class SimClock
+{
+public:
+	static const double kModelStep;		// longest interval models are stepped over
+	static const double kQuantum;		// CPU time a spinning thread uses before it yields
+	static const double kReadCost;		// CPU time charged per hardware read
+
+	struct Thread
+	{
+		pthread_t handle;
+		pthread_cond_t wakeup;
+		const char* name;
+		double wakeTime;
+		double charged;
+		SimSemaphore* blockedOn;
+		bool sleeping;
+		bool timedOut;
+		bool stopRequested;
+		bool finished;
+		int (*function)(...);
+		unsigned args[10];
+		void (*entry)(void*);
+		void* context;
+	};
+
+	static double Now();
+	static void Sleep(double seconds);
+	static void Charge(double seconds);
+
+	/**
+	 * Start a new thread. It becomes runnable immediately but does not run
+	 * until the caller waits or yields.
+	 */
+	static Thread* Spawn(const char* name, int (*function)(...), const unsigned* args);
+	static Thread* Spawn(const char* name, void (*entry)(void*), void* context);
+
+	/**
+	 * Stop a thread the next time it enters the scheduler.
+	 */
+	static void Stop(Thread* thread);
+
+	static void AddModel(SimModel* model);
+	static void RemoveModel(SimModel* model);
+
+	/**
+	 * Run the simulation until the clock reaches a time, letting every
+	 * other thread do its work. Called from the scenario's main thread.
+	 */
+	static void RunUntil(double time);
+
+	// Used by SimSemaphore; the scheduler lock must be held.
+	static pthread_mutex_t& Lock();
+	static Thread* Self();
+	static void BlockOn(SimSemaphore* semaphore, double timeout);
+	static void MakeRunnable(Thread* thread);
+
+private:
+	static void Initialize();
+	static void Dispatch();
+	static void Block(Thread* self);
+	static void AdvanceTo(double time);
+	static void* Trampoline(void* thread);
+	static void Exit(Thread* self);
+	static Thread* Start(Thread* thread);
+
+	static pthread_mutex_t lock;
+	static pthread_once_t once;
+	static pthread_key_t selfKey;
+	static double now;
+	static Thread* current;
+	static std::deque<Thread*> runQueue;
+	static std::vector<Thread*> sleepers;
+	static std::vector<SimModel*> models;
+};
+
+#endif // SIMCLOCK_H
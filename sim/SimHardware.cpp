@@ -0,0 +1,139 @@
+#include <cstring>
+#include "SimClock.h"
+#include "SimHardware.h"
+
+float SimHardware::pwm[kChannels + 1];
+int SimHardware::relay[kChannels + 1];
+float SimHardware::analog[kModules + 1][kChannels + 1];
+INT32 SimHardware::counts[kChannels + 1];
+double SimHardware::lastEdge[kChannels + 1];
+double SimHardware::period[kChannels + 1];
+bool SimHardware::buttons[kJoysticks + 1][kButtons];
+float SimHardware::axes[kJoysticks + 1][kAxes];
+float SimHardware::battery;
+float SimHardware::gyro;
+int SimHardware::acceleration[3];
+int SimHardware::magnetic[3];
+
+static const double NO_EDGE = -1.0e9;
+// Raw LSM303 readings: 1 g at the default range, and a field along the
+// robot's x axis.
+static const int RAW_GRAVITY = 16000;
+static const int RAW_FIELD = 450;
+
+float SimHardware::GetPWM(UINT32 channel)
+{
+	return channel <= kChannels ? pwm[channel] : 0.0f;
+}
+
+void SimHardware::SetPWM(UINT32 channel, float value)
+{
+	if (channel <= kChannels)
+		pwm[channel] = value;
+}
+
+int SimHardware::GetRelay(UINT32 channel)
+{
+	return channel <= kChannels ? relay[channel] : 0;
+}
+
+void SimHardware::SetRelay(UINT32 channel, int value)
+{
+	if (channel <= kChannels)
+		relay[channel] = value;
+}
+
+float SimHardware::GetAnalogVoltage(UINT8 module, UINT32 channel)
+{
+	return (module <= kModules && channel <= kChannels) ? analog[module][channel] : 0.0f;
+}
+
+void SimHardware::SetAnalogVoltage(UINT8 module, UINT32 channel, float voltage)
+{
+	if (module <= kModules && channel <= kChannels)
+		analog[module][channel] = voltage;
+}
+
+void SimHardware::AddCounts(UINT32 channel, INT32 added)
+{
+	if (channel > kChannels || added == 0)
+		return;
+	double now = SimClock::Now();
+	int edges = added < 0 ? -added : added;
+	if (lastEdge[channel] > NO_EDGE)
+		period[channel] = (now - lastEdge[channel]) / edges;
+	lastEdge[channel] = now;
+	counts[channel] += added;
+}
+
+void SimHardware::AddCounts(UINT32 channel, INT32 added, double edgePeriod)
+{
+	if (channel > kChannels || added == 0)
+		return;
+	period[channel] = edgePeriod;
+	lastEdge[channel] = SimClock::Now();
+	counts[channel] += added;
+}
+
+INT32 SimHardware::GetCounts(UINT32 channel)
+{
+	return channel <= kChannels ? counts[channel] : 0;
+}
+
+double SimHardware::GetPeriod(UINT32 channel)
+{
+	return channel <= kChannels ? period[channel] : 0.0;
+}
+
+double SimHardware::GetLastEdgeTime(UINT32 channel)
+{
+	return channel <= kChannels ? lastEdge[channel] : NO_EDGE;
+}
+
+bool SimHardware::GetJoystickButton(UINT32 port, UINT32 button)
+{
+	return (port <= kJoysticks && button < kButtons) ? buttons[port][button] : false;
+}
+
+void SimHardware::SetJoystickButton(UINT32 port, UINT32 button, bool pressed)
+{
+	if (port <= kJoysticks && button < kButtons)
+		buttons[port][button] = pressed;
+}
+
+float SimHardware::GetJoystickAxis(UINT32 port, UINT32 axis)
+{
+	return (port <= kJoysticks && axis < kAxes) ? axes[port][axis] : 0.0f;
+}
+
+void SimHardware::SetJoystickAxis(UINT32 port, UINT32 axis, float value)
+{
+	if (port <= kJoysticks && axis < kAxes)
+		axes[port][axis] = value;
+}
+
+void SimHardware::Reset()
+{
+	memset(pwm, 0, sizeof(pwm));
+	memset(relay, 0, sizeof(relay));
+	memset(analog, 0, sizeof(analog));
+	memset(counts, 0, sizeof(counts));
+	memset(period, 0, sizeof(period));
+	memset(buttons, 0, sizeof(buttons));
+	memset(axes, 0, sizeof(axes));
+	battery = 12.0f;
+	gyro = 0.0f;
+	acceleration[0] = 0;
+	acceleration[1] = 0;
+	acceleration[2] = RAW_GRAVITY;
+	magnetic[0] = RAW_FIELD;
+	magnetic[1] = 0;
+	magnetic[2] = 0;
+	for (unsigned i = 0; i <= kChannels; i++)
+		lastEdge[i] = NO_EDGE;
+}
+
+static struct ResetAtStartup
+{
+	ResetAtStartup() { SimHardware::Reset(); }
+} resetAtStartup;
@@ -0,0 +1,86 @@
+#ifndef SIMHARDWARE_H
+#define SIMHARDWARE_H
+
+#include "VxWorks.h"
+
+/**
+ * The simulated I/O the WPILib stand-ins read and write. Scenarios and
+ * physics models use it to see motor commands and to drive sensors.
+ */
+class SimHardware
+{
+public:
+	static const unsigned kChannels = 16;
+	static const unsigned kModules = 2;
+	static const unsigned kJoysticks = 4;
+	static const unsigned kButtons = 13;
+	static const unsigned kAxes = 7;
+
+	// PWM outputs (Jaguars and Victors), in [-1, 1].
+	static float GetPWM(UINT32 channel);
+	static void SetPWM(UINT32 channel, float value);
+
+	// Spike relays: 0 off, 1 on, 2 forward, 3 reverse.
+	static int GetRelay(UINT32 channel);
+	static void SetRelay(UINT32 channel, int value);
+
+	// The battery as the driver station reports it. The motor models
+	// assume a steady 12 V.
+	static float GetBatteryVoltage() { return battery; }
+	static void SetBatteryVoltage(float voltage) { battery = voltage; }
+
+	// The gyro angle (degrees, clockwise) and the LSM303's raw axes.
+	// At reset the robot is level and facing along the field's x axis.
+	static float GetGyroAngle() { return gyro; }
+	static void SetGyroAngle(float degrees) { gyro = degrees; }
+	static int GetAcceleration(unsigned axis) { return acceleration[axis]; }
+	static void SetAcceleration(unsigned axis, int raw) { acceleration[axis] = raw; }
+	static int GetMagnetic(unsigned axis) { return magnetic[axis]; }
+	static void SetMagnetic(unsigned axis, int raw) { magnetic[axis] = raw; }
+
+	static float GetAnalogVoltage(UINT8 module, UINT32 channel);
+	static void SetAnalogVoltage(UINT8 module, UINT32 channel, float voltage);
+
+	/**
+	 * Register edges on a digital input at the current simulated time.
+	 * Negative counts run a quadrature encoder backwards.
+	 */
+	static void AddCounts(UINT32 channel, INT32 counts);
+
+	/**
+	 * Register edges whose spacing the model knows better than the length
+	 * of a model step, so the FPGA period does not come out quantized.
+	 */
+	static void AddCounts(UINT32 channel, INT32 counts, double edgePeriod);
+	static INT32 GetCounts(UINT32 channel);
+
+	/**
+	 * \return the time between the last two edges on a channel, as the
+	 * FPGA measures it for Counter::GetPeriod().
+	 */
+	static double GetPeriod(UINT32 channel);
+	static double GetLastEdgeTime(UINT32 channel);
+
+	static bool GetJoystickButton(UINT32 port, UINT32 button);
+	static void SetJoystickButton(UINT32 port, UINT32 button, bool pressed);
+	static float GetJoystickAxis(UINT32 port, UINT32 axis);
+	static void SetJoystickAxis(UINT32 port, UINT32 axis, float value);
+
+	static void Reset();
+
+private:
+	static float pwm[kChannels + 1];
+	static int relay[kChannels + 1];
+	static float analog[kModules + 1][kChannels + 1];
+	static INT32 counts[kChannels + 1];
+	static double lastEdge[kChannels + 1];
+	static double period[kChannels + 1];
+	static bool buttons[kJoysticks + 1][kButtons];
+	static float axes[kJoysticks + 1][kAxes];
+	static float battery;
+	static float gyro;
+	static int acceleration[3];
+	static int magnetic[3];
+};
+
+#endif // SIMHARDWARE_H
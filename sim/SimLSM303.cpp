@@ -0,0 +1,33 @@
+#include "LSM303_I2C.h"
+#include "SimClock.h"
+#include "SimHardware.h"
+
+// The driver with its I2C reads replaced by the axes in SimHardware.
+
+LSM303_I2C::LSM303_I2C(UINT32 slot) : accelI2C_r(NULL), accelI2C_w(NULL), magI2C(NULL)
+{
+}
+
+LSM303_I2C::~LSM303_I2C()
+{
+}
+
+LSM303_I2C::AxesReport LSM303_I2C::GetAccelerations()
+{
+	SimClock::Charge(SimClock::kReadCost);
+	AxesReport data;
+	data.XAxis = SimHardware::GetAcceleration(0);
+	data.YAxis = SimHardware::GetAcceleration(1);
+	data.ZAxis = SimHardware::GetAcceleration(2);
+	return data;
+}
+
+LSM303_I2C::AxesReport LSM303_I2C::GetMagnetic()
+{
+	SimClock::Charge(SimClock::kReadCost);
+	AxesReport data;
+	data.XAxis = SimHardware::GetMagnetic(0);
+	data.YAxis = SimHardware::GetMagnetic(1);
+	data.ZAxis = SimHardware::GetMagnetic(2);
+	return data;
+}
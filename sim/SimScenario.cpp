@@ -0,0 +1,215 @@
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include "WPILib.h"
+#include "FlywheelModel.h"
+#include "SimClock.h"
+#include "SimHardware.h"
+#include "../Constants.h"
+#include "../Collector.h"
+#include "../DisplayWriter.h"
+#include "../DriveTrain.h"
+#include "../LSM303_I2C.h"
+#include "../Logger.h"
+#include "../PoseEstimator.h"
+#include "../Shooter.h"
+#include "../Singleton.h"
+
+/*
+ * Demo scenario: load one ball through the collector and shoot it, loading
+ * a second while the first is shot, with the real Collector and Shooter code
+ * running on simulated time.
+ */
+
+// Positions along the ball path, 0 at the front of the ramp and 1 where the
+// ball leaves the shooter.
+static const double BALL_ENTRY = 0.05;
+static const double GRABBER_END = 0.45;
+static const double LIFTER_START = 0.40;
+static const double FRONT_IR_END = 0.15;
+static const double MIDDLE_IR_START = 0.40;
+static const double MIDDLE_IR_END = 0.55;
+static const double TOP_IR_START = 0.85;
+static const double TOP_IR_END = 0.95;
+static const double BALL_SPEED = 1.2;			// path lengths per second at full power
+static const float IR_BALL_VOLTAGE = 2.2f;
+static const float IR_EMPTY_VOLTAGE = 0.2f;
+static const double SECOND_BALL_DELAY = 0.4;
+
+/**
+ * Balls moved along by the grabber and lifter, seen by the four IR sensors,
+ * and shot by the wheels at the end of their path. Balls pass through each
+ * other; the collector only ever has them in different zones.
+ */
+class BallModel : public SimModel
+{
+public:
+	static const unsigned MAX_BALLS = 4;
+
+	BallModel(FlywheelModel& bottomWheel, FlywheelModel& topWheel) :
+			bottomWheel(bottomWheel),
+			topWheel(topWheel),
+			loadTime(-1.0)
+	{
+		for (unsigned i = 0; i < MAX_BALLS; i++)
+			position[i] = -1.0;
+	}
+
+	void Load()
+	{
+		for (unsigned i = 0; i < MAX_BALLS; i++)
+		{
+			if (position[i] < 0.0)
+			{
+				position[i] = BALL_ENTRY;
+				return;
+			}
+		}
+	}
+
+	/// Load a ball once simulated time reaches when.
+	void LoadAt(double when) { loadTime = when; }
+
+	unsigned Count() const
+	{
+		unsigned count = 0;
+		for (unsigned i = 0; i < MAX_BALLS; i++)
+			if (position[i] >= 0.0)
+				count++;
+		return count;
+	}
+
+	/// \return whether any ball is between from and to along the path.
+	bool AnyBetween(double from, double to) const
+	{
+		for (unsigned i = 0; i < MAX_BALLS; i++)
+			if (position[i] >= from && position[i] < to)
+				return true;
+		return false;
+	}
+
+	virtual void Step(double now, double dt)
+	{
+		if (loadTime >= 0.0 && now >= loadTime)
+		{
+			Load();
+			loadTime = -1.0;
+		}
+		for (unsigned i = 0; i < MAX_BALLS; i++)
+		{
+			if (position[i] < 0.0)
+				continue;
+			double power = 0.0;
+			if (position[i] < GRABBER_END)
+				power = SimHardware::GetPWM(COLLECTOR_GRABBER_CHANNEL);
+			if (position[i] >= LIFTER_START)
+				power = SimHardware::GetPWM(COLLECTOR_LIFTER_CHANNEL);
+			position[i] += power * BALL_SPEED * dt;
+			if (position[i] >= 1.0)
+				FlywheelModel::Launch(bottomWheel, topWheel);
+			if (position[i] >= 1.0 || position[i] < 0.0)
+				position[i] = -1.0;
+		}
+
+		SetIR(IR_FRONT_CHANNEL, AnyBetween(0.0, FRONT_IR_END));
+		SetIR(IR_FRONT_MIDDLE_CHANNEL, AnyBetween(0.0, FRONT_IR_END));
+		SetIR(IR_MIDDLE_CHANNEL, AnyBetween(MIDDLE_IR_START, MIDDLE_IR_END));
+		SetIR(IR_TOP_CHANNEL, AnyBetween(TOP_IR_START, TOP_IR_END));
+	}
+
+private:
+	void SetIR(UINT32 channel, bool visible)
+	{
+		SimHardware::SetAnalogVoltage(1, channel, visible ? IR_BALL_VOLTAGE : IR_EMPTY_VOLTAGE);
+	}
+
+	FlywheelModel& bottomWheel;
+	FlywheelModel& topWheel;
+	double position[MAX_BALLS];
+	double loadTime;
+};
+
+static bool Check(bool condition, const char* what)
+{
+	printf("[%8.3f] %-40s %s\n", SimClock::Now(), what, condition ? "ok" : "FAILED");
+	return condition;
+}
+
+int main(int argc, char** argv)
+{
+	clock_t wallStart = clock();
+	bool passed = true;
+
+	Singleton<Logger>::SetInstance(new Logger("sim.log"));
+	FlywheelModel topWheel(SHOOTER_TOP_JAG_CHANNEL, SHOOTER_TOP_ENCODER_A, true);
+	FlywheelModel bottomWheel(SHOOTER_BOTTOM_JAG_CHANNEL, SHOOTER_BOTTOM_ENCODER_A, true);
+	BallModel ball(bottomWheel, topWheel);
+	SimClock::AddModel(&ball);
+	SimClock::AddModel(&topWheel);
+	SimClock::AddModel(&bottomWheel);
+
+	Singleton<Collector>::SetInstance(new Collector());
+	Singleton<Shooter>::SetInstance(new Shooter());
+	Singleton<DriveTrain>::SetInstance(new DriveTrain());
+	LSM303_I2C compass(DIGITAL_SIDECAR_SLOT);
+	Singleton<PoseEstimator>::SetInstance(new PoseEstimator(DRIVETRAIN, NULL, &compass));
+
+	COLLECTOR.Start();
+	passed &= Check(COLLECTOR.GetBalls() == 0, "collector starts empty");
+
+	ball.Load();
+	SimClock::RunUntil(SimClock::Now() + 3.0);
+	passed &= Check(COLLECTOR.GetBalls() == 1, "ball collected");
+	passed &= Check(ball.Count() == 1, "ball held in the lifter");
+
+	// The second ball rolls in while the first is being shot.
+	Joystick joystick(1);
+	double shotStart = SimClock::Now();
+	ball.LoadAt(shotStart + SECOND_BALL_DELAY);
+	SHOOTER.Shoot(27.7, &joystick, 1);
+	printf("[%8.3f] shot took %.3f s, wheels at %.1f / %.1f rev/s\n", SimClock::Now(),
+			SimClock::Now() - shotStart, topWheel.GetSpeed(), bottomWheel.GetSpeed());
+	passed &= Check(ball.Count() == 1 && !ball.AnyBetween(0.0, FRONT_IR_END), "second ball pulled in during the shot");
+
+	SimClock::RunUntil(SimClock::Now() + 2.0);
+	passed &= Check(COLLECTOR.GetBalls() == 1, "second ball collected");
+
+	// Lose count of it, as when a ball slips past the sensors. It sits out
+	// of their sight, so with nothing counted a shot is refused rather than
+	// fired dry, until the driver counts it again.
+	COLLECTOR.SetBallCount(0);
+	CommandFuture dryFire = COLLECTOR.Fire();
+	dryFire.Wait(1.0);
+	passed &= Check(dryFire.GetStatus() == COMMAND_REJECTED && ball.Count() == 1, "shot refused with no ball counted");
+	COLLECTOR.ChangeBallCountBy(1);
+	SHOOTER.Shoot(27.7, &joystick, 1);
+	passed &= Check(ball.Count() == 0 && COLLECTOR.GetBalls() == 0, "recounted ball shot");
+
+	// Let the wheels recover and the shot's telemetry be saved.
+	SimClock::RunUntil(SimClock::Now() + 0.5);
+
+	// The driver tops the count up while a ball is in the grabber, so there
+	// is no room for it; it should be pushed back off the ramp.
+	ball.Load();
+	SimClock::RunUntil(SimClock::Now() + 0.4);
+	COLLECTOR.ChangeBallCountBy(MAX_BALLS);
+	SimClock::RunUntil(SimClock::Now() + 2.0);
+	passed &= Check(ball.Count() == 0 && COLLECTOR.GetBalls() == MAX_BALLS
+			&& Collector::GetState() == LOOKING_FOR_BALLS, "ball rejected while full");
+
+	// The count says there are balls, but the lifter is empty; the shot
+	// times out, must not be taken for one that left, and corrects the count.
+	unsigned shotsBefore = SHOOTER.GetShotDetector().GetShotCount();
+	bool shot = COLLECTOR.Shoot();
+	passed &= Check(!shot && SHOOTER.GetShotDetector().GetShotCount() == shotsBefore
+			&& COLLECTOR.GetBalls() < MAX_BALLS && COLLECTOR.GetBallConfidence() < 1.0, "missed shot not counted");
+	PoseEstimator::Pose pose = POSE.GetPose();
+	passed &= Check(fabs(pose.x) < 0.01 && fabs(pose.y) < 0.01 && fabs(pose.heading) < 1.0 && POSE.GetSlipCount() == 0,
+			"robot stayed put through the shots");
+	COLLECTOR.LogStateTrace();
+
+	double wall = (double)(clock() - wallStart) / CLOCKS_PER_SEC;
+	printf("%.3f s simulated in %.3f s of CPU time\n", SimClock::Now(), wall);
+	fflush(stdout);
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include "SimSemaphore.h"
+
+SimSemaphore::SimSemaphore(Kind kind, int count) :
+		kind(kind),
+		count(count),
+		owner(NULL)
+{
+}
+
+bool SimSemaphore::Available(SimClock::Thread* self) const
+{
+	if (kind == MUTEX)
+		return owner == NULL || owner == self;
+	return count > 0;
+}
+
+void SimSemaphore::Acquire(SimClock::Thread* self)
+{
+	if (kind == MUTEX)
+	{
+		owner = self;
+		count++;
+	}
+	else
+	{
+		count--;
+	}
+}
+
+bool SimSemaphore::Take(double timeout)
+{
+	pthread_mutex_lock(&SimClock::Lock());
+	SimClock::Thread* self = SimClock::Self();
+	if (Available(self))
+	{
+		Acquire(self);
+		pthread_mutex_unlock(&SimClock::Lock());
+		return true;
+	}
+	if (timeout == 0.0)
+	{
+		pthread_mutex_unlock(&SimClock::Lock());
+		return false;
+	}
+
+	// Give() hands the semaphore straight to the first waiter.
+	waiters.push_back(self);
+	SimClock::BlockOn(this, timeout);
+	bool taken = !self->timedOut;
+	pthread_mutex_unlock(&SimClock::Lock());
+	return taken;
+}
+
+bool SimSemaphore::Give()
+{
+	pthread_mutex_lock(&SimClock::Lock());
+	bool ok = true;
+	if (kind == MUTEX)
+	{
+		if (owner != SimClock::Self())
+		{
+			ok = false;
+		}
+		else if (--count == 0)
+		{
+			owner = NULL;
+			if (!waiters.empty())
+			{
+				owner = waiters.front();
+				count = 1;
+				waiters.pop_front();
+				SimClock::MakeRunnable(owner);
+			}
+		}
+	}
+	else if (!waiters.empty())
+	{
+		SimClock::Thread* waiter = waiters.front();
+		waiters.pop_front();
+		SimClock::MakeRunnable(waiter);
+	}
+	else if (kind == BINARY)
+	{
+		count = 1;
+	}
+	else
+	{
+		count++;
+	}
+	pthread_mutex_unlock(&SimClock::Lock());
+	return ok;
+}
+
+void SimSemaphore::Flush()
+{
+	pthread_mutex_lock(&SimClock::Lock());
+	while (!waiters.empty())
+	{
+		SimClock::MakeRunnable(waiters.front());
+		waiters.pop_front();
+	}
+	pthread_mutex_unlock(&SimClock::Lock());
+}
+
+void SimSemaphore::Forget(SimClock::Thread* thread)
+{
+	waiters.erase(std::remove(waiters.begin(), waiters.end(), thread), waiters.end());
+}
@@ -0,0 +1,43 @@
+#ifndef SIMSEMAPHORE_H
+#define SIMSEMAPHORE_H
+
+#include <deque>
+#include "SimClock.h"
+
+/**
+ * A VxWorks semaphore (binary, counting or mutex) in simulated time.
+ */
+class SimSemaphore
+{
+public:
+	enum Kind
+	{
+		BINARY,
+		COUNTING,
+		MUTEX
+	};
+
+	SimSemaphore(Kind kind, int count);
+
+	/**
+	 * \param timeout seconds to wait, 0 to poll, negative to wait forever.
+	 * \return true if the semaphore was taken.
+	 */
+	bool Take(double timeout);
+	bool Give();
+	void Flush();
+
+	// Scheduler use only, with the scheduler lock held.
+	void Forget(SimClock::Thread* thread);
+
+private:
+	bool Available(SimClock::Thread* self) const;
+	void Acquire(SimClock::Thread* self);
+
+	Kind kind;
+	int count;
+	SimClock::Thread* owner;
+	std::deque<SimClock::Thread*> waiters;
+};
+
+#endif // SIMSEMAPHORE_H
@@ -0,0 +1,70 @@
+#include <cerrno>
+#include <fcntl.h>
+#include "WPILib.h"
+#include "SimClock.h"
+#include "sockLib.h"
+#include "selectLib.h"
+
+// Robot code gets the simulated select(); here it is the host's.
+#undef select
+
+// How long each poll of the host sockets waits, in real and simulated time.
+static const long POLL_INTERVAL_US = 1000;
+
+static void CopySet(fd_set* to, const fd_set* from)
+{
+	if (to)
+		*to = *from;
+}
+
+int SimSelect(int width, fd_set* readable, fd_set* writable, fd_set* exceptional, struct timeval* timeout)
+{
+	double deadline = timeout ? SimClock::Now() + timeout->tv_sec + timeout->tv_usec / 1.0e6 : -1.0;
+	fd_set readWanted, writeWanted, exceptionalWanted;
+	FD_ZERO(&readWanted);
+	FD_ZERO(&writeWanted);
+	FD_ZERO(&exceptionalWanted);
+	if (readable)
+		readWanted = *readable;
+	if (writable)
+		writeWanted = *writable;
+	if (exceptional)
+		exceptionalWanted = *exceptional;
+
+	while (true)
+	{
+		CopySet(readable, &readWanted);
+		CopySet(writable, &writeWanted);
+		CopySet(exceptional, &exceptionalWanted);
+		// Blocking here holds the simulated CPU, which is what keeps the
+		// clock in step with the host while nothing else has work to do.
+		struct timeval poll = { 0, POLL_INTERVAL_US };
+		int ready = select(width, readable, writable, exceptional, &poll);
+		if (ready != 0)
+			return ready;
+		if (deadline >= 0.0 && SimClock::Now() >= deadline)
+			return 0;
+		SimClock::Sleep(POLL_INTERVAL_US / 1.0e6);
+	}
+}
+
+STATUS connectWithTimeout(int sock, struct sockaddr* address, int addressLength, struct timeval* timeout)
+{
+	int flags = fcntl(sock, F_GETFL, 0);
+	fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+	int result = connect(sock, address, addressLength);
+	if (result < 0 && errno == EINPROGRESS)
+	{
+		fd_set writable;
+		FD_ZERO(&writable);
+		FD_SET(sock, &writable);
+		struct timeval wait = *timeout;
+		int error = 0;
+		socklen_t length = sizeof(error);
+		if (select(sock + 1, NULL, &writable, NULL, &wait) > 0
+				&& getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0)
+			result = 0;
+	}
+	fcntl(sock, F_SETFL, flags);
+	return result < 0 ? ERROR : OK;
+}
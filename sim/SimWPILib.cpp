@@ -0,0 +1,841 @@
+#include <limits>
+#include "WPILib.h"
+#include "SimClock.h"
+#include "SimHardware.h"
+#include "SimSemaphore.h"
+
+// Analog module LSB, roughly 10 V over 12 bits.
+static const double ANALOG_VOLTS_PER_LSB = 10.0 / 4096.0;
+static const int SYSTEM_CLOCK_RATE = 1000;
+
+void Wait(double seconds)
+{
+	SimClock::Sleep(seconds);
+}
+
+UINT32 GetFPGATime()
+{
+	return (UINT32)(SimClock::Now() * 1.0e6);
+}
+
+// VxWorks semaphores and task control
+
+SEM_ID semBCreate(int options, SEM_B_STATE initialState)
+{
+	return new SimSemaphore(SimSemaphore::BINARY, initialState == SEM_FULL ? 1 : 0);
+}
+
+SEM_ID semCCreate(int options, int initialCount)
+{
+	return new SimSemaphore(SimSemaphore::COUNTING, initialCount);
+}
+
+SEM_ID semMCreate(int options)
+{
+	return new SimSemaphore(SimSemaphore::MUTEX, 0);
+}
+
+STATUS semTake(SEM_ID semaphore, int timeout)
+{
+	double seconds = (timeout == WAIT_FOREVER) ? -1.0 : (double)timeout / SYSTEM_CLOCK_RATE;
+	return semaphore->Take(seconds) ? OK : ERROR;
+}
+
+STATUS semGive(SEM_ID semaphore)
+{
+	return semaphore->Give() ? OK : ERROR;
+}
+
+STATUS semFlush(SEM_ID semaphore)
+{
+	semaphore->Flush();
+	return OK;
+}
+
+STATUS semDelete(SEM_ID semaphore)
+{
+	delete semaphore;
+	return OK;
+}
+
+int sysClkRateGet()
+{
+	return SYSTEM_CLOCK_RATE;
+}
+
+STATUS taskLock()
+{
+	return OK;
+}
+
+STATUS taskUnlock()
+{
+	return OK;
+}
+
+int taskIdSelf()
+{
+	return (int)(long)SimClock::Self();
+}
+
+// Motor controllers and relays
+
+SimPWMController::SimPWMController(UINT32 channel) :
+		channel(channel)
+{
+	SimHardware::SetPWM(channel, 0.0f);
+}
+
+SimPWMController::SimPWMController(UINT8 moduleNumber, UINT32 channel) :
+		channel(channel)
+{
+	SimHardware::SetPWM(channel, 0.0f);
+}
+
+SimPWMController::~SimPWMController()
+{
+	SimHardware::SetPWM(channel, 0.0f);
+}
+
+void SimPWMController::Set(float speed, UINT8 syncGroup)
+{
+	if (speed > 1.0f)
+		speed = 1.0f;
+	if (speed < -1.0f)
+		speed = -1.0f;
+	SimHardware::SetPWM(channel, speed);
+}
+
+float SimPWMController::Get()
+{
+	return SimHardware::GetPWM(channel);
+}
+
+void SimPWMController::Disable()
+{
+	SimHardware::SetPWM(channel, 0.0f);
+}
+
+void SimPWMController::PIDWrite(float output)
+{
+	Set(output);
+}
+
+Relay::Relay(UINT32 channel, Direction direction) :
+		channel(channel)
+{
+	SimHardware::SetRelay(channel, kOff);
+}
+
+Relay::Relay(UINT8 moduleNumber, UINT32 channel, Direction direction) :
+		channel(channel)
+{
+	SimHardware::SetRelay(channel, kOff);
+}
+
+Relay::~Relay()
+{
+	SimHardware::SetRelay(channel, kOff);
+}
+
+void Relay::Set(Value value)
+{
+	SimHardware::SetRelay(channel, value);
+}
+
+Relay::Value Relay::Get()
+{
+	return (Value)SimHardware::GetRelay(channel);
+}
+
+// Sensors
+
+AnalogChannel::AnalogChannel(UINT8 moduleNumber, UINT32 channel) :
+		moduleNumber(moduleNumber),
+		channel(channel),
+		averageBits(7),
+		oversampleBits(0)
+{
+}
+
+AnalogChannel::AnalogChannel(UINT32 channel) :
+		moduleNumber(1),
+		channel(channel),
+		averageBits(7),
+		oversampleBits(0)
+{
+}
+
+AnalogChannel::~AnalogChannel()
+{
+}
+
+INT16 AnalogChannel::GetValue()
+{
+	return (INT16)(GetVoltage() / ANALOG_VOLTS_PER_LSB);
+}
+
+INT32 AnalogChannel::GetAverageValue()
+{
+	return (INT32)(GetAverageVoltage() / ANALOG_VOLTS_PER_LSB) << oversampleBits;
+}
+
+float AnalogChannel::GetVoltage()
+{
+	SimClock::Charge(SimClock::kReadCost);
+	return SimHardware::GetAnalogVoltage(moduleNumber, channel);
+}
+
+float AnalogChannel::GetAverageVoltage()
+{
+	SimClock::Charge(SimClock::kReadCost);
+	return SimHardware::GetAnalogVoltage(moduleNumber, channel);
+}
+
+AnalogTrigger::AnalogTrigger(UINT8 moduleNumber, UINT32 channel) :
+		moduleNumber(moduleNumber),
+		channel(channel),
+		lower(0.0f),
+		upper(0.0f),
+		state(false)
+{
+}
+
+AnalogTrigger::AnalogTrigger(UINT32 channel) :
+		moduleNumber(1),
+		channel(channel),
+		lower(0.0f),
+		upper(0.0f),
+		state(false)
+{
+}
+
+AnalogTrigger::~AnalogTrigger()
+{
+}
+
+void AnalogTrigger::SetLimitsVoltage(float lower, float upper)
+{
+	this->lower = lower;
+	this->upper = upper;
+}
+
+// The FPGA compares every conversion, so this costs the robot nothing.
+float AnalogTrigger::Sample()
+{
+	float voltage = SimHardware::GetAnalogVoltage(moduleNumber, channel);
+	if (voltage > upper)
+		state = true;
+	else if (voltage < lower)
+		state = false;
+	return voltage;
+}
+
+bool AnalogTrigger::GetInWindow()
+{
+	SimClock::Charge(SimClock::kReadCost);
+	float voltage = Sample();
+	return voltage >= lower && voltage <= upper;
+}
+
+bool AnalogTrigger::GetTriggerState()
+{
+	SimClock::Charge(SimClock::kReadCost);
+	Sample();
+	return state;
+}
+
+AnalogTriggerOutput* AnalogTrigger::CreateOutput(AnalogTriggerOutput::Type type)
+{
+	return new AnalogTriggerOutput(this, type);
+}
+
+AnalogTriggerOutput::AnalogTriggerOutput(AnalogTrigger* trigger, Type type) :
+		trigger(trigger),
+		type(type),
+		handler(NULL),
+		param(NULL),
+		enabled(false),
+		lastState(false),
+		thread(NULL)
+{
+}
+
+AnalogTriggerOutput::~AnalogTriggerOutput()
+{
+	CancelInterrupts();
+}
+
+bool AnalogTriggerOutput::Get()
+{
+	switch (type)
+	{
+	case kInWindow:
+		return trigger->GetInWindow();
+	case kState:
+		return trigger->GetTriggerState();
+	default:
+		// The pulses last one FPGA cycle, too short to read.
+		SimClock::Charge(SimClock::kReadCost);
+		return false;
+	}
+}
+
+// The level the interrupt watches for the output.
+bool AnalogTriggerOutput::Sample()
+{
+	float voltage = trigger->Sample();
+	if (type == kInWindow)
+		return voltage >= trigger->lower && voltage <= trigger->upper;
+	return type == kFallingPulse ? !trigger->state : trigger->state;
+}
+
+void AnalogTriggerOutput::RequestInterrupts(tInterruptHandler handler, void* param)
+{
+	CancelInterrupts();
+	this->handler = handler;
+	this->param = param;
+	lastState = Sample();
+	thread = SimClock::Spawn("Interrupt", Watch, this);
+}
+
+void AnalogTriggerOutput::CancelInterrupts()
+{
+	if (thread)
+		SimClock::Stop((SimClock::Thread*)thread);
+	thread = NULL;
+	enabled = false;
+}
+
+void AnalogTriggerOutput::EnableInterrupts()
+{
+	enabled = true;
+}
+
+void AnalogTriggerOutput::DisableInterrupts()
+{
+	enabled = false;
+}
+
+void AnalogTriggerOutput::Watch(void* output)
+{
+	AnalogTriggerOutput* self = (AnalogTriggerOutput*)output;
+	while (true)
+	{
+		SimClock::Sleep(SimClock::kModelStep);
+		bool level = self->Sample();
+		bool rising = level && !self->lastState;
+		self->lastState = level;
+		if (rising && self->enabled)
+			self->handler(1, self->param);
+	}
+}
+
+Counter::Counter(UINT32 channel) :
+		channel(channel),
+		offset(0),
+		stoppedCount(0),
+		running(false),
+		maxPeriod(0.5)
+{
+}
+
+Counter::~Counter()
+{
+}
+
+void Counter::Start()
+{
+	if (!running)
+		offset += SimHardware::GetCounts(channel) - (offset + stoppedCount);
+	running = true;
+}
+
+INT32 Counter::Get()
+{
+	SimClock::Charge(SimClock::kReadCost);
+	return running ? SimHardware::GetCounts(channel) - offset : stoppedCount;
+}
+
+void Counter::Reset()
+{
+	offset = SimHardware::GetCounts(channel);
+	stoppedCount = 0;
+}
+
+void Counter::Stop()
+{
+	stoppedCount = Get();
+	running = false;
+}
+
+double Counter::GetPeriod()
+{
+	SimClock::Charge(SimClock::kReadCost);
+	if (GetStopped())
+		return std::numeric_limits<double>::infinity();
+	return SimHardware::GetPeriod(channel);
+}
+
+bool Counter::GetStopped()
+{
+	return SimClock::Now() - SimHardware::GetLastEdgeTime(channel) > maxPeriod;
+}
+
+Encoder::Encoder(UINT32 aChannel, UINT32 bChannel, bool reverseDirection) :
+		channel(aChannel),
+		offset(0),
+		reverse(reverseDirection),
+		distancePerPulse(1.0)
+{
+}
+
+Encoder::~Encoder()
+{
+}
+
+void Encoder::Start()
+{
+}
+
+INT32 Encoder::Get()
+{
+	return GetRaw();
+}
+
+INT32 Encoder::GetRaw()
+{
+	SimClock::Charge(SimClock::kReadCost);
+	INT32 raw = SimHardware::GetCounts(channel) - offset;
+	return reverse ? -raw : raw;
+}
+
+void Encoder::Reset()
+{
+	offset = SimHardware::GetCounts(channel);
+}
+
+void Encoder::Stop()
+{
+}
+
+double Encoder::GetPeriod()
+{
+	if (GetStopped())
+		return std::numeric_limits<double>::infinity();
+	return SimHardware::GetPeriod(channel);
+}
+
+bool Encoder::GetStopped()
+{
+	return SimClock::Now() - SimHardware::GetLastEdgeTime(channel) > 0.5;
+}
+
+double Encoder::GetDistance()
+{
+	return GetRaw() * distancePerPulse;
+}
+
+double Encoder::GetRate()
+{
+	double period = GetPeriod();
+	if (period == std::numeric_limits<double>::infinity() || period <= 0.0)
+		return 0.0;
+	return distancePerPulse / period;
+}
+
+Gyro::Gyro(UINT32 channel) :
+		offset(SimHardware::GetGyroAngle())
+{
+}
+
+float Gyro::GetAngle()
+{
+	SimClock::Charge(SimClock::kReadCost);
+	return SimHardware::GetGyroAngle() - offset;
+}
+
+void Gyro::Reset()
+{
+	offset = SimHardware::GetGyroAngle();
+}
+
+Joystick::Joystick(UINT32 port) :
+		port(port)
+{
+}
+
+Joystick::~Joystick()
+{
+}
+
+float Joystick::GetRawAxis(UINT32 axis)
+{
+	return SimHardware::GetJoystickAxis(port, axis);
+}
+
+bool Joystick::GetRawButton(UINT32 button)
+{
+	return SimHardware::GetJoystickButton(port, button);
+}
+
+// Time
+
+Timer::Timer() :
+		startTime(SimClock::Now()),
+		accumulatedTime(0.0),
+		running(false)
+{
+}
+
+Timer::~Timer()
+{
+}
+
+double Timer::Get()
+{
+	SimClock::Charge(SimClock::kReadCost);
+	return running ? accumulatedTime + SimClock::Now() - startTime : accumulatedTime;
+}
+
+void Timer::Reset()
+{
+	accumulatedTime = 0.0;
+	startTime = SimClock::Now();
+}
+
+void Timer::Start()
+{
+	if (!running)
+	{
+		startTime = SimClock::Now();
+		running = true;
+	}
+}
+
+void Timer::Stop()
+{
+	accumulatedTime = Get();
+	running = false;
+}
+
+bool Timer::HasPeriodPassed(double period)
+{
+	if (Get() > period)
+	{
+		startTime += period;
+		return true;
+	}
+	return false;
+}
+
+double Timer::GetFPGATimestamp()
+{
+	return SimClock::Now();
+}
+
+// Tasks and notifiers
+
+Task::Task(const char* name, FUNCPTR function, INT32 priority, UINT32 stackSize) :
+		name(name),
+		function(function),
+		priority(priority),
+		thread(NULL)
+{
+	memset(args, 0, sizeof(args));
+}
+
+Task::~Task()
+{
+	Stop();
+}
+
+bool Task::Start(UINT32 arg0, UINT32 arg1, UINT32 arg2, UINT32 arg3, UINT32 arg4,
+		UINT32 arg5, UINT32 arg6, UINT32 arg7, UINT32 arg8, UINT32 arg9)
+{
+	UINT32 given[10] = { arg0, arg1, arg2, arg3, arg4, arg5, arg6, arg7, arg8, arg9 };
+	memcpy(args, given, sizeof(args));
+	thread = SimClock::Spawn(name.c_str(), function, args);
+	return true;
+}
+
+bool Task::Restart()
+{
+	Stop();
+	thread = SimClock::Spawn(name.c_str(), function, args);
+	return true;
+}
+
+bool Task::Stop()
+{
+	if (thread)
+		SimClock::Stop((SimClock::Thread*)thread);
+	thread = NULL;
+	return true;
+}
+
+bool Task::IsReady()
+{
+	return Verify();
+}
+
+bool Task::Verify()
+{
+	return thread && !((SimClock::Thread*)thread)->finished;
+}
+
+Notifier::Notifier(TimerEventHandler handler, void* param) :
+		handler(handler),
+		param(param),
+		period(0.0),
+		nextFire(0.0),
+		periodic(false),
+		thread(NULL)
+{
+}
+
+Notifier::~Notifier()
+{
+	Stop();
+}
+
+void Notifier::StartSingle(double delay)
+{
+	Stop();
+	periodic = false;
+	period = delay;
+	nextFire = SimClock::Now() + delay;
+	thread = SimClock::Spawn("Notifier", Run, this);
+}
+
+void Notifier::StartPeriodic(double period)
+{
+	Stop();
+	periodic = true;
+	this->period = period;
+	nextFire = SimClock::Now() + period;
+	thread = SimClock::Spawn("Notifier", Run, this);
+}
+
+void Notifier::Stop()
+{
+	if (thread)
+		SimClock::Stop((SimClock::Thread*)thread);
+	thread = NULL;
+}
+
+void Notifier::Run(void* notifier)
+{
+	Notifier* self = (Notifier*)notifier;
+	do
+	{
+		// Stop() takes effect inside the scheduler, before this touches
+		// the Notifier again.
+		SimClock::Sleep(self->nextFire - SimClock::Now());
+		self->nextFire += self->period;
+		self->handler(self->param);
+	} while (self->periodic);
+}
+
+// Control
+
+PIDController::PIDController(float p, float i, float d, PIDSource* source, PIDOutput* output, float period) :
+		p(p), i(i), d(d),
+		maximumOutput(1.0f), minimumOutput(-1.0f),
+		maximumInput(0.0f), minimumInput(0.0f),
+		continuous(false),
+		enabled(false),
+		prevError(0.0f),
+		totalError(0.0),
+		tolerance(0.05f),
+		setpoint(0.0f),
+		error(0.0f),
+		result(0.0f),
+		source(source),
+		output(output)
+{
+	controlLoop = new Notifier(CallCalculate, this);
+	controlLoop->StartPeriodic(period);
+}
+
+PIDController::~PIDController()
+{
+	delete controlLoop;
+}
+
+void PIDController::CallCalculate(void* controller)
+{
+	((PIDController*)controller)->Calculate();
+}
+
+// The same algorithm as WPILib's PIDController::Calculate().
+void PIDController::Calculate()
+{
+	if (!enabled || !source || !output)
+		return;
+
+	float input = source->PIDGet();
+	error = setpoint - input;
+	if (continuous && fabs(error) > (maximumInput - minimumInput) / 2)
+		error += (error > 0) ? minimumInput - maximumInput : maximumInput - minimumInput;
+
+	if (i != 0.0f)
+	{
+		double potentialIGain = (totalError + error) * i;
+		if (potentialIGain < maximumOutput && potentialIGain > minimumOutput)
+			totalError += error;
+	}
+
+	result = p * error + i * totalError + d * (error - prevError);
+	prevError = error;
+
+	if (result > maximumOutput)
+		result = maximumOutput;
+	else if (result < minimumOutput)
+		result = minimumOutput;
+
+	output->PIDWrite(result);
+}
+
+float PIDController::Get()
+{
+	return result;
+}
+
+void PIDController::SetInputRange(float minimumInput, float maximumInput)
+{
+	this->minimumInput = minimumInput;
+	this->maximumInput = maximumInput;
+	SetSetpoint(setpoint);
+}
+
+void PIDController::SetOutputRange(float minimumOutput, float maximumOutput)
+{
+	this->minimumOutput = minimumOutput;
+	this->maximumOutput = maximumOutput;
+}
+
+void PIDController::SetPID(float p, float i, float d)
+{
+	this->p = p;
+	this->i = i;
+	this->d = d;
+}
+
+void PIDController::SetSetpoint(float setpoint)
+{
+	if (maximumInput > minimumInput)
+	{
+		if (setpoint > maximumInput)
+			setpoint = maximumInput;
+		else if (setpoint < minimumInput)
+			setpoint = minimumInput;
+	}
+	this->setpoint = setpoint;
+}
+
+bool PIDController::OnTarget()
+{
+	return fabs(error) < tolerance / 100 * (maximumInput - minimumInput);
+}
+
+void PIDController::Enable()
+{
+	enabled = true;
+}
+
+void PIDController::Disable()
+{
+	if (output)
+		output->PIDWrite(0.0f);
+	enabled = false;
+}
+
+void PIDController::Reset()
+{
+	Disable();
+	prevError = 0.0f;
+	totalError = 0.0;
+	result = 0.0f;
+}
+
+Synchronized::Synchronized(SEM_ID semaphore) :
+		semaphore(semaphore)
+{
+	semTake(semaphore, WAIT_FOREVER);
+}
+
+Synchronized::~Synchronized()
+{
+	semGive(semaphore);
+}
+
+// Driver station
+
+DriverStation* DriverStation::GetInstance()
+{
+	static DriverStation instance;
+	return &instance;
+}
+
+float DriverStation::GetBatteryVoltage()
+{
+	return SimHardware::GetBatteryVoltage();
+}
+
+bool DriverStationLCD::echo = false;
+
+DriverStationLCD::DriverStationLCD()
+{
+	Clear();
+}
+
+DriverStationLCD* DriverStationLCD::GetInstance()
+{
+	static DriverStationLCD instance;
+	return &instance;
+}
+
+void DriverStationLCD::UpdateLCD()
+{
+	if (!echo)
+		return;
+	printf("[%9.3f] ---------------------\n", SimClock::Now());
+	for (UINT32 i = 0; i < kNumLines; i++)
+		printf("            %s\n", lines[i]);
+}
+
+void DriverStationLCD::Printf(Line line, INT32 startingColumn, const char* format, ...)
+{
+	if ((UINT32)line >= kNumLines || startingColumn < 1 || (UINT32)startingColumn > kLineLength)
+		return;
+	char buffer[256];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	char* dest = lines[line] + startingColumn - 1;
+	for (UINT32 i = 0; buffer[i] && dest < lines[line] + kLineLength; i++)
+		*dest++ = buffer[i];
+}
+
+void DriverStationLCD::PrintfLine(Line line, const char* format, ...)
+{
+	if ((UINT32)line >= kNumLines)
+		return;
+	char buffer[256];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	snprintf(lines[line], kLineLength + 1, "%-21s", buffer);
+}
+
+void DriverStationLCD::Clear()
+{
+	for (UINT32 i = 0; i < kNumLines; i++)
+	{
+		memset(lines[i], ' ', kLineLength);
+		lines[i][kLineLength] = '\0';
+	}
+}
@@ -0,0 +1,6 @@
+#ifndef SIM_TIMER_H
+#define SIM_TIMER_H
+
+#include "WPILib.h"
+
+#endif // SIM_TIMER_H
@@ -0,0 +1,6 @@
+#ifndef SIM_UTILITY_H
+#define SIM_UTILITY_H
+
+#include "WPILib.h"
+
+#endif // SIM_UTILITY_H
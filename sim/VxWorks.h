@@ -0,0 +1,68 @@
+#ifndef SIM_VXWORKS_H
+#define SIM_VXWORKS_H
+
+/**
+ * \file VxWorks.h
+ * \brief The parts of the VxWorks API robot code uses, on simulated time.
+ */
+
+typedef unsigned char UINT8;
+typedef unsigned short UINT16;
+typedef unsigned int UINT32;
+typedef signed char INT8;
+typedef short INT16;
+typedef int INT32;
+typedef int STATUS;
+typedef int BOOL;
+typedef int (*FUNCPTR)(...);
+
+#ifndef OK
+#define OK 0
+#endif
+#ifndef ERROR
+#define ERROR (-1)
+#endif
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+class SimSemaphore;
+typedef SimSemaphore* SEM_ID;
+
+#define SEM_Q_FIFO			0x0
+#define SEM_Q_PRIORITY		0x1
+#define SEM_DELETE_SAFE		0x4
+#define SEM_INVERSION_SAFE	0x8
+#define WAIT_FOREVER		(-1)
+#define NO_WAIT				0
+
+enum SEM_B_STATE
+{
+	SEM_EMPTY = 0,
+	SEM_FULL = 1
+};
+
+SEM_ID semBCreate(int options, SEM_B_STATE initialState);
+SEM_ID semCCreate(int options, int initialCount);
+SEM_ID semMCreate(int options);
+STATUS semTake(SEM_ID semaphore, int timeout);
+STATUS semGive(SEM_ID semaphore);
+STATUS semFlush(SEM_ID semaphore);
+STATUS semDelete(SEM_ID semaphore);
+
+/**
+ * Ticks per second of the simulated system clock.
+ */
+int sysClkRateGet();
+
+/**
+ * Only one simulated task runs at a time, so preemption locks are no-ops.
+ */
+STATUS taskLock();
+STATUS taskUnlock();
+int taskIdSelf();
+
+#endif // SIM_VXWORKS_H
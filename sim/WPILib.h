@@ -0,0 +1,429 @@
+#ifndef SIM_WPILIB_H
+#define SIM_WPILIB_H
+
+/**
+ * \file WPILib.h
+ * \brief Host-side stand-ins for the WPILib classes the robot code uses.
+ *
+ * Everything runs on the virtual clock in SimClock: Wait() and the task,
+ * notifier and semaphore calls block in simulated time, so subsystem code
+ * built against this header runs unchanged and much faster than real time.
+ * Hardware I/O goes through SimHardware.
+ */
+
+#include <cmath>
+#include <ctime>
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "VxWorks.h"
+#include "SimHardware.h"
+
+class SimClock;
+class Notifier;
+class RobotDrive;
+
+void Wait(double seconds);
+UINT32 GetFPGATime();
+
+class SensorBase
+{
+public:
+	virtual ~SensorBase() {}
+};
+
+class PIDSource
+{
+public:
+	virtual ~PIDSource() {}
+	virtual double PIDGet() = 0;
+};
+
+class PIDOutput
+{
+public:
+	virtual ~PIDOutput() {}
+	virtual void PIDWrite(float output) = 0;
+};
+
+class SpeedController : public PIDOutput
+{
+public:
+	virtual ~SpeedController() {}
+	virtual void Set(float speed, UINT8 syncGroup = 0) = 0;
+	virtual float Get() = 0;
+	virtual void Disable() = 0;
+};
+
+/**
+ * A PWM motor controller. Jaguars and Victors only differ in their
+ * pulse-width mapping, which does not matter here.
+ */
+class SimPWMController : public SpeedController
+{
+public:
+	explicit SimPWMController(UINT32 channel);
+	SimPWMController(UINT8 moduleNumber, UINT32 channel);
+	virtual ~SimPWMController();
+
+	virtual void Set(float speed, UINT8 syncGroup = 0);
+	virtual float Get();
+	virtual void Disable();
+	virtual void PIDWrite(float output);
+
+	void SetSafetyEnabled(bool enabled) {}
+	void SetExpiration(double timeout) {}
+	UINT32 GetChannel() const { return channel; }
+
+private:
+	UINT32 channel;
+};
+
+class Jaguar : public SimPWMController
+{
+public:
+	explicit Jaguar(UINT32 channel) : SimPWMController(channel) {}
+	Jaguar(UINT8 moduleNumber, UINT32 channel) : SimPWMController(moduleNumber, channel) {}
+};
+
+class Victor : public SimPWMController
+{
+public:
+	explicit Victor(UINT32 channel) : SimPWMController(channel) {}
+	Victor(UINT8 moduleNumber, UINT32 channel) : SimPWMController(moduleNumber, channel) {}
+};
+
+class Relay : public SensorBase
+{
+public:
+	enum Value { kOff, kOn, kForward, kReverse };
+	enum Direction { kBothDirections, kForwardOnly, kReverseOnly };
+
+	explicit Relay(UINT32 channel, Direction direction = kBothDirections);
+	Relay(UINT8 moduleNumber, UINT32 channel, Direction direction = kBothDirections);
+	virtual ~Relay();
+
+	void Set(Value value);
+	Value Get();
+
+private:
+	UINT32 channel;
+};
+
+class AnalogChannel : public SensorBase, public PIDSource
+{
+public:
+	AnalogChannel(UINT8 moduleNumber, UINT32 channel);
+	explicit AnalogChannel(UINT32 channel);
+	virtual ~AnalogChannel();
+
+	INT16 GetValue();
+	INT32 GetAverageValue();
+	float GetVoltage();
+	float GetAverageVoltage();
+	UINT8 GetModuleNumber() const { return moduleNumber; }
+	UINT32 GetChannel() const { return channel; }
+	void SetAverageBits(UINT32 bits) { averageBits = bits; }
+	UINT32 GetAverageBits() const { return averageBits; }
+	void SetOversampleBits(UINT32 bits) { oversampleBits = bits; }
+	UINT32 GetOversampleBits() const { return oversampleBits; }
+	double PIDGet() { return GetAverageValue(); }
+
+private:
+	UINT8 moduleNumber;
+	UINT32 channel;
+	UINT32 averageBits;
+	UINT32 oversampleBits;
+};
+
+typedef void (*tInterruptHandler)(UINT32 interruptAssertedMask, void* param);
+
+class AnalogTrigger;
+
+/**
+ * One output of an analog trigger. Interrupts fire on the rising edge of
+ * the output, as the FPGA's asynchronous interrupts do by default; a
+ * thread watches the output every model step and calls the handler.
+ */
+class AnalogTriggerOutput : public SensorBase
+{
+public:
+	enum Type { kInWindow = 0, kState = 1, kRisingPulse = 2, kFallingPulse = 3 };
+
+	virtual ~AnalogTriggerOutput();
+
+	bool Get();
+	void RequestInterrupts(tInterruptHandler handler, void* param);
+	void CancelInterrupts();
+	void EnableInterrupts();
+	void DisableInterrupts();
+
+private:
+	friend class AnalogTrigger;
+	AnalogTriggerOutput(AnalogTrigger* trigger, Type type);
+	bool Sample();
+	static void Watch(void* output);
+
+	AnalogTrigger* trigger;
+	Type type;
+	tInterruptHandler handler;
+	void* param;
+	bool enabled;
+	bool lastState;
+	void* thread;
+};
+
+/**
+ * An FPGA analog trigger: compares an analog input against two limits.
+ * The state goes high above the upper limit and low below the lower one,
+ * and holds in between.
+ */
+class AnalogTrigger : public SensorBase
+{
+public:
+	AnalogTrigger(UINT8 moduleNumber, UINT32 channel);
+	explicit AnalogTrigger(UINT32 channel);
+	virtual ~AnalogTrigger();
+
+	void SetLimitsVoltage(float lower, float upper);
+	void SetAveraged(bool useAveragedValue) {}
+	void SetFiltered(bool useFilteredValue) {}
+	bool GetInWindow();
+	bool GetTriggerState();
+	AnalogTriggerOutput* CreateOutput(AnalogTriggerOutput::Type type);
+
+private:
+	friend class AnalogTriggerOutput;
+	float Sample();
+
+	UINT8 moduleNumber;
+	UINT32 channel;
+	float lower;
+	float upper;
+	bool state;
+};
+
+class Counter : public SensorBase
+{
+public:
+	explicit Counter(UINT32 channel);
+	virtual ~Counter();
+
+	void Start();
+	INT32 Get();
+	void Reset();
+	void Stop();
+	double GetPeriod();
+	void SetMaxPeriod(double maxPeriod) { this->maxPeriod = maxPeriod; }
+	bool GetStopped();
+
+private:
+	UINT32 channel;
+	INT32 offset;
+	INT32 stoppedCount;
+	bool running;
+	double maxPeriod;
+};
+
+class Encoder : public SensorBase, public PIDSource
+{
+public:
+	Encoder(UINT32 aChannel, UINT32 bChannel, bool reverseDirection = false);
+	virtual ~Encoder();
+
+	void Start();
+	INT32 Get();
+	INT32 GetRaw();
+	void Reset();
+	void Stop();
+	double GetPeriod();
+	bool GetStopped();
+	double GetDistance();
+	double GetRate();
+	void SetDistancePerPulse(double distancePerPulse) { this->distancePerPulse = distancePerPulse; }
+	void SetReverseDirection(bool reverseDirection) { this->reverse = reverseDirection; }
+	double PIDGet() { return GetDistance(); }
+
+private:
+	UINT32 channel;
+	INT32 offset;
+	bool reverse;
+	double distancePerPulse;
+};
+
+class Gyro : public SensorBase, public PIDSource
+{
+public:
+	explicit Gyro(UINT32 channel);
+
+	float GetAngle();
+	void Reset();
+	void SetSensitivity(float voltsPerDegreePerSecond) {}
+	double PIDGet() { return GetAngle(); }
+
+private:
+	float offset;
+};
+
+class Joystick
+{
+public:
+	explicit Joystick(UINT32 port);
+	virtual ~Joystick();
+
+	float GetX() { return GetRawAxis(1); }
+	float GetY() { return GetRawAxis(2); }
+	float GetZ() { return GetRawAxis(3); }
+	float GetTwist() { return GetRawAxis(3); }
+	float GetThrottle() { return GetRawAxis(4); }
+	float GetRawAxis(UINT32 axis);
+	bool GetTrigger() { return GetRawButton(1); }
+	bool GetTop() { return GetRawButton(2); }
+	bool GetRawButton(UINT32 button);
+
+private:
+	UINT32 port;
+};
+
+class Timer
+{
+public:
+	Timer();
+	virtual ~Timer();
+
+	double Get();
+	void Reset();
+	void Start();
+	void Stop();
+	bool HasPeriodPassed(double period);
+
+	static double GetFPGATimestamp();
+
+private:
+	double startTime;
+	double accumulatedTime;
+	bool running;
+};
+
+class Task
+{
+public:
+	static const INT32 kDefaultPriority = 101;
+
+	Task(const char* name, FUNCPTR function, INT32 priority = kDefaultPriority, UINT32 stackSize = 20000);
+	virtual ~Task();
+
+	bool Start(UINT32 arg0 = 0, UINT32 arg1 = 0, UINT32 arg2 = 0, UINT32 arg3 = 0, UINT32 arg4 = 0,
+			UINT32 arg5 = 0, UINT32 arg6 = 0, UINT32 arg7 = 0, UINT32 arg8 = 0, UINT32 arg9 = 0);
+	bool Restart();
+	bool Stop();
+	bool IsReady();
+	bool Verify();
+	INT32 GetPriority() { return priority; }
+	bool SetPriority(INT32 priority) { this->priority = priority; return true; }
+	const char* GetName() { return name.c_str(); }
+
+private:
+	std::string name;
+	FUNCPTR function;
+	INT32 priority;
+	void* thread;
+	UINT32 args[10];
+};
+
+typedef void (*TimerEventHandler)(void* param);
+
+class Notifier
+{
+public:
+	Notifier(TimerEventHandler handler, void* param = NULL);
+	virtual ~Notifier();
+
+	void StartSingle(double delay);
+	void StartPeriodic(double period);
+	void Stop();
+
+private:
+	static void Run(void* notifier);
+
+	TimerEventHandler handler;
+	void* param;
+	double period;
+	double nextFire;
+	bool periodic;
+	void* thread;
+};
+
+class PIDController
+{
+public:
+	PIDController(float p, float i, float d, PIDSource* source, PIDOutput* output, float period = 0.05);
+	virtual ~PIDController();
+
+	float Get();
+	void SetContinuous(bool continuous = true) { this->continuous = continuous; }
+	void SetInputRange(float minimumInput, float maximumInput);
+	void SetOutputRange(float minimumOutput, float maximumOutput);
+	void SetPID(float p, float i, float d);
+	float GetP() { return p; }
+	float GetI() { return i; }
+	float GetD() { return d; }
+	void SetSetpoint(float setpoint);
+	float GetSetpoint() { return setpoint; }
+	float GetError() { return error; }
+	void SetTolerance(float percent) { tolerance = percent; }
+	bool OnTarget();
+	void Enable();
+	void Disable();
+	bool IsEnabled() { return enabled; }
+	void Reset();
+
+private:
+	static void CallCalculate(void* controller);
+	void Calculate();
+
+	float p, i, d;
+	float maximumOutput, minimumOutput;
+	float maximumInput, minimumInput;
+	bool continuous;
+	bool enabled;
+	float prevError;
+	double totalError;
+	float tolerance;
+	float setpoint;
+	float error;
+	float result;
+	PIDSource* source;
+	PIDOutput* output;
+	Notifier* controlLoop;
+};
+
+class Synchronized
+{
+public:
+	explicit Synchronized(SEM_ID semaphore);
+	virtual ~Synchronized();
+
+private:
+	SEM_ID semaphore;
+};
+
+/**
+ * Only the battery voltage, from SimHardware.
+ */
+class DriverStation
+{
+public:
+	static DriverStation* GetInstance();
+	float GetBatteryVoltage();
+};
+
+#define CRITICAL_REGION(s) { Synchronized _sync(s);
+#define END_REGION }
+
+#include "DriverStationLCD.h"
+
+#endif // SIM_WPILIB_H
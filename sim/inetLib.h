@@ -0,0 +1,17 @@
+#ifndef SIM_INETLIB_H
+#define SIM_INETLIB_H
+
+/**
+ * \file inetLib.h
+ * \brief Internet addresses from the host's own network stack.
+ */
+
+#include <sys/types.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+// Host socket addresses have no length field. What robot code writes there
+// lands in the padding, which the host ignores.
+#define sin_len sin_zero[0]
+
+#endif // SIM_INETLIB_H
@@ -0,0 +1,20 @@
+#ifndef SIM_SELECTLIB_H
+#define SIM_SELECTLIB_H
+
+/**
+ * \file selectLib.h
+ * \brief select() on simulated time.
+ *
+ * The host sockets are polled, and between polls the other tasks run and
+ * the clock moves on. While a task waits on a socket the clock is held to
+ * about real time, so a peer on the host sends at its own pace in simulated
+ * time too.
+ */
+
+#include <sys/select.h>
+
+int SimSelect(int width, fd_set* readable, fd_set* writable, fd_set* exceptional, struct timeval* timeout);
+
+#define select SimSelect
+
+#endif // SIM_SELECTLIB_H
@@ -0,0 +1,20 @@
+#ifndef SIM_SOCKLIB_H
+#define SIM_SOCKLIB_H
+
+/**
+ * \file sockLib.h
+ * \brief Sockets from the host's own network stack, so robot code can talk
+ * to stand-in servers such as tools/MjpegReplayServer.
+ */
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "VxWorks.h"
+
+/**
+ * Connect, giving up after timeout of real time.
+ */
+STATUS connectWithTimeout(int sock, struct sockaddr* address, int addressLength, struct timeval* timeout);
+
+#endif // SIM_SOCKLIB_H
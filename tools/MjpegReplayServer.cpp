@@ -0,0 +1,163 @@
+/**
+ * \file MjpegReplayServer.cpp
+ * \brief A stand-in for the Axis camera that replays recorded JPEGs.
+ *
+ * Builds and runs on a development machine, not on the cRIO:
+ *
+ *     g++ -O2 -o MjpegReplayServer MjpegReplayServer.cpp
+ *     ./MjpegReplayServer 8080 30 frame000.jpg frame001.jpg ...
+ *
+ * Serves /mjpg/video.mjpg as multipart/x-mixed-replace at the given frame
+ * rate, looping over the files, and answers param.cgi writes with 200 OK so
+ * the robot's camera client can be pointed at it through CAMERA_ADDRESS and
+ * CAMERA_PORT in Constants.h. Each client gets its own process.
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static const char* BOUNDARY = "myboundary";
+
+static bool SendAll(int sock, const char* data, size_t length)
+{
+	while (length > 0)
+	{
+		ssize_t sent = send(sock, data, length, MSG_NOSIGNAL);
+		if (sent <= 0)
+			return false;
+		data += sent;
+		length -= sent;
+	}
+	return true;
+}
+
+static bool LoadFrames(int count, char** names, std::vector<std::string>& frames)
+{
+	for (int i = 0; i < count; i++)
+	{
+		std::ifstream file(names[i], std::ios::binary);
+		if (!file)
+		{
+			fprintf(stderr, "cannot open %s\n", names[i]);
+			return false;
+		}
+		frames.push_back(std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()));
+	}
+	return true;
+}
+
+static void SleepUntil(struct timespec& deadline, double period)
+{
+	long nanos = (long)(period * 1e9);
+	deadline.tv_nsec += nanos % 1000000000L;
+	deadline.tv_sec += nanos / 1000000000L + deadline.tv_nsec / 1000000000L;
+	deadline.tv_nsec %= 1000000000L;
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+}
+
+static void Stream(int client, const std::vector<std::string>& frames, double fps)
+{
+	char header[256];
+	int length = snprintf(header, sizeof(header),
+			"HTTP/1.0 200 OK\r\n"
+			"Content-Type: multipart/x-mixed-replace; boundary=%s\r\n"
+			"\r\n", BOUNDARY);
+	if (!SendAll(client, header, length))
+		return;
+
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	unsigned sent = 0;
+	for (size_t i = 0; ; i = (i + 1) % frames.size())
+	{
+		length = snprintf(header, sizeof(header),
+				"--%s\r\n"
+				"Content-Type: image/jpeg\r\n"
+				"Content-Length: %u\r\n"
+				"\r\n", BOUNDARY, (unsigned)frames[i].size());
+		if (!SendAll(client, header, length) ||
+				!SendAll(client, frames[i].data(), frames[i].size()) ||
+				!SendAll(client, "\r\n", 2))
+			break;
+		sent++;
+		SleepUntil(deadline, 1.0 / fps);
+	}
+	printf("client disconnected after %u frames\n", sent);
+}
+
+static void Serve(int client, const std::vector<std::string>& frames, double fps)
+{
+	char request[1024];
+	ssize_t length = recv(client, request, sizeof(request) - 1, 0);
+	if (length <= 0)
+		return;
+	request[length] = '\0';
+	if (strstr(request, "GET /mjpg/video.mjpg") == request)
+		Stream(client, frames, fps);
+	else if (strstr(request, "GET /axis-cgi/admin/param.cgi") == request)
+		SendAll(client, "HTTP/1.0 200 OK\r\n\r\nOK\r\n", 23);
+	else
+		SendAll(client, "HTTP/1.0 404 Not Found\r\n\r\n", 26);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 4)
+	{
+		fprintf(stderr, "usage: %s <port> <fps> <frame.jpg>...\n", argv[0]);
+		return 1;
+	}
+	int port = atoi(argv[1]);
+	double fps = atof(argv[2]);
+	std::vector<std::string> frames;
+	if (fps <= 0.0 || !LoadFrames(argc - 3, argv + 3, frames))
+		return 1;
+
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	int yes = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(listener, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(listener, 4) < 0)
+	{
+		perror("bind");
+		return 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	// Children are never waited for.
+	signal(SIGCHLD, SIG_IGN);
+	printf("replaying %u frames at %.1f fps on port %d\n", (unsigned)frames.size(), fps, port);
+
+	// A process for each client, so param.cgi writes are answered while a
+	// stream is open, as the camera does.
+	while (true)
+	{
+		int client = accept(listener, NULL, NULL);
+		if (client < 0)
+			continue;
+		pid_t child = fork();
+		if (child < 0)
+			perror("fork");
+		else if (child == 0)
+		{
+			close(listener);
+			Serve(client, frames, fps);
+			close(client);
+			return 0;
+		}
+		close(client);
+	}
+}